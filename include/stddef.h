@@ -6,6 +6,8 @@
 typedef unsigned int size_t;
 typedef int          ssize_t;
 
+#define SSIZE_MAX 0x7FFFFFFF
+
 #ifndef offsetof
 #define offsetof(type, member) ((size_t) & ((type*)0)->member)
 #endif
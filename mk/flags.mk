@@ -8,6 +8,14 @@ COMMON_CFLAGS := \
 	-Wextra \
 	-Wno-unused-parameter \
 
+# Optional kernel features, enabled from the command line, e.g. `make VM_MERGE=1`
+ifeq ($(VM_MERGE),1)
+COMMON_CFLAGS += -DVM_MERGE
+endif
+ifeq ($(LOCKSTAT),1)
+COMMON_CFLAGS += -DLOCKSTAT
+endif
+
 CFLAGS  := $(ARCH_CFLAGS) $(COMMON_CFLAGS) -MMD -MP
 ASFLAGS := $(ARCH_CFLAGS) -x assembler-with-cpp -MMD -MP
 LDFLAGS := $(ARCH_LDFLAGS) -nostdlib -no-pie -Wl,-T,linker.ld
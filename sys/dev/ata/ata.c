@@ -11,6 +11,7 @@
 #include <dev/port/port_io.h>
 
 #include <kern/errno.h>
+#include <kern/lockstat.h>
 #include <kern/pit.h>
 #include <kern/terminal.h>
 
@@ -18,6 +19,8 @@
 
 DECLARE_DRIVER(ata_ide, ata);
 
+LOCK_CLASS(ata_channel_lock_class, "ata_channel");
+
 /* ===========================
  * ATA Driver Implementation
  * =========================== */
@@ -62,9 +65,8 @@ int ata_ide_open(device_t* bdev)
     return 0;
 }
 
-int ata_ide_read(device_t* bdev, uint64_t lba, uint32_t count, uint8_t* buffer)
+static int ata_pio_read(ata_drive_t* drive, uint64_t lba, uint32_t count, uint8_t* buffer)
 {
-    ata_drive_t* drive = (ata_drive_t*)bdev->softc;
     ata_wait_not_busy(drive);
     outb(drive->channel.io_base + ATA_REG_DEVICE,
          0xE0 | (drive->channel.slave << 4) | ((lba >> 24) & 0x0F));
@@ -75,11 +77,13 @@ int ata_ide_read(device_t* bdev, uint64_t lba, uint32_t count, uint8_t* buffer)
     outb(drive->channel.io_base + ATA_REG_LBA_MID, (uint8_t)(lba >> 8));
     outb(drive->channel.io_base + ATA_REG_LBA_HIGH, (uint8_t)(lba >> 16));
 
+    ata_expect_irq(drive);
     outb(drive->channel.io_base + ATA_REG_COMMAND, ATA_CMD_READ_SECTORS); // READ SECTORS
     ata_wait(drive->channel.control_base);
 
-    // Wait for the drive to be ready
+    // The drive raises its IRQ as each sector becomes ready
     for (uint32_t i = 0; i < count; i++) {
+        ata_wait_irq(drive);
         if (ata_wait_drq(drive))
             return -EIO;
 
@@ -88,9 +92,8 @@ int ata_ide_read(device_t* bdev, uint64_t lba, uint32_t count, uint8_t* buffer)
     return 0;
 }
 
-int ata_ide_write(device_t* bdev, uint64_t lba, uint32_t count, const uint8_t* data)
+static int ata_pio_write(ata_drive_t* drive, uint64_t lba, uint32_t count, const uint8_t* data)
 {
-    ata_drive_t* drive = (ata_drive_t*)bdev->softc;
     outb(drive->channel.io_base + ATA_REG_DEVICE,
          0xE0 | (drive->channel.slave << 4) | ((lba >> 24) & 0x0F));
     ata_wait(drive->channel.control_base);
@@ -102,28 +105,61 @@ int ata_ide_write(device_t* bdev, uint64_t lba, uint32_t count, const uint8_t* d
 
     outb(drive->channel.io_base + ATA_REG_COMMAND, 0x30); // WRITE SECTORS
 
-    // Wait for the drive to be ready to accept data
-    int ret = ata_wait_drq(drive);
-    if (ret)
-        return ret;
-
-    // Write the sector data
-    outsw(drive->channel.io_base + ATA_REG_DATA, data, count * 256);
+    for (uint32_t i = 0; i < count; i++) {
+        // Wait for the drive to be ready to accept data
+        int ret = ata_wait_drq(drive);
+        if (ret)
+            return ret;
+
+        // Write the sector data; the drive raises its IRQ once it has taken the sector
+        ata_expect_irq(drive);
+        outsw(drive->channel.io_base + ATA_REG_DATA, data + i * 512, 256);
+        ata_wait_irq(drive);
+    }
 
     // Wait for the write to complete
     return ata_wait_not_busy(drive);
 }
 
+// The transfers sleep on the channel's IRQ, so other threads run while the channel is held
+
+int ata_ide_read(device_t* bdev, uint64_t lba, uint32_t count, uint8_t* buffer)
+{
+    ata_drive_t* drive = (ata_drive_t*)bdev->softc;
+
+    mutex_lock_class(&drive->parent->lock, ata_channel_lock_class);
+    int res = ata_pio_read(drive, lba, count, buffer);
+    mutex_unlock(&drive->parent->lock);
+    return res;
+}
+
+int ata_ide_write(device_t* bdev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    ata_drive_t* drive = (ata_drive_t*)bdev->softc;
+
+    mutex_lock_class(&drive->parent->lock, ata_channel_lock_class);
+    int res = ata_pio_write(drive, lba, count, data);
+    mutex_unlock(&drive->parent->lock);
+    return res;
+}
+
 int ata_ide_ioctl(device_t* bdev, int cmd, void* arg)
 {
+    ata_drive_t* drive = (ata_drive_t*)bdev->softc;
+
+    int res;
     switch (cmd) {
     case ATA_IOCTL_SOFTWARE_RESET:
-        outb(((ata_drive_t*)bdev->softc)->channel.control_base + 0x02,
-             0x04);  // Set SRST bit to initiate software reset
-        delay_ms(5); // Wait 5ms for the drive to process the reset
-        outb(((ata_drive_t*)bdev->softc)->channel.control_base + 0x02, 0x00); // Clear SRST bit
-        delay_ms(5); // Wait for the drive to reset
-        return ata_wait_not_busy((ata_drive_t*)bdev->softc);
+        WITH_MUTEX_CLASS(drive->parent->lock, ata_channel_lock_class)
+        {
+            outb(drive->channel.control_base + 0x02,
+                 0x04);  // Set SRST bit to initiate software reset
+            delay_ms(5); // Wait 5ms for the drive to process the reset
+            outb(drive->channel.control_base + 0x02, 0x00); // Clear SRST bit
+            delay_ms(5); // Wait for the drive to reset
+            res = ata_wait_not_busy(drive);
+        }
+        return res;
     default:
         return -EINVAL; // Unsupported command
     }
@@ -9,12 +9,49 @@
 
 #include <vm/kmalloc.h>
 
+#include <machine/idt.h>
+
 #include <kern/errno.h>
+#include <kern/isr.h>
+#include <kern/lapic.h>
 #include <kern/terminal.h>
 
 DECLARE_BUS_DRIVER(ata, any);
 driver_t* driver_ata = &__driver_ata;
 
+// Legacy channels by IRQ, 14 and 15
+static ata_channel_t* ata_irq_channels[2];
+
+static void ata_irq_handler(registers_t* regs)
+{
+    ata_channel_t* channel = ata_irq_channels[regs->interruptNumber - PIC_IRQ_BASE - 14];
+    if (channel) {
+        inb(channel->io_base + ATA_REG_STATUS); // Reading the status acknowledges the IRQ
+        channel->irq_pending = true;
+        wake_all(&channel->irq_queue);
+    }
+
+    lapic_write(LAPIC_EOI, 0);
+    outb(0x20, 0x20); // Send EOI to PIC1
+    outb(0xA0, 0x20); // Send EOI to PIC2
+}
+
+void ata_expect_irq(ata_drive_t* drive)
+{
+    if (drive->channel.IEN)
+        drive->parent->irq_pending = false;
+}
+
+void ata_wait_irq(ata_drive_t* drive)
+{
+    if (!drive->channel.IEN)
+        return; // Polled channel, the caller's status checks do the waiting
+
+    ata_channel_t* channel = drive->parent;
+    wait_event(channel->irq_queue, channel->irq_pending);
+    channel->irq_pending = false;
+}
+
 int ata_wait_not_busy(ata_drive_t* drive)
 {
     uint8_t status;
@@ -55,6 +92,9 @@ int ata_enumerate(device_t* bus)
 {
     ata_channel_t* channel = (ata_channel_t*)bus->softc;
 
+    if (channel->irq)
+        ata_setup_irq(bus, NULL, channel->irq);
+
     // Detect drives on this controller
     for (int slave = 0; slave < 2; ++slave) {
         outb(channel->io_base + ATA_REG_DEVICE, 0xA0 | (slave << 4)); // Select drive
@@ -89,7 +129,8 @@ int ata_enumerate(device_t* bus)
         drive->channel.io_base      = channel->io_base;
         drive->channel.control_base = channel->control_base;
         drive->channel.slave        = slave;
-        drive->channel.IEN          = 0; // TODO: Handle interrupts in the future
+        drive->channel.IEN          = channel->irq != 0;
+        drive->parent               = channel;
 
         ata_identify_data_t* id_data = &drive->identify_data;
         if (ata_wait_drq(drive))
@@ -159,11 +200,28 @@ int ata_free_resource(device_t* bus, device_t* dev, resource_t* res)
 
 int ata_setup_irq(device_t* bus, device_t* dev, int irq)
 {
+    ata_channel_t* channel = (ata_channel_t*)bus->softc;
+    if (irq != 14 && irq != 15)
+        return -EINVAL;
+
+    channel->irq_pending = false;
+    wait_queue_init(&channel->irq_queue);
+    ata_irq_channels[irq - 14] = channel;
+
+    interrupt_register(PIC_IRQ_BASE + irq, ata_irq_handler);
+    pic_unmask_irq(irq);
+    outb(channel->control_base, 0); // Clear nIEN so the drives raise the IRQ
     return 0;
 }
 
 int ata_teardown_irq(device_t* bus, device_t* dev, int irq)
 {
+    ata_channel_t* channel = (ata_channel_t*)bus->softc;
+    if (irq != 14 && irq != 15)
+        return -EINVAL;
+
+    outb(channel->control_base, ATA_DCR_IEN); // Set nIEN
+    ata_irq_channels[irq - 14] = NULL;
     return 0;
 }
 
@@ -9,6 +9,10 @@ int  ata_wait_not_busy(ata_drive_t* drive);
 int  ata_wait_drq(ata_drive_t* drive);
 void ata_wait(uint16_t control_base);
 
+/* IRQ-driven completion: arm before issuing a command, then sleep until the drive signals */
+void ata_expect_irq(ata_drive_t* drive);
+void ata_wait_irq(ata_drive_t* drive);
+
 extern driver_t* driver_ata;
 
 #endif // DEV_ATA_BUS_H
@@ -50,12 +50,14 @@ int ata_controller_attach(device_t* dev)
         ata_channel_t* channel = kmalloc(sizeof(ata_channel_t));
         if (!channel)
             return -ENOMEM;
+        mutex_init(&channel->lock);
 
         if (pci_dev->prog_if & (1 << (i * 2))) {
             // TODO: Handle bus mastering if supported by the controller
             // PCI native mode, read I/O bases from BARs
             channel->io_base      = pci_read_bar(pci_dev, i * 2) & ~0x3;
             channel->control_base = pci_read_bar(pci_dev, i * 2 + 1) & ~0x3;
+            channel->irq          = 0; // TODO: Route the PCI interrupt line, polled until then
         }
         else {
             // Legacy IDE mode, use standard I/O ports
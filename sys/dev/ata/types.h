@@ -2,6 +2,8 @@
 #define DEV_ATA_TYPES_H
 
 #include <kern/compiler.h>
+#include <kern/mutex.h>
+#include <kern/wait_queue.h>
 
 #include <inttypes.h>
 
@@ -236,7 +238,12 @@ typedef struct ata_channel {
     uint16_t io_base;
     uint16_t control_base;
     uint16_t bm_io_base; // For bus mastering, if supported
-    uint8_t  irq;        // IRQ number for this channel
+    uint8_t  irq;        // IRQ number for this channel, 0 if commands are polled
+
+    volatile bool irq_pending; // Set by the IRQ handler, cleared before each command
+    wait_queue_t  irq_queue;   // Threads waiting for the channel's IRQ
+
+    mutex_t lock; // Held across a whole command, as both drives share the channel's registers
 } ata_channel_t;
 
 typedef struct ide_channel_regs {
@@ -249,6 +256,7 @@ typedef struct ide_channel_regs {
 typedef struct ata_drive {
     ide_channel_regs_t  channel;
     ata_identify_data_t identify_data;
+    ata_channel_t*      parent; // Channel the drive sits on, which signals command completion
 } ata_drive_t;
 
 #endif // DEV_ATA_TYPES_H
@@ -24,7 +24,7 @@ int vbe_init(void)
     current_mode_info.framebuffer = vm_map_device(
         bootinfo->framebuffer_addr,
         current_mode_info.width * current_mode_info.height * (current_mode_info.bpp / 8),
-        VM_PROT_READ | VM_PROT_WRITE, 0);
+        VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_WC);
 
     return 0;
 }
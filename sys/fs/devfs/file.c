@@ -20,6 +20,22 @@ int devfs_file_write(file_t* file, const void* buf, size_t size)
     return devfs_vnode_write(file->f_vnode, buf, size, file->f_pos);
 }
 
+int devfs_file_pread(file_t* file, void* buf, size_t size, loff_t pos)
+{
+    if (!file || !buf)
+        return -EINVAL;
+
+    return devfs_vnode_read(file->f_vnode, buf, size, pos);
+}
+
+int devfs_file_pwrite(file_t* file, const void* buf, size_t size, loff_t pos)
+{
+    if (!file || !buf)
+        return -EINVAL;
+
+    return devfs_vnode_write(file->f_vnode, buf, size, pos);
+}
+
 int devfs_file_seek(file_t* file, size_t offset, int whence)
 {
     if (!file)
@@ -51,8 +67,10 @@ int devfs_file_ioctl(file_t* file, int request, void* arg)
     return devfs_vnode_ioctl(file->f_vnode, request, arg);
 }
 
-file_ops_t devfs_file_ops = {.read  = devfs_file_read,
-                             .write = devfs_file_write,
-                             .seek  = devfs_file_seek,
-                             .close = devfs_file_close,
-                             .ioctl = devfs_file_ioctl};
+file_ops_t devfs_file_ops = {.read   = devfs_file_read,
+                             .write  = devfs_file_write,
+                             .seek   = devfs_file_seek,
+                             .close  = devfs_file_close,
+                             .ioctl  = devfs_file_ioctl,
+                             .pread  = devfs_file_pread,
+                             .pwrite = devfs_file_pwrite};
@@ -116,10 +116,9 @@ int devfs_vnode_create(vnode_t* dir, const char* name, enum vnode_type type, vno
         block->devices[index] = dev_vnode; // Store the new device vnode in the block
 
         *result = dev_vnode;
-        if (res == 0)
-            return 0; // Vnode already exists, return it
 
-        // Initialize the new device vnode
+        // Initialize the device vnode; an existing one may be a cached vnode left behind by an
+        // unlinked device in the same slot
         dev_vnode->v_type = type;
         dev_vnode->v_ops  = &devfs_vnode_ops;
     }
@@ -15,6 +15,9 @@ typedef struct file_ops {
     int (*ioctl)(file_t* file, int cmd, void* arg);
     int (*close)(file_t* file);
     int (*seek)(file_t* file, loff_t offset, int whence);
+    // Positioned I/O at pos, leaving f_pos alone so threads sharing the file don't race on it
+    ssize_t (*pread)(file_t* file, void* buf, size_t count, loff_t pos);
+    ssize_t (*pwrite)(file_t* file, const void* buf, size_t count, loff_t pos);
 } file_ops_t;
 
 typedef struct file {
@@ -32,6 +35,8 @@ typedef struct file {
     int               name##_file_ioctl(file_t* file, int cmd, void* arg);                         \
     int               name##_file_close(file_t* file);                                             \
     int               name##_file_seek(file_t* file, loff_t offset, int whence);                   \
+    int               name##_file_pread(file_t* file, void* buf, size_t count, loff_t pos);        \
+    int               name##_file_pwrite(file_t* file, const void* buf, size_t count, loff_t pos); \
     extern file_ops_t name##_file_ops;
 
 void file_inc_ref(file_t* file);
@@ -6,6 +6,7 @@
 
 #include <kern/errno.h>
 #include <kern/panic.h>
+#include <kern/rcu.h>
 #include <kern/spinlock.h>
 
 mount_t*   mount_table[MAX_MOUNTS];
@@ -61,7 +62,7 @@ int mount_create(vnode_t* mnt_point, vnode_t* mnt_dev_vnode, mount_flags_t flags
 
     WITH_SPINLOCK(mount_table_lock)
     {
-        mount_table[mount_count] = mnt;
+        rcu_assign_pointer(mount_table[mount_count], mnt);
         mount_count++;
         *result = mnt;
     }
@@ -84,7 +85,7 @@ int mount_destroy(mount_t* mnt)
             vnode_t* next = lazy_vnode->mnt_next;
             if (vnode_cache_remove(lazy_vnode))
                 PANIC("Failed to remove lazy vnode from cache during mount destruction\n");
-            kfree(lazy_vnode);
+            vnode_cache_free(lazy_vnode);
             lazy_vnode = next;
         }
         mnt->lazy_vnode_list  = NULL;
@@ -100,9 +101,6 @@ int mount_destroy(mount_t* mnt)
     vnode_dec_ref(mnt->mnt_point);
     vnode_dec_ref(mnt->mnt_dev_vnode);
 
-    kfree(mnt->mnt_point);
-    kfree(mnt);
-
     // TODO: Remove the mount from the mount table. This is a bit tricky since we need to find it
     // and shift the rest of the mounts down. For now, just mark it as NULL and let the mount_count
     // stay the same. In a real implementation, we would want to compact the mount table or use a
@@ -111,12 +109,18 @@ int mount_destroy(mount_t* mnt)
     {
         for (int i = 0; i < mount_count; i++) {
             if (mount_table[i] == mnt) {
-                mount_table[i] = NULL;
+                rcu_assign_pointer(mount_table[i], NULL);
                 break;
             }
         }
     }
 
+    // Lookups walk the table without the lock, so wait for any still looking at mnt
+    synchronize_rcu();
+
+    kfree(mnt->mnt_point);
+    kfree(mnt);
+
     return 0; // Success
 }
 
@@ -125,8 +129,9 @@ mount_t* lookup_mnt_by_vnode(vnode_t* vnode)
     if (!vnode)
         return NULL;
     for (int i = 0; i < mount_count; i++) {
-        if (mount_table[i] && mount_table[i]->mnt_point == vnode)
-            return mount_table[i];
+        mount_t* mnt = rcu_dereference(mount_table[i]);
+        if (mnt && mnt->mnt_point == vnode)
+            return mnt;
     }
     return NULL;
 }
@@ -55,6 +55,8 @@ void mount_dec_ref(mount_t* mnt);
 int mount_create(vnode_t* mnt_point, vnode_t* mnt_dev_vnode, mount_flags_t flags, mount_t** result);
 int mount_destroy(mount_t* mnt);
 
+// Call inside an RCU read-side section: the mount found stays valid until the section ends, unless
+// the caller takes a reference
 mount_t* lookup_mnt_by_vnode(vnode_t* vnode);
 
 #endif // MOUNT_H
@@ -25,6 +25,7 @@ int vfat_mount(mount_t* mnt, const char* options)
     vfat_mount_data_t* mount_data = kmalloc(sizeof(vfat_mount_data_t));
     if (!mount_data)
         return -ENOMEM;
+    mutex_init(&mount_data->lock);
 
     bpb_t* bpb = &mount_data->bpb; // Point to the BPB within the mount data structure
 
@@ -6,6 +6,8 @@
 #include <fs/mount.h>
 #include <fs/types.h>
 
+#include <kern/mutex.h>
+
 #include <inttypes.h>
 
 typedef enum vfat_flags {
@@ -43,6 +45,8 @@ typedef struct vfat_mount_data {
     uint32_t total_clusters;
 
     vfat_flags_t flags; // Mount options and state flags
+
+    mutex_t lock; // Serialises directory scans and updates, which block on the disk throughout
 } vfat_mount_data_t;
 
 extern mount_ops_t vfat_mount_ops;
@@ -9,6 +9,7 @@
 #include <fs/vnode.h>
 
 #include <kern/errno.h>
+#include <kern/lockstat.h>
 #include <kern/terminal.h>
 #include <vm/kmalloc.h>
 
@@ -21,6 +22,10 @@ static ssize_t vfat_file_read(file_t* file, void* buf, size_t count);
 static ssize_t vfat_file_write(file_t* file, const void* buf, size_t count);
 static int     vfat_file_seek(file_t* file, loff_t offset, int whence);
 static int     vfat_file_close(file_t* file);
+static ssize_t vfat_file_pread(file_t* file, void* buf, size_t count, loff_t pos);
+static ssize_t vfat_file_pwrite(file_t* file, const void* buf, size_t count, loff_t pos);
+
+LOCK_CLASS(vfat_lock_class, "vfat");
 
 /* =========================================================
    Ops tables
@@ -51,11 +56,13 @@ vnode_ops_t vfat_vnode_ops = {
 };
 
 file_ops_t vfat_file_ops = {
-    .read  = vfat_file_read,
-    .write = vfat_file_write,
-    .seek  = vfat_file_seek,
-    .close = vfat_file_close,
-    .ioctl = NULL,
+    .read   = vfat_file_read,
+    .write  = vfat_file_write,
+    .seek   = vfat_file_seek,
+    .close  = vfat_file_close,
+    .ioctl  = NULL,
+    .pread  = vfat_file_pread,
+    .pwrite = vfat_file_pwrite,
 };
 
 void vfat_shortname_to_str(char* out, const uint8_t name[11])
@@ -280,8 +287,11 @@ int vfat_vnode_lookup(vnode_t* vp, const char* name, vnode_t** result)
     strtoupper(upper_name);
     lookup_ctx_t lc = {.target = upper_name, .result = {0}, .found = false};
 
-    int res = vfat_walk_chain(vp->v_mount->mnt_dev_vnode->v_data, vp->v_mount->private,
+    vfat_mount_data_t* mnt = (vfat_mount_data_t*)vp->v_mount->private;
+    mutex_lock_class(&mnt->lock, vfat_lock_class);
+    int res = vfat_walk_chain(vp->v_mount->mnt_dev_vnode->v_data, mnt,
                               ((vfat_node_data_t*)vp->v_data)->start_cluster, lookup_cb, &lc);
+    mutex_unlock(&mnt->lock);
     if (res)
         return res;
     if (!lc.found)
@@ -333,8 +343,11 @@ int vfat_vnode_readdir(vnode_t* vp, void* buf, size_t buf_size, size_t offset)
 
     readdir_ctx_t rc = {.buf = buf, .buf_size = buf_size, .out_off = 0};
 
-    int res = vfat_walk_chain(vp->v_mount->mnt_dev_vnode->v_data, vp->v_mount->private,
+    vfat_mount_data_t* mnt = (vfat_mount_data_t*)vp->v_mount->private;
+    mutex_lock_class(&mnt->lock, vfat_lock_class);
+    int res = vfat_walk_chain(vp->v_mount->mnt_dev_vnode->v_data, mnt,
                               ((vfat_node_data_t*)vp->v_data)->start_cluster, readdir_cb, &rc);
+    mutex_unlock(&mnt->lock);
     if (res)
         return res;
 
@@ -355,42 +368,46 @@ int vfat_vnode_create(vnode_t* dir, const char* name, vmode_t mode, vnode_t** re
             return -ENAMETOOLONG;
     }
 
-    vfat_lookup_result_t lr;
-    int                  res = vfat_lookup(dir, name, VFAT_LOOKUP_FREE, &lr);
-    if (res)
-        return res;
-
-    if (use_lfn)
-        return -ENOSYS;
-
-    void* blk;
-    res = block_read(dir->v_mount->mnt_dev_vnode->v_data, lr.sector, &blk, 512);
-    if (res)
-        return res;
-
-    vfat_standard_entry_t* entry = (vfat_standard_entry_t*)((char*)blk + lr.offset);
-    memset(entry, 0, sizeof(vfat_standard_entry_t));
-    vfat_build_shortname((char*)entry->name, (const uint8_t*)name);
-    entry->attributes         = 0;
-    entry->first_cluster_low  = 0;
-    entry->first_cluster_high = 0;
-    entry->file_size          = 0;
+    // The free slot must still be free when the entry is written, and the entry must be there
+    // for the lookup that follows
+    vfat_lookup_result_t new_lr;
+    WITH_MUTEX_CLASS(mnt->lock, vfat_lock_class)
+    {
+        vfat_lookup_result_t lr;
+        int                  res = vfat_lookup(dir, name, VFAT_LOOKUP_FREE, &lr);
+        if (res)
+            return res;
 
-    res = block_write(dir->v_mount->mnt_dev_vnode->v_data, lr.sector, blk, 512);
-    block_release(blk);
-    if (res)
-        return res;
+        if (use_lfn)
+            return -ENOSYS;
 
-    if (result) {
-        vfat_lookup_result_t new_lr;
-        res = vfat_lookup(dir, name, VFAT_LOOKUP_FIND, &new_lr);
+        void* blk;
+        res = block_read(dir->v_mount->mnt_dev_vnode->v_data, lr.sector, &blk, 512);
         if (res)
             return res;
-        res = vfat_vnode_get(dir->v_mount, &new_lr, result);
+
+        vfat_standard_entry_t* entry = (vfat_standard_entry_t*)((char*)blk + lr.offset);
+        memset(entry, 0, sizeof(vfat_standard_entry_t));
+        vfat_build_shortname((char*)entry->name, (const uint8_t*)name);
+        entry->attributes         = 0;
+        entry->first_cluster_low  = 0;
+        entry->first_cluster_high = 0;
+        entry->file_size          = 0;
+
+        res = block_write(dir->v_mount->mnt_dev_vnode->v_data, lr.sector, blk, 512);
+        block_release(blk);
         if (res)
             return res;
+
+        if (result) {
+            res = vfat_lookup(dir, name, VFAT_LOOKUP_FIND, &new_lr);
+            if (res)
+                return res;
+        }
     }
 
+    if (result)
+        return vfat_vnode_get(dir->v_mount, &new_lr, result);
     return 0;
 }
 
@@ -440,6 +457,20 @@ static ssize_t vfat_file_write(file_t* file, const void* buf, size_t count)
     return bytes;
 }
 
+static ssize_t vfat_file_pread(file_t* file, void* buf, size_t count, loff_t pos)
+{
+    if (!file->f_vnode)
+        return -EBADF;
+    return vfat_vnode_read(file->f_vnode, buf, count, (size_t)pos);
+}
+
+static ssize_t vfat_file_pwrite(file_t* file, const void* buf, size_t count, loff_t pos)
+{
+    if (!file->f_vnode)
+        return -EBADF;
+    return vfat_vnode_write(file->f_vnode, buf, count, (size_t)pos);
+}
+
 static int vfat_file_seek(file_t* file, loff_t offset, int whence)
 {
     if (!file->f_vnode)
@@ -205,6 +205,13 @@ file_t* vfs_open(const char* path, int flags, umode_t mode)
         }
     }
 
+    if (file->f_ops && file->f_ops->seek)
+        file->f_mode |= FMODE_LSEEK;
+    if (file->f_ops && file->f_ops->pread)
+        file->f_mode |= FMODE_PREAD;
+    if (file->f_ops && file->f_ops->pwrite)
+        file->f_mode |= FMODE_PWRITE;
+
     return file;
 }
 
@@ -263,6 +270,108 @@ ssize_t vfs_write(file_t* file, const void __user* buf, size_t count, size_t off
     return bytes;
 }
 
+// Reads at pos without moving the file position. Unlike vfs_read, pos 0 means the start of the file.
+ssize_t vfs_pread(file_t* file, void __user* buf, size_t count, loff_t pos)
+{
+    if (!file || !buf)
+        return -EINVAL;
+    if (!file->f_ops)
+        return -EBADF;
+    if (!(file->f_mode & FMODE_READ))
+        return -EACCES;
+    if (!(file->f_mode & FMODE_PREAD))
+        return -ESPIPE;
+
+    return file->f_ops->pread(file, buf, count, pos);
+}
+
+ssize_t vfs_pwrite(file_t* file, const void __user* buf, size_t count, loff_t pos)
+{
+    if (!file || !buf)
+        return -EINVAL;
+    if (!file->f_ops)
+        return -EBADF;
+    if (!(file->f_mode & FMODE_WRITE))
+        return -EACCES;
+    if (!(file->f_mode & FMODE_PWRITE))
+        return -ESPIPE;
+
+    return file->f_ops->pwrite(file, buf, count, pos);
+}
+
+// The total must be representable in the return value
+static int vfs_iov_check(const iovec_t* iov, int iovcnt)
+{
+    if (iovcnt < 0 || iovcnt > IOV_MAX)
+        return -EINVAL;
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > (size_t)SSIZE_MAX - total)
+            return -EINVAL;
+        total += iov[i].iov_len;
+    }
+    return 0;
+}
+
+// Fills each segment in turn from the file position, stopping at the first short read. An error
+// after some data was read is dropped in favour of the partial count, as for a short read.
+ssize_t vfs_readv(file_t* file, const iovec_t* iov, int iovcnt)
+{
+    if (!file || !iov)
+        return -EINVAL;
+    if (!file->f_ops || !file->f_ops->read)
+        return -EBADF;
+    if (!(file->f_mode & FMODE_READ))
+        return -EACCES;
+
+    int res = vfs_iov_check(iov, iovcnt);
+    if (res)
+        return res;
+
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (!iov[i].iov_len)
+            continue;
+
+        int bytes = file->f_ops->read(file, iov[i].iov_base, iov[i].iov_len);
+        if (bytes < 0)
+            return total ? total : bytes;
+        total += bytes;
+        if ((size_t)bytes < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
+ssize_t vfs_writev(file_t* file, const iovec_t* iov, int iovcnt)
+{
+    if (!file || !iov)
+        return -EINVAL;
+    if (!file->f_ops || !file->f_ops->write)
+        return -EBADF;
+    if (!(file->f_mode & FMODE_WRITE))
+        return -EACCES;
+
+    int res = vfs_iov_check(iov, iovcnt);
+    if (res)
+        return res;
+
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (!iov[i].iov_len)
+            continue;
+
+        int bytes = file->f_ops->write(file, iov[i].iov_base, iov[i].iov_len);
+        if (bytes < 0)
+            return total ? total : bytes;
+        total += bytes;
+        if ((size_t)bytes < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
 int vfs_llseek(file_t* file, loff_t offset, int whence)
 {
     if (!file)
@@ -273,6 +382,17 @@ int vfs_llseek(file_t* file, loff_t offset, int whence)
     return file->f_ops->seek(file, offset, whence);
 }
 
+// A filesystem without an fsync op keeps nothing buffered, so there is nothing to flush
+int vfs_fsync(file_t* file)
+{
+    if (!file || !file->f_vnode)
+        return -EBADF;
+    if (!file->f_vnode->v_ops || !file->f_vnode->v_ops->fsync)
+        return 0;
+
+    return file->f_vnode->v_ops->fsync(file->f_vnode);
+}
+
 int vfs_getdirent(file_t* file, char* __user buf, size_t count, int offset)
 {
     if (!file || !buf)
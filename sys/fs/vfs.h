@@ -5,6 +5,7 @@
 #include "vnode.h"
 
 #include <sys/device.h>
+#include <sys/uio.h>
 
 #include <kern/compiler.h>
 #include <kern/socket.h>
@@ -88,7 +89,12 @@ file_t* vfs_open(const char* path, int flags, umode_t mode);
 void    vfs_close(file_t* file);
 ssize_t vfs_read(file_t* file, void* __user buf, size_t count, size_t offset);
 ssize_t vfs_write(file_t* file, const void* __user buf, size_t count, size_t offset);
+ssize_t vfs_pread(file_t* file, void* __user buf, size_t count, loff_t pos);
+ssize_t vfs_pwrite(file_t* file, const void* __user buf, size_t count, loff_t pos);
+ssize_t vfs_readv(file_t* file, const iovec_t* iov, int iovcnt);
+ssize_t vfs_writev(file_t* file, const iovec_t* iov, int iovcnt);
 int     vfs_llseek(file_t* file, loff_t offset, int whence);
+int     vfs_fsync(file_t* file);
 
 int vfs_getdirent(file_t* file, char* __user buf, size_t count, int offset);
 
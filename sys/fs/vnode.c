@@ -17,10 +17,9 @@ void vnode_inc_ref(vnode_t* vnode)
 
 void vnode_dec_ref(vnode_t* vnode)
 {
-    if (__sync_fetch_and_sub(&vnode->v_refcount, 1) == 1) {
-        vnode_inactive(vnode); // Mark the vnode as inactive before reclaiming
-        vnode_reclaim(vnode);  // Reclaim the vnode when ref count reaches zero
-    }
+    // The last reference parks the vnode as inactive; it stays cached until a lookup revives it or
+    // the vnode cache shrinker reclaims it
+    vnode_cache_put(vnode);
 }
 
 int vnode_get(mount_t* mount, uint64_t file_id, vnode_t** result)
@@ -30,7 +29,8 @@ int vnode_get(mount_t* mount, uint64_t file_id, vnode_t** result)
 
 void vnode_inactive(vnode_t* vnode)
 {
-    vnode->v_ops->inactive(vnode);
+    if (vnode->v_ops && vnode->v_ops->inactive)
+        vnode->v_ops->inactive(vnode);
     WITH_SPINLOCK(vnode->v_mount->vnode_list_lock)
     {
         vnode_t** current = &vnode->v_mount->vnode_list;
@@ -56,23 +56,49 @@ void vnode_inactive(vnode_t* vnode)
     }
 }
 
-void vnode_reclaim(vnode_t* vnode)
+void vnode_activate(vnode_t* vnode)
 {
-    vnode->v_ops->reclaim(vnode);
-    WITH_SPINLOCK(vnode->v_mount->lazy_vnode_list_lock)
+    WITH_SPINLOCK(vnode->v_mount->vnode_list_lock)
     {
-        while (vnode->v_mount->lazy_vnode_list) {
-            if (vnode->v_mount->lazy_vnode_list == vnode) {
-                vnode->v_mount->lazy_vnode_list =
-                    vnode->v_mount->lazy_vnode_list->mnt_next; // Remove from lazy vnode list
-                vnode->v_mount->lazy_vnode_count--;
-                vnode_cache_remove(vnode); // Remove from vnode cache
-                kfree(vnode);              // Free the vnode memory
-                return;                    // Exit after removing
-            }
-            vnode->v_mount->lazy_vnode_list = vnode->v_mount->lazy_vnode_list->mnt_next;
+        WITH_SPINLOCK(vnode->v_mount->lazy_vnode_list_lock)
+        {
+            vnode_t** current = &vnode->v_mount->lazy_vnode_list;
+            while (*current && *current != vnode)
+                current = &(*current)->mnt_next;
+
+            if (!*current)
+                PANIC("Failed to remove vnode from mount's lazy vnode list during activation\n");
+
+            *current = vnode->mnt_next;
+            vnode->v_mount->lazy_vnode_count--;
         }
+
+        vnode->mnt_next            = vnode->v_mount->vnode_list;
+        vnode->v_mount->vnode_list = vnode;
+        vnode->v_mount->vnode_count++;
     }
+}
+
+int vnode_reclaim(vnode_t* vnode)
+{
+    mount_t* mnt = vnode->v_mount;
+
+    // Called by the vnode cache shrinker from allocation paths, so it must not wait
+    if (spin_trylock(&mnt->lazy_vnode_list_lock))
+        return -EBUSY;
+
+    vnode_t** current = &mnt->lazy_vnode_list;
+    while (*current && *current != vnode)
+        current = &(*current)->mnt_next;
+
+    if (!*current)
+        PANIC("Failed to remove vnode from mount's lazy vnode list during reclamation\n");
+
+    *current = vnode->mnt_next;
+    mnt->lazy_vnode_count--;
+    spin_unlock(&mnt->lazy_vnode_list_lock);
 
-    PANIC("Failed to remove vnode from mount's lazy vnode list during reclamation\n");
+    if (vnode->v_ops && vnode->v_ops->reclaim)
+        vnode->v_ops->reclaim(vnode);
+    return 0;
 }
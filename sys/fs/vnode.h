@@ -3,6 +3,8 @@
 
 #include <vm/types.h>
 
+#include <kern/rcu.h>
+
 #include "types.h"
 
 #include <inttypes.h>
@@ -122,16 +124,20 @@ typedef struct vnode {
     uint64_t file_id; // Unique identifier for the file (e.g., inode number)
     void*    v_data;  // Filesystem-specific data (e.g., pointer to inode)
 
-    vnode_t* hash_next; // For hash table chaining in vnode cache
-    vnode_t* mnt_next;  // For linked list of vnodes in a mount
+    vnode_t*   hash_next; // For hash table chaining in vnode cache, walked under RCU
+    vnode_t*   mnt_next;  // For linked list of vnodes in a mount
+    rcu_head_t v_rcu;     // Frees the vnode once lookups can no longer reach it
 } vnode_t;
 
 void vnode_inc_ref(vnode_t* vnode);
 void vnode_dec_ref(vnode_t* vnode);
 
 int  vnode_get(mount_t* mount, uint64_t file_id, vnode_t** result);
+/* Moves an unreferenced vnode to its mount's lazy list, and back once it is referenced again */
 void vnode_inactive(vnode_t* vnode);
-void vnode_reclaim(vnode_t* vnode);
+void vnode_activate(vnode_t* vnode);
+/* Releases an inactive vnode's filesystem data; the vnode cache unhashes and frees it */
+int  vnode_reclaim(vnode_t* vnode);
 
 vm_object_t* vnode_get_object(vnode_t* vnode);
 
@@ -3,40 +3,147 @@
 #include "vnode.h"
 
 #include <kern/errno.h>
+#include <kern/lockstat.h>
+#include <kern/rcu.h>
 #include <kern/spinlock.h>
 #include <kern/terminal.h>
 
 #include <vm/kmalloc.h>
+#include <vm/vm_shrinker.h>
 
 #include <string.h>
 
 vnode_cache_bucket_t node_cache[MAX_VNODE_CACHE_SIZE];
 
+LOCK_CLASS(vnode_cache_lock_class, "vnode_cache");
+
+static int vnode_cache_cursor; // Bucket the shrinker resumes from
+
+static int vnode_cache_index(mount_t* mnt, uint64_t file_id)
+{
+    return ((uint32_t)mnt ^ (uint32_t)file_id) % MAX_VNODE_CACHE_SIZE;
+}
+
+static size_t vnode_cache_count(vm_shrinker_t* shrinker)
+{
+    (void)shrinker;
+
+    size_t count = 0;
+    WITH_RCU_READ_LOCK()
+    {
+        for (int i = 0; i < mount_count; i++) {
+            mount_t* mnt = rcu_dereference(mount_table[i]);
+            if (mnt)
+                count += mnt->lazy_vnode_count;
+        }
+    }
+    return count * sizeof(vnode_t);
+}
+
+// Frees unreferenced vnodes until about nr bytes of heap are on their way back to kmalloc
+static size_t vnode_cache_scan(vm_shrinker_t* shrinker, size_t nr)
+{
+    (void)shrinker;
+
+    size_t freed = 0;
+    for (int n = 0; n < MAX_VNODE_CACHE_SIZE && freed < nr; n++) {
+        int index          = vnode_cache_cursor;
+        vnode_cache_cursor = (vnode_cache_cursor + 1) % MAX_VNODE_CACHE_SIZE;
+
+        // A busy bucket is skipped rather than waited on; the next pass picks it up
+        mcs_node_t node;
+        if (mcs_trylock(&node_cache[index].lock, &node))
+            continue;
+
+        vnode_t** current = &node_cache[index].head;
+        while (*current && freed < nr) {
+            vnode_t* vnode = *current;
+            if (vnode->v_refcount || vnode_reclaim(vnode)) {
+                current = &vnode->hash_next;
+                continue;
+            }
+
+            rcu_assign_pointer(*current, vnode->hash_next);
+            vnode_cache_free(vnode);
+            freed += sizeof(vnode_t);
+        }
+
+        mcs_unlock(&node_cache[index].lock, &node);
+    }
+
+    return freed;
+}
+
+static vm_shrinker_t vnode_cache_shrinker = {
+    .name  = "vnode_cache",
+    .pool  = VM_SHRINK_KMALLOC,
+    .count = vnode_cache_count,
+    .scan  = vnode_cache_scan,
+};
+
+static void vnode_cache_free_rcu(rcu_head_t* head)
+{
+    kfree(container_of(head, vnode_t, v_rcu));
+}
+
+void vnode_cache_free(vnode_t* vnode)
+{
+    call_rcu(&vnode->v_rcu, vnode_cache_free_rcu);
+}
+
+// Takes a reference unless the vnode has none. An unreferenced vnode may be moving to or from its
+// mount's lazy list, and only a lookup holding the bucket lock may revive it.
+static bool vnode_cache_tryget(vnode_t* vnode)
+{
+    uint32_t refs = vnode->v_refcount;
+    while (refs) {
+        uint32_t prev = __sync_val_compare_and_swap(&vnode->v_refcount, refs, refs + 1);
+        if (prev == refs)
+            return true;
+        refs = prev;
+    }
+    return false;
+}
+
 int vnode_cache_init(void)
 {
     memset(node_cache, 0, sizeof(node_cache));
+    vm_shrinker_register(&vnode_cache_shrinker);
     return 0;
 }
 
+void vnode_cache_put(vnode_t* vnode)
+{
+    int index = vnode_cache_index(vnode->v_mount, vnode->file_id);
+
+    // Dropping the last reference under the bucket lock keeps a concurrent lookup from reviving the
+    // vnode halfway through its move to the lazy list
+    WITH_MCS_LOCK_CLASS(node_cache[index].lock, vnode_cache_lock_class)
+    {
+        if (__sync_sub_and_fetch(&vnode->v_refcount, 1) == 0)
+            vnode_inactive(vnode);
+    }
+}
+
 int vnode_cache_remove(vnode_t* vnode)
 {
     if (!vnode)
         return -EINVAL;
 
-    uint64_t key   = (uint32_t)vnode->v_mount ^ vnode->file_id;
-    int      index = key % MAX_VNODE_CACHE_SIZE;
+    int index = vnode_cache_index(vnode->v_mount, vnode->file_id);
 
-    WITH_SPINLOCK(node_cache[index].lock)
+    WITH_MCS_LOCK_CLASS(node_cache[index].lock, vnode_cache_lock_class)
     {
         vnode_t* current = node_cache[index].head;
         vnode_t* prev    = NULL;
         while (current) {
             if (current == vnode) {
+                // current keeps its link, so a lookup standing on it still reaches the rest
                 if (prev) {
-                    prev->hash_next = current->hash_next;
+                    rcu_assign_pointer(prev->hash_next, current->hash_next);
                 }
                 else {
-                    node_cache[index].head = current->hash_next;
+                    rcu_assign_pointer(node_cache[index].head, current->hash_next);
                 }
                 return 0; // Success
             }
@@ -53,15 +160,29 @@ int vnode_cache_lookup(mount_t* mnt, uint64_t file_id, vnode_t** result)
     if (!mnt || !result)
         return -EINVAL;
 
-    uint64_t key   = (uint32_t)mnt ^ file_id;
-    int      index = key % MAX_VNODE_CACHE_SIZE;
+    int index = vnode_cache_index(mnt, file_id);
+
+    // Referenced vnodes are found without taking the bucket lock
+    WITH_RCU_READ_LOCK()
+    {
+        vnode_t* current = rcu_dereference(node_cache[index].head);
+        while (current) {
+            if (current->v_mount == mnt && current->file_id == file_id &&
+                vnode_cache_tryget(current)) {
+                *result = current;
+                return 0; // Success
+            }
+            current = rcu_dereference(current->hash_next);
+        }
+    }
 
-    WITH_SPINLOCK(node_cache[index].lock)
+    WITH_MCS_LOCK_CLASS(node_cache[index].lock, vnode_cache_lock_class)
     {
         vnode_t* current = node_cache[index].head;
         while (current) {
             if (current->v_mount == mnt && current->file_id == file_id) {
-                vnode_inc_ref(current);
+                if (__sync_fetch_and_add(&current->v_refcount, 1) == 0)
+                    vnode_activate(current); // Revive a cached, unreferenced vnode
                 *result = current;
                 return 0; // Success
             }
@@ -83,8 +204,8 @@ int vnode_cache_lookup(mount_t* mnt, uint64_t file_id, vnode_t** result)
         new_vnode->file_id    = file_id;
         new_vnode->v_refcount = 1;
 
-        new_vnode->hash_next   = node_cache[index].head;
-        node_cache[index].head = new_vnode;
+        new_vnode->hash_next = node_cache[index].head;
+        rcu_assign_pointer(node_cache[index].head, new_vnode);
 
         WITH_SPINLOCK(mnt->vnode_list_lock)
         {
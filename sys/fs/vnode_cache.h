@@ -11,11 +11,19 @@
 
 typedef struct vnode_cache_bucket {
     vnode_t*   head; // Head of the linked list for this bucket
-    spinlock_t lock; // Lock to protect this bucket
+    mcs_lock_t lock; // Lock to protect this bucket
 } vnode_cache_bucket_t;
 
-int vnode_cache_init(void);
-int vnode_cache_remove(vnode_t* vnode);
-int vnode_cache_lookup(mount_t* mnt, uint64_t file_id, vnode_t** result);
+/*
+ * Lookups walk the hash chains under RCU and take no lock when the vnode is referenced. Writers
+ * hold the bucket lock, and a vnode unlinked from its chain is freed with vnode_cache_free.
+ */
+
+int  vnode_cache_init(void);
+int  vnode_cache_remove(vnode_t* vnode);
+/* Frees a vnode removed from the cache once no lookup can still be looking at it */
+void vnode_cache_free(vnode_t* vnode);
+void vnode_cache_put(vnode_t* vnode);
+int  vnode_cache_lookup(mount_t* mnt, uint64_t file_id, vnode_t** result);
 
 #endif // FS_VNODE_CACHE_H
@@ -1,8 +1,12 @@
 #include "gdt.h"
 
+#include <sys/pcpu.h>
+
 #include <machine/segment.h>
 #include <machine/tss.h>
 
+#include <string.h>
+
 seg_desc_t gdt[NGDT] = {
     // GNULL_SEL
     {.sd_low_limit   = 0,
@@ -132,3 +136,24 @@ seg_desc_t gdt[NGDT] = {
         .sd_size        = 0, // Must be 0 for TSS
         .sd_granularity = 0  // Must be byte granularity for TSS
     }};
+
+void gdt_init_pcpu(pcpu_t* pc)
+{
+    memcpy(pc->gdt, gdt, sizeof(pc->gdt));
+    SET_SEGMENT_BASE(pc->gdt[GPRIV_SEL], (uintptr_t)pc);
+    SET_SEGMENT_BASE(pc->gdt[GPROC0_SEL], (uintptr_t)&pc->tss);
+
+    region_desc_t r_gdt;
+    r_gdt.rd_limit = sizeof(pc->gdt) - 1;
+    r_gdt.rd_base  = (uintptr_t)pc->gdt;
+    lgdt(&r_gdt);
+    load_tss(GPROC0_SEL << 3);
+}
+
+// Points the user %gs segment of pc at a thread's TLS block. The descriptor is only read when %gs
+// is loaded, which every return to user mode does from the saved trapframe, on the CPU the thread
+// was just switched in on.
+void gdt_set_user_tls(pcpu_t* pc, uintptr_t base)
+{
+    SET_SEGMENT_BASE(pc->gdt[GUGS_SEL], base);
+}
@@ -6,8 +6,13 @@
 
 #include <inttypes.h>
 
-extern seg_desc_t gdt[NGDT];
+typedef struct pcpu pcpu_t;
+
+extern seg_desc_t gdt[NGDT]; // Template each CPU copies its own GDT from
 
 void lgdt(region_desc_t* gdt_desc);
+/* Gives pc its own copy of the GDT, pointing the per-CPU and TSS entries at it, and loads it */
+void gdt_init_pcpu(pcpu_t* pc);
+void gdt_set_user_tls(pcpu_t* pc, uintptr_t base);
 
 #endif // I386_GDT_H
@@ -6,6 +6,7 @@
 #include <machine/segment_i386.h>
 
 #include <kern/isr.h>
+#include <kern/lapic.h>
 
 // The IDT and IDT pointer
 gate_desc_t   idt[IDT_SIZE];
@@ -39,11 +40,20 @@ static void remap_pic()
     outb(0x21, 0x01); // 8086/88 (MCS-80/85) mode
     outb(0xA1, 0x01); // 8086/88 (MCS-80/85) mode
 
-    outb(0x21, 0xFC); // Unmask all interrupts on Master PIC except IRQ0 (timer) and IRQ1 (keyboard)
+    outb(0x21, 0xFD); // Unmask only IRQ1 (keyboard) on Master PIC, the LAPIC timer replaces IRQ0
     outb(0xA1, 0xFF); // Unmask all interrupts on Slave PIC (if needed, adjust this to unmask
                       // specific IRQs on the slave)
 }
 
+void pic_unmask_irq(uint8_t irq)
+{
+    if (irq >= 8) {
+        outb(0xA1, inb(0xA1) & ~(1 << (irq - 8)));
+        irq = 2; // The slave PIC is cascaded through IRQ2
+    }
+    outb(0x21, inb(0x21) & ~(1 << irq));
+}
+
 // Load the IDT into the CPU using the LIDT instruction
 void load_idt()
 {
@@ -91,10 +101,14 @@ int idt_init()
     set_idt_entry(30, (uint32_t)isr30, 0x20, 0xE, 0); // Reserved
     set_idt_entry(31, (uint32_t)isr31, 0x20, 0xE, 0); // Reserved
     set_idt_entry(32, (uint32_t)isr32, 0x20, 0xE,
-                  0); // Reserved (IRQ0 - Programmable Interval Timer)
+                  0); // yield() (IRQ0 - Programmable Interval Timer, left masked)
     set_idt_entry(33, (uint32_t)isr33, 0x20, 0xE, 0);   // Keyboard interrupt (IRQ1)
     set_idt_entry(40, (uint32_t)isr40, 0x20, 0xE, 0);   // IRQ8 (Real-time clock)
+    set_idt_entry(46, (uint32_t)isr46, 0x20, 0xE, 0);   // IRQ14 (Primary ATA channel)
+    set_idt_entry(47, (uint32_t)isr47, 0x20, 0xE, 0);   // IRQ15 (Secondary ATA channel)
+    set_idt_entry(64, (uint32_t)isr64, 0x20, 0xE, 0);   // LAPIC timer
     set_idt_entry(128, (uint32_t)isr128, 0x20, 0xE, 3); // System call interrupt (INT 0x80)
+    set_idt_entry(240, (uint32_t)isr240, 0x20, 0xE, 0); // Reschedule IPI
 
     interrupt_register(0, isr_divide_by_zero);
     interrupt_register(1, isr_debug);
@@ -117,10 +131,12 @@ int idt_init()
     interrupt_register(18, isr_machine_check);
     interrupt_register(19, isr_simd_floating_point);
 
-    interrupt_register(32, isr_timer_handler);
+    interrupt_register(32, isr_yield_handler);
     interrupt_register(33, isr_keyboard_handler);
 
+    interrupt_register(TIMER_VECTOR, isr_timer_handler);
     interrupt_register(128, isr_syscall);
+    interrupt_register(RESCHED_VECTOR, isr_resched_handler);
 
     ip.rd_limit = (sizeof(gate_desc_t) * IDT_SIZE) - 1;
     ip.rd_base  = (uint32_t)&idt;
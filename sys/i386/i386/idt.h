@@ -42,9 +42,17 @@ extern void isr31();
 extern void isr32();
 extern void isr33();
 extern void isr40();
+extern void isr46();
+extern void isr47();
+extern void isr64();
 extern void isr128();
+extern void isr240();
+extern void sysenter_entry();
+
+#define PIC_IRQ_BASE 0x20 // Vector of IRQ0 once the PICs are remapped
 
 void load_idt();
 int  idt_init(void);
+void pic_unmask_irq(uint8_t irq);
 
 #endif // I386_IDT_H
@@ -14,29 +14,35 @@
 
 #include <vm/kmalloc.h>
 #include <vm/layout.h>
+#include <vm/vm_kstack.h>
 #include <vm/vm_map.h>
+#include <vm/vm_merge.h>
 #include <vm/vm_phys.h>
+#include <vm/vm_shrinker.h>
 #include <vm/vm_space.h>
+#include <vm/vm_zswap_pager.h>
 
 #include <x86/bios/bda.h>
 
 #include <machine/bootinfo.h>
 #include <machine/segment_i386.h>
 
+#include <kern/clock.h>
 #include <kern/elf.h>
 #include <kern/errno.h>
 #include <kern/lapic.h>
+#include <kern/lockstat.h>
 #include <kern/panic.h>
 #include <kern/pit.h>
 #include <kern/process.h>
+#include <kern/rcu.h>
 #include <kern/syscalls.h>
 #include <kern/system_init.h>
 #include <kern/terminal.h>
+#include <kern/timer.h>
 
 void init386(void)
 {
-    region_desc_t r_gdt;
-
     terminal_init();
 
     // Initialise the gdt
@@ -51,13 +57,7 @@ void init386(void)
     pcpu_t* pc = &pcpus[0];
     write_tss(&pc->tss, 0x10, KERNEL_STACK_TOP); // Set kernel stack segment and pointer in TSS
     SET_SEGMENT_LIMIT(gdt[GPRIV_SEL], 0xFFFFF);
-    SET_SEGMENT_BASE(gdt[GPRIV_SEL], (uintptr_t)pc);
-    SET_SEGMENT_BASE(gdt[GPROC0_SEL], (uintptr_t)&pc->tss);
-
-    r_gdt.rd_limit = NGDT * sizeof(gdt[0]) - 1;
-    r_gdt.rd_base  = (uintptr_t)&gdt;
-    lgdt(&r_gdt);
-    load_tss(GPROC0_SEL << 3);
+    gdt_init_pcpu(pc);
 
     kmalloc_init((char*)KMALLOC_START, KMALLOC_SIZE);
 
@@ -76,6 +76,25 @@ void init386(void)
 
     pcpu_init(0);
 
+    if (is_errno(vm_kstack_init()))
+        PANIC("Kernel stack initialization: FAILED");
+
+    clock_init();
+
+    timer_init();
+
+    if (is_errno(rcu_init()))
+        PANIC("RCU initialization: FAILED");
+
+    if (is_errno(sched_reaper_init()))
+        PANIC("Reaper initialization: FAILED");
+
+    if (is_errno(vm_reclaim_init()))
+        PANIC("Memory reclaim initialization: FAILED");
+
+    if (is_errno(zswap_init()))
+        PANIC("Compressed swap initialization: FAILED");
+
     asm volatile("sti"); // Enable interrupts
 
     if (is_errno(load_bda()))
@@ -92,12 +111,25 @@ void init386(void)
     tty_init();
     vga_init();
 
+#ifdef LOCKSTAT
+    if (is_errno(lockstat_init()))
+        PANIC("Lock statistics initialization: FAILED");
+#endif
+
+    if (is_errno(zswap_dev_init()))
+        PANIC("Compressed swap statistics initialization: FAILED");
+
     vfs_list_devices();
 
+#ifdef VM_MERGE
+    if (is_errno(vm_merge_init()))
+        PANIC("Same-page merging initialization: FAILED");
+#endif
+
     system_init();
 
     // list_tasks();
 
-    while (1)
-        yield();
+    // The boot context carries on as this CPU's idle thread
+    sched_idle();
 }
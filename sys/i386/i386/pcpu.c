@@ -1,7 +1,26 @@
+#include "idt.h"
+
 #include <sys/pcpu.h>
 
+#include <machine/cpufunc.h>
+#include <machine/pmap.h>
+
 #include <kern/terminal.h>
 
+// SYSENTER loads a fixed stack pointer, so it is pointed at this CPU's tss.esp0 rather than at a
+// stack; sysenter_entry then loads the current thread's kernel stack from there
+static void machdep_init_sysenter(pcpu_t* pcpu)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_SEP))
+        return; // User code has to stick to int $0x80
+
+    wrmsr(MSR_IA32_SYSENTER_CS, GSEL(GCODE_SEL, SEL_KPL));
+    wrmsr(MSR_IA32_SYSENTER_ESP, (uintptr_t)&pcpu->tss.esp0);
+    wrmsr(MSR_IA32_SYSENTER_EIP, (uintptr_t)sysenter_entry);
+}
+
 void machdep_init_pcpu(pcpu_t* pcpu, MACHDEP_PARAMS)
 {
     uint16_t sel = GSEL(GPRIV_SEL, SEL_KPL);
@@ -10,6 +29,8 @@ void machdep_init_pcpu(pcpu_t* pcpu, MACHDEP_PARAMS)
                  : "r"(sel));
     pcpu->apic_id = apic_id;
     write_tss(&pcpu->tss, GSEL(GDATA_SEL, SEL_KPL), 0);
+    pmap_init_pat();
+    machdep_init_sysenter(pcpu);
 }
 
 pcpu_t* get_pcpu_by_apic_id(uint32_t apic_id)
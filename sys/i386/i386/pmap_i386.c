@@ -1,11 +1,13 @@
 #include <vm/kmalloc.h>
 #include <vm/types.h>
 #include <vm/vm_phys.h>
+#include <vm/vm_space.h>
 
 #include <machine/page_table.h>
 #include <machine/pmap.h>
 
 #include <kern/errno.h>
+#include <kern/lockstat.h>
 #include <kern/panic.h>
 #include <kern/spinlock.h>
 #include <kern/terminal.h>
@@ -15,31 +17,43 @@
 #define TABLE_IDX(virt) ((uint32_t)virt >> 22)
 #define ENTRY_IDX(virt) (((uint32_t)virt >> 12) & 0x3FF)
 
+LOCK_CLASS(pmap_lock_class, "pmap");
+
+/* Foreign user mappings are not cached by this CPU, but kernel page tables are shared by all */
+static inline bool pmap_needs_invlpg(pmap_window_t* win, vaddr_t virt)
+{
+    return !win->alt || virt >= KERNEL_BASE;
+}
+
 void pmap_destroy(pmap_t* pmap)
 {
-    page_table_t* old_pd = *current_pd_addr;
-    switch_page_directory(&pmap->pd); // Switch to the kernel page directory
+    // The directory is about to be freed, so it must not stay loaded
+    if (pmap_is_current(pmap))
+        pmap_activate(kernel_vm_space.arch);
 
-    WITH_SPINLOCK(pmap->lock)
+    WITH_MCS_LOCK_CLASS(pmap->lock, pmap_lock_class)
     {
+        pmap_window_t win;
+        pmap_window_enter(pmap, &win);
+
         // Assumes that all user-space mappings have been removed, so we only need to free the page
         // tables
         for (int i = 0; i < KERNEL_PAGE_ENTRY_START; i++) {
-            if (current_pd->entries[i] & 0x1) {
-                page_table_t* table = (page_table_t*)(current_pd->entries[i] & ~PAGE_MASK);
+            if (win.pd->entries[i] & 0x1) {
+                page_table_t* table = (page_table_t*)(win.pd->entries[i] & ~PAGE_MASK);
+                page_table_t* pt    = pmap_window_table(&win, i);
                 for (int j = 0; j < PAGE_ENTRIES_PER_TABLE; j++) {
-                    if (current_pts[i].entries[j] & 0x1) {
+                    if (pt->entries[j] & 0x1) {
                         // If the page is present, free the physical page it maps to
-                        paddr_t phys = current_pts[i].entries[j] & ~PAGE_MASK;
+                        paddr_t phys = pt->entries[j] & ~PAGE_MASK;
                         vm_phys_free_page(phys);
                     }
                 }
-                memset(&current_pts[i], 0, PAGE_SIZE);
                 vm_phys_free_page((paddr_t)table);
             }
         }
 
-        switch_page_directory(&old_pd); // Switch back to the original page directory
+        pmap_window_exit(&win);
     }
 
     vm_phys_free_page((paddr_t)pmap->pd);
@@ -51,109 +65,141 @@ int pmap_enter(pmap_t* pmap, vaddr_t virt, paddr_t phys, vm_prot_t prot, pmap_fl
     uint32_t table_idx = TABLE_IDX(virt);
     uint32_t entry_idx = ENTRY_IDX(virt);
 
-    WITH_SPINLOCK(pmap->lock)
+    WITH_MCS_LOCK_CLASS(pmap->lock, pmap_lock_class)
     {
-        page_table_t* table = current_pd;
+        pmap_window_t win;
+        pmap_window_enter(pmap, &win);
+
+        page_table_t* table = win.pd;
         if (!(table->entries[table_idx] & 0x1)) {
             page_table_t* new_table = (page_table_t*)vm_phys_alloc_page();
-            if (is_errno((paddr_t)new_table))
+            if (!new_table) {
+                pmap_window_exit(&win);
                 return -ENOMEM;
+            }
             table->entries[table_idx] =
                 (page_entry_t)new_table | VM_PROT_READ | VM_PROT_WRITE | VM_PROT_USER;
-            tlb_invlpg(&current_pts[table_idx]);
-            memset(&current_pts[table_idx], 0, PAGE_SIZE);
+            tlb_invlpg(&win.pts[table_idx]);
+            memset(&win.pts[table_idx], 0, PAGE_SIZE);
         }
 
-        page_entry_t* entry = &current_pts[table_idx].entries[entry_idx];
+        page_entry_t* entry = &pmap_window_table(&win, table_idx)->entries[entry_idx];
 
-        if (flags & PMAP_FLAG_NOCACHE) {
-            prot |= VM_PROT_NOCACHE;
-        }
+        prot = (prot & ~PMAP_CACHE_MASK) | pmap_cache_bits(flags);
 
         *entry = (page_entry_t)(phys & 0xFFFFF000) | (prot & 0xFFF) | VM_PROT_READ;
-        tlb_invlpg((void*)virt);
 
-        if (flags & PMAP_FLAG_ZERO) {
-            memset((void*)virt, 0, PAGE_SIZE);
-        }
+        pmap_window_exit(&win);
+
+        if (pmap_needs_invlpg(&win, virt))
+            tlb_invlpg((void*)virt);
     }
 
+    if (flags & PMAP_FLAG_ZERO)
+        pmap_zero_page(phys);
+
     return 0;
 }
 
 void pmap_remove(pmap_t* pmap, vaddr_t sva, vaddr_t eva)
 {
-    SWITCH_SPACE(pmap);
-
-    WITH_SPINLOCK(pmap->lock)
+    WITH_MCS_LOCK_CLASS(pmap->lock, pmap_lock_class)
     {
+        pmap_window_t win;
+        pmap_window_enter(pmap, &win);
+
+        page_table_t* pt      = NULL;
+        uint32_t      pt_last = (uint32_t)-1;
+
         for (vaddr_t addr = sva; addr < eva; addr += PAGE_SIZE) {
             uint32_t table_idx = TABLE_IDX(addr);
             uint32_t entry_idx = ENTRY_IDX(addr);
 
-            page_table_t* table = current_pd;
+            page_table_t* table = win.pd;
             if (!(table->entries[table_idx] & 0x1)) {
                 continue; // Page table not present
             }
 
-            page_entry_t* entry = &current_pts[table_idx].entries[entry_idx];
+            if (table_idx != pt_last) {
+                pt      = pmap_window_table(&win, table_idx);
+                pt_last = table_idx;
+            }
+
+            page_entry_t* entry = &pt->entries[entry_idx];
             if (!(*entry & VM_PROT_READ)) {
                 continue; // Page not mapped
             }
 
             *entry = 0; // Clear the entry
-            tlb_invlpg((void*)addr);
+            if (pmap_needs_invlpg(&win, addr))
+                tlb_invlpg((void*)addr);
         }
+
+        pmap_window_exit(&win);
     }
 }
 
 void pmap_protect(pmap_t* pmap, vaddr_t sva, vaddr_t eva, vm_prot_t prot)
 {
-    SWITCH_SPACE(pmap);
-
-    WITH_SPINLOCK(pmap->lock)
+    WITH_MCS_LOCK_CLASS(pmap->lock, pmap_lock_class)
     {
+        pmap_window_t win;
+        pmap_window_enter(pmap, &win);
+
+        page_table_t* pt      = NULL;
+        uint32_t      pt_last = (uint32_t)-1;
+
         for (vaddr_t addr = sva; addr < eva; addr += PAGE_SIZE) {
             uint32_t table_idx = TABLE_IDX(addr);
             uint32_t entry_idx = ENTRY_IDX(addr);
 
-            page_table_t* table = current_pd;
+            page_table_t* table = win.pd;
             if (!(table->entries[table_idx] & 0x1)) {
                 continue; // Page table not present
             }
 
-            page_entry_t* entry = &current_pts[table_idx].entries[entry_idx];
+            if (table_idx != pt_last) {
+                pt      = pmap_window_table(&win, table_idx);
+                pt_last = table_idx;
+            }
+
+            page_entry_t* entry = &pt->entries[entry_idx];
             if (!(*entry & VM_PROT_READ)) {
                 continue; // Page not mapped
             }
 
-            *entry = (page_entry_t)(((uintptr_t)*entry & ~PAGE_MASK) | (prot & PAGE_MASK));
-            tlb_invlpg((void*)addr);
+            // Only the access bits change; the memory type chosen at pmap_enter time is kept
+            *entry = (page_entry_t)(((uintptr_t)*entry & (~PAGE_MASK | PMAP_CACHE_MASK)) |
+                                    (prot & PAGE_MASK & ~PMAP_CACHE_MASK));
+            if (pmap_needs_invlpg(&win, addr))
+                tlb_invlpg((void*)addr);
         }
+
+        pmap_window_exit(&win);
     }
 }
 
 paddr_t pmap_extract(pmap_t* pmap, vaddr_t virt)
 {
-    SWITCH_SPACE(pmap);
+    paddr_t phys = -ENOENT;
 
-    WITH_SPINLOCK(pmap->lock)
+    WITH_MCS_LOCK_CLASS(pmap->lock, pmap_lock_class)
     {
         uint32_t table_idx = TABLE_IDX(virt);
         uint32_t entry_idx = ENTRY_IDX(virt);
 
-        page_table_t* table = current_pd;
-        if (!(table->entries[table_idx] & 0x1)) {
-            return -ENOENT; // Page table not present
-        }
+        pmap_window_t win;
+        pmap_window_enter(pmap, &win);
 
-        page_entry_t* entry = &current_pts[table_idx].entries[entry_idx];
-        if (!(*entry & VM_PROT_READ)) {
-            return -ENOENT; // Page not mapped
+        page_table_t* table = win.pd;
+        if (table->entries[table_idx] & 0x1) {
+            page_entry_t entry = pmap_window_table(&win, table_idx)->entries[entry_idx];
+            if (entry & VM_PROT_READ)
+                phys = (paddr_t)(entry & 0xFFFFF000);
         }
 
-        return (paddr_t)(*entry & 0xFFFFF000);
+        pmap_window_exit(&win);
     }
 
-    return 0;
+    return phys;
 }
@@ -8,9 +8,10 @@ int main()
 {
     ASSYM(UCSEL, GSEL(GUCODE_SEL, SEL_UPL));
     ASSYM(UDSEL, GSEL(GUDATA_SEL, SEL_UPL));
+    ASSYM(UGSSEL, GSEL(GUGS_SEL, SEL_UPL));
     ASSYM(KCSEL, GSEL(GCODE_SEL, SEL_KPL));
     ASSYM(KDSEL, GSEL(GDATA_SEL, SEL_KPL));
-    ASSYM(KPSEL, GSEL(GDATA_SEL, SEL_KPL));
+    ASSYM(KPSEL, GSEL(GPRIV_SEL, SEL_KPL));
 
     ASSYM(SCHEDULER_LOCK_OFFSET, offsetof(pcpu_t, scheduler_lock));
     ASSYM(PCPU_ESP0_OFFSET, offsetof(pcpu_t, tss.esp0));
@@ -1,7 +0,0 @@
-#define UCSEL                 51
-#define UDSEL                 59
-#define KCSEL                 32
-#define KDSEL                 40
-#define KPSEL                 40
-#define SCHEDULER_LOCK_OFFSET 4
-#define PCPU_ESP0_OFFSET      48
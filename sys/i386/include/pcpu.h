@@ -7,6 +7,7 @@
 #define PCPU_MD_FIELDS                                                                             \
     tss_t      tss;         /* Task State Segment for this CPU */                                  \
     seg_desc_t pc_tss_desc; /* GDT descriptor for the TSS */                                       \
+    seg_desc_t gdt[NGDT];   /* This CPU's GDT, copied from the boot template by gdt_init_pcpu */   \
     uint32_t   apic_id;                                                                            \
     uint32_t   acpi_id;
 
@@ -0,0 +1,132 @@
+#include "clock.h"
+#include "errno.h"
+#include "panic.h"
+#include "pit.h"
+#include "terminal.h"
+#include "timer.h"
+
+#include <vm/layout.h>
+#include <vm/vm_map.h>
+#include <vm/vm_region.h>
+#include <vm/vm_space.h>
+
+#include <machine/cpufunc.h>
+
+#include <string.h>
+
+#define CLOCK_CALIBRATE_MS 50
+
+static volatile time_page_t* time_page;
+static vm_object_t*          time_page_object; // Backs the page, shared by every user mapping
+
+// delta * mult can be 96 bits wide, so each 32 bit half of delta is scaled on its own
+static uint64_t clock_scale(uint64_t delta, uint32_t mult, uint32_t shift)
+{
+    uint64_t lo = ((uint64_t)(uint32_t)delta * mult) >> shift;
+    uint64_t hi = ((uint64_t)(uint32_t)(delta >> 32) * mult) << (32 - shift);
+    return lo + hi;
+}
+
+// Ticks per CLOCK_CALIBRATE_MS of PIT time, 0 if the TSC is missing or unusable
+static uint64_t clock_calibrate(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_TSC))
+        return 0;
+
+    uint32_t eflags = intr_disable();
+    uint64_t start  = rdtsc();
+    delay_ms(CLOCK_CALIBRATE_MS);
+    uint64_t ticks = rdtsc() - start;
+    intr_restore(eflags);
+
+    // Slower than a tick per microsecond is no better than the timer wheel
+    if (ticks < CLOCK_CALIBRATE_MS * 1000 || ticks >> 32)
+        return 0;
+    return ticks;
+}
+
+void clock_init(void)
+{
+    time_page = kvm_map(PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_WIRED);
+    if (IS_ERR(time_page))
+        PANIC("clock_init: Failed to allocate the time page");
+    memset((void*)time_page, 0, PAGE_SIZE);
+
+    vm_region_t* region = vm_region_lookup(&kernel_vm_space, (vaddr_t)time_page, NULL);
+    if (!region || !region->object)
+        PANIC("clock_init: The time page has no backing object to share");
+    time_page_object = region->object;
+
+    // machdep_init_sysenter only sets SYSENTER up where the CPU has it
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    if (edx & CPUID_EDX_SEP)
+        time_page->flags = TIME_PAGE_F_SYSENTER;
+
+    uint64_t ticks = clock_calibrate();
+    if (!ticks) {
+        printf("clock: No usable TSC, CLOCK_MONOTONIC falls back to the timer\n");
+        return;
+    }
+
+    // The largest shift that keeps mult in 32 bits, for the most precision
+    uint64_t window_ns = (uint64_t)CLOCK_CALIBRATE_MS * (NSEC_PER_SEC / 1000);
+    uint32_t shift     = 32;
+    while (shift && ((window_ns << shift) >> 32) >= ticks)
+        shift--;
+
+    time_page->seq++;
+    __sync_synchronize();
+    time_page->mult     = udiv64_32(window_ns << shift, (uint32_t)ticks, NULL);
+    time_page->shift    = shift;
+    time_page->tsc_base = rdtsc();
+    time_page->ns_base  = 0;
+    time_page->flags |= TIME_PAGE_F_TSC;
+    __sync_synchronize();
+    time_page->seq++;
+
+    printf("clock: TSC runs at %u kHz\n", udiv64_32(ticks, CLOCK_CALIBRATE_MS, NULL));
+}
+
+uint64_t clock_now_ns(void)
+{
+    if (!time_page || !(time_page->flags & TIME_PAGE_F_TSC))
+        return timer_now() * NSEC_PER_USEC;
+
+    uint32_t seq;
+    uint64_t ns;
+    do {
+        seq = time_page->seq;
+        __sync_synchronize();
+        ns = time_page->ns_base +
+             clock_scale(rdtsc() - time_page->tsc_base, time_page->mult, time_page->shift);
+        __sync_synchronize();
+    } while ((seq & 1) || seq != time_page->seq);
+
+    return ns;
+}
+
+int clock_gettime(clockid_t clock, struct timespec* tp)
+{
+    if (clock != CLOCK_MONOTONIC)
+        return -EINVAL;
+    if (!tp)
+        return -EFAULT;
+
+    // The seconds fit the 32 bit quotient divl leaves for 136 years
+    uint32_t nsec;
+    tp->tv_sec  = udiv64_32(clock_now_ns(), NSEC_PER_SEC, &nsec);
+    tp->tv_nsec = nsec;
+    return 0;
+}
+
+/* Maps the time page read-only at USER_TIME_PAGE. The region is shared, so fork keeps the mapping
+ * and faults resolve to the kernel's own frame. */
+int clock_map_time_page(vm_space_t* space)
+{
+    vaddr_t virt = USER_TIME_PAGE;
+    return vm_map(space, &virt, PAGE_SIZE, VM_PROT_READ | VM_PROT_USER, VM_REG_F_SHARED,
+                  time_page_object, 0, VM_MAP_F_FIXED);
+}
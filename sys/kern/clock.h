@@ -0,0 +1,21 @@
+#ifndef KERN_CLOCK_H
+#define KERN_CLOCK_H
+
+#include <sys/time.h>
+
+#include <vm/types.h>
+
+#include <inttypes.h>
+
+/*
+ * CLOCK_MONOTONIC runs off the TSC, calibrated against the PIT at boot. The scaling parameters live
+ * in a page shared read-only with every process, which can then read the clock without a syscall.
+ * Without a TSC the clock falls back to the timer wheel's microseconds.
+ */
+
+void     clock_init(void);
+uint64_t clock_now_ns(void);
+int      clock_gettime(clockid_t clock, struct timespec* tp);
+int      clock_map_time_page(vm_space_t* space);
+
+#endif // KERN_CLOCK_H
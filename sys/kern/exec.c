@@ -1,6 +1,8 @@
 #include "exec.h"
+#include "clock.h"
 #include "elf.h"
 #include "errno.h"
+#include "ioring.h"
 #include "panic.h"
 #include "process.h"
 #include "terminal.h"
@@ -54,28 +56,53 @@ int execve(const char* path, char* const argv[], char* const envp[])
     arg_copy(envp_copy, envp);
 
     if (strcmp(extension, ".elf") == 0) {
+        ioring_teardown(get_proc_from_thread(thread));
+
         if (load_elf(path, thread)) {
             vfs_close(file);
             return -ENOEXEC;
         }
 
         vfs_close(file);
-        setup_exec_stack(thread, argv_copy, envp_copy);
+
+        // The old image is gone by now, so there is nothing left to return an error to
+        int res = setup_exec_stack(thread, argv_copy, envp_copy);
+        if (res) {
+            printf("execve: Failed to set up the stack for %s (%d)\n", path, res);
+            thread_exit((registers_t*)thread->trapframe);
+        }
         return 0;
     }
     vfs_close(file);
     return -ENOEXEC;
 }
 
-void setup_exec_stack(thread_t* thread, char* const argv[], char* const envp[])
+// Maps the main user stack. Only one page is committed up front; the rest of the span allowed by
+// RLIMIT_STACK is reserved and filled in by vm_fault as the stack grows.
+int exec_map_stack(proc_t* proc)
+{
+    rlim_t limit = proc->rlimits[RLIMIT_STACK].rlim_cur;
+    if (limit > USER_STACK_MAX)
+        limit = USER_STACK_MAX;
+    if (limit < PAGE_SIZE)
+        limit = PAGE_SIZE;
+
+    return vm_map_stack(proc->vmspace, USER_STACK_TOP, PAGE_SIZE, limit,
+                        VM_PROT_READ | VM_PROT_USER | VM_PROT_WRITE);
+}
+
+int setup_exec_stack(thread_t* thread, char* const argv[], char* const envp[])
 {
     char*     argv_copy[MAX_ENV_VARS + 1];
     char*     envp_copy[MAX_ENV_VARS + 1];
-    uintptr_t stack_top    = 0xC0000000;
-    uintptr_t stack_bottom = stack_top - PAGE_SIZE;
+    uintptr_t stack_top = USER_STACK_TOP;
 
-    vm_map_anon(get_proc_from_thread(thread)->vmspace, &stack_bottom, PAGE_SIZE,
-                VM_PROT_READ | VM_PROT_USER | VM_PROT_WRITE, VM_REG_F_PRIVATE, VM_MAP_F_FIXED);
+    int res = exec_map_stack(get_proc_from_thread(thread));
+    if (res)
+        return res;
+    res = clock_map_time_page(get_proc_from_thread(thread)->vmspace);
+    if (res)
+        return res;
 
     // ps_strings at very top
     stack_top -= sizeof(ps_strings_t);
@@ -126,4 +153,5 @@ void setup_exec_stack(thread_t* thread, char* const argv[], char* const envp[])
     ps_strings->ps_envstr   = (char**)envp_array;
 
     thread->trapframe->user_esp = stack_top;
+    return 0;
 }
@@ -1,7 +1,8 @@
 #ifndef EXEC_H
 #define EXEC_H
 
-typedef struct thread thread_t;
+typedef struct thread  thread_t;
+typedef struct process proc_t;
 
 typedef struct ps_strings {
     char**       ps_argvstr;
@@ -11,6 +12,7 @@ typedef struct ps_strings {
 } ps_strings_t;
 
 int  execve(const char* path, char* const argv[], char* const envp[]);
-void setup_exec_stack(thread_t* thread, char* const argv[], char* const envp[]);
+int  exec_map_stack(proc_t* proc);
+int  setup_exec_stack(thread_t* thread, char* const argv[], char* const envp[]);
 
 #endif
@@ -0,0 +1,200 @@
+#include "futex.h"
+#include "errno.h"
+#include "process.h"
+#include "spinlock.h"
+
+#include <sys/pcpu.h>
+
+#include <vm/layout.h>
+#include <vm/vm_region.h>
+#include <vm/vm_space.h>
+
+#include <list.h>
+
+#define FUTEX_HASH_BITS 6
+#define FUTEX_BUCKETS   (1 << FUTEX_HASH_BITS)
+
+// A private futex belongs to one address space, which fork and copy-on-write may later back with a
+// different object, so it is keyed by space and address. Only a shared mapping is keyed by what
+// backs it, as every process mapping it sees the same object.
+typedef struct futex_key {
+    void*  base;   // The vm_space for private mappings, the backing vm_object for shared ones
+    size_t offset; // The user address, or the offset into the object
+} futex_key_t;
+
+typedef struct futex_bucket {
+    spinlock_t lock; // Only ever held with interrupts disabled
+    list_t     waiters;
+} futex_bucket_t;
+
+// A sleeping thread, queued on its key's bucket. Wakers dequeue it before waking it, and a requeue
+// may move it to another bucket, so both fields only change under the bucket lock.
+typedef struct futex_waiter {
+    list_node_t     node;
+    futex_key_t     key;
+    futex_bucket_t* bucket;
+    thread_t*       thread;
+} futex_waiter_t;
+
+static futex_bucket_t futex_buckets[FUTEX_BUCKETS];
+
+// Finds the key for uaddr. The base is only compared against, never dereferenced, so it needs no
+// reference: if it dies and its memory is reused, the worst case is a spurious wakeup.
+static int futex_get_key(uint32_t* uaddr, futex_key_t* key)
+{
+    uintptr_t addr = (uintptr_t)uaddr;
+    if ((addr & 3) || addr >= USER_SPACE_START + USER_SPACE_SIZE)
+        return -EINVAL;
+
+    vm_space_t*  space  = get_proc_from_thread(PCPU_GET(current_thread))->vmspace;
+    vm_region_t* region = vm_region_lookup(space, addr, rwlock_read_lock);
+    if (!region)
+        return -EFAULT;
+
+    if (region->flags & VM_REG_F_SHARED) {
+        key->base   = region->object;
+        key->offset = addr - region->base + region->offset;
+    }
+    else {
+        key->base   = space;
+        key->offset = addr;
+    }
+    rwlock_read_unlock(&region->lock);
+    return 0;
+}
+
+static futex_bucket_t* futex_hash(futex_key_t* key)
+{
+    uint32_t h = ((uintptr_t)key->base >> 4) ^ (key->offset >> 2);
+    return &futex_buckets[(h * 0x9E3779B1u) >> (32 - FUTEX_HASH_BITS)];
+}
+
+static bool futex_key_equal(futex_key_t* a, futex_key_t* b)
+{
+    return a->base == b->base && a->offset == b->offset;
+}
+
+// Locks the bucket w is queued on, following it across a concurrent requeue
+static futex_bucket_t* futex_lock_waiter(futex_waiter_t* w, uint32_t* eflags)
+{
+    for (;;) {
+        futex_bucket_t* bucket = w->bucket;
+        *eflags                = spin_lock_irqsave(&bucket->lock);
+        if (bucket == w->bucket)
+            return bucket;
+        spin_unlock_irqrestore(&bucket->lock, *eflags);
+    }
+}
+
+// Wakes up to nr waiters on key, with the bucket lock held
+static int futex_wake_locked(futex_bucket_t* bucket, futex_key_t* key, int nr)
+{
+    int          woken = 0;
+    list_node_t* node  = bucket->waiters.head;
+    while (node && woken < nr) {
+        futex_waiter_t* w = container_of(node, futex_waiter_t, node);
+        node              = node->next;
+        if (!futex_key_equal(&w->key, key))
+            continue;
+
+        list_remove(&w->node);
+        sched_wakeup(w->thread);
+        woken++;
+    }
+    return woken;
+}
+
+// The waiter is queued before *uaddr is read, so a waker that changes the value afterwards is sure
+// to find it. The read happens while still runnable, so it may fault like any other user access.
+int futex_wait(uint32_t* uaddr, uint32_t val)
+{
+    futex_waiter_t w   = {.thread = PCPU_GET(current_thread)};
+    int            res = futex_get_key(uaddr, &w.key);
+    if (res)
+        return res;
+
+    w.bucket        = futex_hash(&w.key);
+    uint32_t eflags = spin_lock_irqsave(&w.bucket->lock);
+    list_push_tail(&w.bucket->waiters, &w.node);
+    spin_unlock_irqrestore(&w.bucket->lock, eflags);
+
+    if (*(volatile uint32_t*)uaddr != val) {
+        futex_bucket_t* bucket = futex_lock_waiter(&w, &eflags);
+        if (w.node.list)
+            list_remove(&w.node);
+        spin_unlock_irqrestore(&bucket->lock, eflags);
+        return -EAGAIN;
+    }
+
+    // Marking ourselves blocked under the bucket lock orders it against the waker's dequeue, so
+    // either we see the dequeue or sched_wakeup sees us blocked
+    for (;;) {
+        futex_bucket_t* bucket = futex_lock_waiter(&w, &eflags);
+        if (!w.node.list) {
+            spin_unlock_irqrestore(&bucket->lock, eflags);
+            return 0;
+        }
+        w.thread->state = TASK_BLOCKED;
+        spin_unlock_irqrestore(&bucket->lock, eflags);
+        yield();
+    }
+}
+
+int futex_wake(uint32_t* uaddr, int nr_wake)
+{
+    futex_key_t key;
+    int         res = futex_get_key(uaddr, &key);
+    if (res)
+        return res;
+
+    futex_bucket_t* bucket = futex_hash(&key);
+    uint32_t        eflags = spin_lock_irqsave(&bucket->lock);
+    int             woken  = futex_wake_locked(bucket, &key, nr_wake);
+    spin_unlock_irqrestore(&bucket->lock, eflags);
+    return woken;
+}
+
+// Wakes some waiters and moves the rest onto uaddr2 without waking them, e.g. from a condition
+// variable to its mutex. Returns how many were woken or moved.
+int futex_requeue(uint32_t* uaddr, int nr_wake, uint32_t* uaddr2, int nr_requeue)
+{
+    futex_key_t key, key2;
+    int         res = futex_get_key(uaddr, &key);
+    if (!res)
+        res = futex_get_key(uaddr2, &key2);
+    if (res)
+        return res;
+    if (futex_key_equal(&key, &key2))
+        nr_requeue = 0; // Moving waiters onto their own key would change nothing
+
+    // Two bucket locks are always taken in address order
+    futex_bucket_t* bucket  = futex_hash(&key);
+    futex_bucket_t* bucket2 = futex_hash(&key2);
+    futex_bucket_t* first   = bucket < bucket2 ? bucket : bucket2;
+    futex_bucket_t* second  = bucket < bucket2 ? bucket2 : bucket;
+
+    uint32_t eflags = spin_lock_irqsave(&first->lock);
+    if (second != first)
+        spin_lock(&second->lock);
+
+    int          done  = futex_wake_locked(bucket, &key, nr_wake);
+    int          moved = 0;
+    list_node_t* node  = bucket->waiters.head;
+    while (node && moved < nr_requeue) {
+        futex_waiter_t* w = container_of(node, futex_waiter_t, node);
+        node              = node->next;
+        if (!futex_key_equal(&w->key, &key))
+            continue;
+
+        list_remove(&w->node);
+        w->key    = key2;
+        w->bucket = bucket2;
+        list_push_tail(&bucket2->waiters, &w->node);
+        moved++;
+    }
+
+    if (second != first)
+        spin_unlock(&second->lock);
+    spin_unlock_irqrestore(&first->lock, eflags);
+    return done + moved;
+}
@@ -0,0 +1,21 @@
+#ifndef KERN_FUTEX_H
+#define KERN_FUTEX_H
+
+#include <inttypes.h>
+
+/*
+ * Fast userspace mutexes. User locks live in plain memory and are taken with atomics; the kernel is
+ * only entered to sleep when a lock is contended, or to wake its sleepers. A futex in a shared
+ * mapping is keyed by the vm_object and offset behind its address, so processes sharing the mapping
+ * share its waiters. Any other futex is keyed by its address space and address.
+ */
+
+#define FUTEX_WAIT    0 // Sleep if *uaddr still equals val
+#define FUTEX_WAKE    1 // Wake up to val waiters
+#define FUTEX_REQUEUE 3 // Wake up to val waiters, move up to val2 others to uaddr2
+
+int futex_wait(uint32_t* uaddr, uint32_t val);
+int futex_wake(uint32_t* uaddr, int nr_wake);
+int futex_requeue(uint32_t* uaddr, int nr_wake, uint32_t* uaddr2, int nr_requeue);
+
+#endif // KERN_FUTEX_H
@@ -0,0 +1,275 @@
+#include "ioring.h"
+#include "errno.h"
+#include "fd.h"
+#include "process.h"
+#include "spinlock.h"
+#include "syscalls.h"
+#include "timer.h"
+#include "wait_queue.h"
+
+#include <fs/vfs.h>
+
+#include <sys/pcpu.h>
+
+#include <vm/kmalloc.h>
+#include <vm/vm_map.h>
+
+#include <string.h>
+
+#define IORING_SQPOLL_IDLE_US 2000 // How long an SQPOLL worker polls before it sleeps
+
+// Kernel side of a ring. The shared header is only written through its user address, which is
+// valid as long as the worker runs in the owning process. Indices and masks the kernel relies on
+// are kept here as well, so a process scribbling over the header can only hurt itself.
+typedef struct ioring {
+    ioring_hdr_t* hdr;
+    size_t        size; // Of the mapping starting at hdr
+    ioring_sqe_t* sqes;
+    ioring_cqe_t* cqes;
+    uint32_t      sq_entries;
+    uint32_t      cq_entries;
+    uint32_t      sq_head; // Next submission to consume
+    uint32_t      cq_tail; // Next completion slot to fill
+    uint32_t      flags;   // IORING_SETUP_*
+
+    thread_t*     worker;
+    volatile bool dying;
+    wait_queue_t  sq_wq; // Worker sleeps here for submissions or completion space
+    wait_queue_t  cq_wq; // ioring_enter sleeps here for completions
+} ioring_t;
+
+static spinlock_t ioring_lock = SPINLOCK_INITIALIZER; // Serialises setup against itself
+
+// Woken whenever a worker exits, for ioring_teardown waiting on its process's ring
+static wait_queue_t ioring_exit_wq = WAIT_QUEUE_INIT;
+
+static bool ioring_sq_ready(ioring_t* ring)
+{
+    return ring->hdr->sq_tail != ring->sq_head &&
+           ring->cq_tail - ring->hdr->cq_head < ring->cq_entries;
+}
+
+static uint32_t ioring_cq_ready(ioring_t* ring)
+{
+    return ring->cq_tail - ring->hdr->cq_head;
+}
+
+// Files here never block, so a file is ready for whatever its open mode allows
+static int ioring_poll(file_t* file, uint32_t events)
+{
+    uint32_t ready = 0;
+    if (file->f_mode & FMODE_READ)
+        ready |= IORING_POLLIN;
+    if (file->f_mode & FMODE_WRITE)
+        ready |= IORING_POLLOUT;
+    return ready & events;
+}
+
+static int ioring_execute(proc_t* p, ioring_sqe_t* sqe)
+{
+    if (sqe->flags & ~IORING_SQE_CUR_POS)
+        return -EINVAL;
+
+    switch (sqe->opcode) {
+    case IORING_OP_NOP:
+        return 0;
+    case IORING_OP_OPEN:
+        return syscall_open((const char*)sqe->addr, sqe->op_flags, sqe->len, 0, 0, 0);
+    case IORING_OP_CLOSE:
+        return syscall_close(sqe->fd, 0, 0, 0, 0);
+    }
+
+    file_t* file = fd_get_file(p, sqe->fd);
+    if (!file)
+        return -EBADF;
+
+    // Only an explicit request touches the position the process's own read and write calls share
+    switch (sqe->opcode) {
+    case IORING_OP_READ:
+        if (sqe->flags & IORING_SQE_CUR_POS)
+            return vfs_read(file, (void*)sqe->addr, sqe->len, 0);
+        return vfs_pread(file, (void*)sqe->addr, sqe->len, sqe->off);
+    case IORING_OP_WRITE:
+        if (sqe->flags & IORING_SQE_CUR_POS)
+            return vfs_write(file, (const void*)sqe->addr, sqe->len, 0);
+        return vfs_pwrite(file, (const void*)sqe->addr, sqe->len, sqe->off);
+    case IORING_OP_FSYNC:
+        return vfs_fsync(file);
+    case IORING_OP_POLL:
+        return ioring_poll(file, sqe->op_flags);
+    default:
+        return -EINVAL;
+    }
+}
+
+// Runs every submission that has room for its completion. Returns how many were completed.
+static uint32_t ioring_run(proc_t* p, ioring_t* ring)
+{
+    uint32_t done = 0;
+    while (ioring_sq_ready(ring)) {
+        // Copied first, so the process cannot change the entry while it runs
+        ioring_sqe_t sqe = ring->sqes[ring->sq_head & (ring->sq_entries - 1)];
+        ring->sq_head++;
+        ring->hdr->sq_head = ring->sq_head;
+
+        ioring_cqe_t* cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+        cqe->user_data    = sqe.user_data;
+        cqe->res          = ioring_execute(p, &sqe);
+        cqe->flags        = 0;
+
+        // The entry must be complete before the process can see the new tail
+        asm volatile("" ::: "memory");
+        ring->hdr->cq_tail = ++ring->cq_tail;
+        done++;
+    }
+    return done;
+}
+
+static void ioring_worker(void)
+{
+    proc_t*   p    = get_proc_from_thread(PCPU_GET(current_thread));
+    ioring_t* ring = p->ioring;
+    uint64_t  busy = timer_now();
+
+    for (;;) {
+        if (ioring_run(p, ring)) {
+            wake_all(&ring->cq_wq);
+            busy = timer_now();
+            continue;
+        }
+        if (ring->dying)
+            break;
+
+        if (!(ring->flags & IORING_SETUP_SQPOLL)) {
+            wait_event(ring->sq_wq, ring->dying || ioring_sq_ready(ring));
+            continue;
+        }
+
+        if (timer_now() - busy < IORING_SQPOLL_IDLE_US) {
+            yield();
+            continue;
+        }
+
+        // The flag must be visible before sq_tail is checked again, or a submission made in
+        // between would see no flag and leave us asleep
+        ring->hdr->sq_flags |= IORING_SQ_NEED_WAKEUP;
+        __sync_synchronize();
+        wait_event(ring->sq_wq, ring->dying || ioring_sq_ready(ring));
+        ring->hdr->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+        busy = timer_now();
+    }
+
+    p->ioring = NULL;
+    kfree(ring);
+    wake_all(&ioring_exit_wq);
+}
+
+int ioring_setup(uint32_t entries, uint32_t flags, uintptr_t* addr_out)
+{
+    if (!entries || entries > IORING_MAX_ENTRIES || (flags & ~IORING_SETUP_SQPOLL))
+        return -EINVAL;
+
+    uint32_t sq_entries = 1;
+    while (sq_entries < entries)
+        sq_entries <<= 1;
+    uint32_t cq_entries = sq_entries * 2; // Room for a full batch while the last one is unreaped
+
+    ioring_t* ring = kmalloc(sizeof(ioring_t));
+    if (!ring)
+        return -ENOMEM;
+    memset(ring, 0, sizeof(*ring));
+    ring->sq_entries = sq_entries;
+    ring->cq_entries = cq_entries;
+    ring->flags      = flags;
+    wait_queue_init(&ring->sq_wq);
+    wait_queue_init(&ring->cq_wq);
+
+    proc_t* p = get_proc_from_thread(PCPU_GET(current_thread));
+    WITH_SPINLOCK(ioring_lock)
+    {
+        if (!p->ioring)
+            p->ioring = ring;
+    }
+    if (p->ioring != ring) {
+        kfree(ring);
+        return -EBUSY;
+    }
+
+    // Wired and populated up front, so the worker never faults on the ring with interrupts off
+    uint32_t sqes_off = sizeof(ioring_hdr_t);
+    uint32_t cqes_off = sqes_off + sq_entries * sizeof(ioring_sqe_t);
+    size_t   size     = cqes_off + cq_entries * sizeof(ioring_cqe_t);
+    vaddr_t  addr     = 0;
+    int      res = vm_map_anon(p->vmspace, &addr, size, VM_PROT_READ | VM_PROT_WRITE | VM_PROT_USER,
+                               VM_REG_F_WIRED | VM_REG_F_EARLYENTER, VM_MAP_F_NONE);
+    if (res < 0) {
+        p->ioring = NULL;
+        kfree(ring);
+        return res;
+    }
+
+    ring->hdr           = (ioring_hdr_t*)addr;
+    ring->size          = size;
+    ring->sqes          = (ioring_sqe_t*)(addr + sqes_off);
+    ring->cqes          = (ioring_cqe_t*)(addr + cqes_off);
+    ring->hdr->sq_mask  = sq_entries - 1;
+    ring->hdr->cq_mask  = cq_entries - 1;
+    ring->hdr->sqes_off = sqes_off;
+    ring->hdr->cqes_off = cqes_off;
+
+    ring->worker = create_kernel_thread(ioring_worker, p, SCHED_PRIO_DEFAULT, NULL);
+    if (!ring->worker) {
+        vm_unmap(p->vmspace, addr, size);
+        p->ioring = NULL;
+        kfree(ring);
+        return -ENOMEM;
+    }
+
+    *addr_out = addr;
+    return 0;
+}
+
+// to_submit is only a hint: the worker takes whatever is on the ring. Returns how many completions
+// are waiting to be reaped.
+int ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    ioring_t* ring = get_proc_from_thread(PCPU_GET(current_thread))->ioring;
+    if (!ring)
+        return -EBADF;
+    if (min_complete > ring->cq_entries)
+        return -EINVAL;
+
+    // Also wakes a worker waiting for completion space, which reaping may have made
+    wake_one(&ring->sq_wq);
+
+    if (flags & IORING_ENTER_GETEVENTS)
+        wait_event(ring->cq_wq, ioring_cq_ready(ring) >= min_complete);
+    return ioring_cq_ready(ring);
+}
+
+void ioring_release(proc_t* p)
+{
+    ioring_t* ring = p->ioring;
+    if (!ring || thread_from_proc_node(p->threads.head) != ring->worker)
+        return;
+
+    ring->dying = true;
+    wake_one(&ring->sq_wq);
+}
+
+void ioring_teardown(proc_t* p)
+{
+    ioring_t* ring = p->ioring;
+    if (!ring)
+        return;
+
+    // The worker frees the ring as it exits, so take what the unmap needs first
+    vaddr_t addr = (vaddr_t)ring->hdr;
+    size_t  size = ring->size;
+
+    ring->dying = true;
+    wake_one(&ring->sq_wq);
+    wait_event(ioring_exit_wq, !p->ioring);
+
+    vm_unmap(p->vmspace, addr, size);
+}
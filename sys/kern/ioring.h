@@ -0,0 +1,93 @@
+#ifndef KERN_IORING_H
+#define KERN_IORING_H
+
+#include <inttypes.h>
+
+/*
+ * Submission and completion rings shared with user space, for batching I/O without a syscall per
+ * operation. The process fills submission entries and advances sq_tail, then calls ioring_enter
+ * once for the whole batch. A kernel worker in the process consumes them, runs each against the
+ * VFS, and posts a completion carrying the entry's user_data.
+ *
+ * Each index is only written by one side: the process owns sq_tail and cq_head, the kernel owns
+ * sq_head and cq_tail. Indices run freely and are masked into the rings. With IORING_SETUP_SQPOLL
+ * the worker polls sq_tail for a while after going idle, so a busy process needs no syscall at all.
+ * It then sets IORING_SQ_NEED_WAKEUP and sleeps until the next ioring_enter.
+ *
+ * The layout below is ABI, mirrored in user/include/ioring.h.
+ */
+
+#define IORING_MAX_ENTRIES 256
+
+// ioring_setup flags
+#define IORING_SETUP_SQPOLL 0x1 // Kernel polls the submission ring
+
+// ioring_enter flags
+#define IORING_ENTER_GETEVENTS 0x1 // Wait for min_complete completions
+
+// sq_flags
+#define IORING_SQ_NEED_WAKEUP 0x1 // SQPOLL worker is asleep, ioring_enter must wake it
+
+// sqe flags
+#define IORING_SQE_CUR_POS 0x1 // READ/WRITE at the file position and advance it, ignoring off
+
+enum ioring_op {
+    IORING_OP_NOP,
+    IORING_OP_READ,  // Read len bytes at off into addr, like pread
+    IORING_OP_WRITE, // Write len bytes from addr at off, like pwrite
+    IORING_OP_OPEN,  // Open the path at addr with op_flags, mode len; res is the fd
+    IORING_OP_CLOSE,
+    IORING_OP_FSYNC,
+    IORING_OP_POLL, // Poll for the events in op_flags; res is the ready subset
+};
+
+#define IORING_POLLIN  0x1
+#define IORING_POLLOUT 0x4
+
+typedef struct ioring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t _reserved;
+    int32_t  fd;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t off;
+    uint32_t op_flags;
+    uint64_t user_data; // Copied to the completion untouched
+} ioring_sqe_t;
+
+typedef struct ioring_cqe {
+    uint64_t user_data;
+    int32_t  res; // Result of the operation, or -errno
+    uint32_t flags;
+} ioring_cqe_t;
+
+// Sits at the start of the mapping. The entry arrays follow at sqes_off and cqes_off.
+typedef struct ioring_hdr {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    uint32_t          sq_mask;
+    volatile uint32_t sq_flags;
+
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t          cq_mask;
+
+    uint32_t sqes_off;
+    uint32_t cqes_off;
+} ioring_hdr_t;
+
+typedef struct process proc_t;
+
+/* Maps a ring with the given number of submission entries into the current process and starts its
+ * worker. Returns the user address of the ring header. */
+int ioring_setup(uint32_t entries, uint32_t flags, uintptr_t* addr_out);
+/* Kicks the worker, then waits for min_complete completions if IORING_ENTER_GETEVENTS is set */
+int ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+/* Called when only the worker is left in p. Stops it; the worker frees the ring on its way out. */
+void ioring_release(proc_t* p);
+/* Called by execve before the old image goes. Waits for the worker to exit, then unmaps the ring,
+ * so the worker never touches the new image and the new image may set up a ring of its own. */
+void ioring_teardown(proc_t* p);
+
+#endif // KERN_IORING_H
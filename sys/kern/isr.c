@@ -4,12 +4,14 @@
 #include "process.h"
 #include "syscalls.h"
 #include "terminal.h"
+#include "timer.h"
 
 #include <dev/input/keyboard.h>
 #include <dev/port/port_io.h>
 
 #include <sys/pcpu.h>
 
+#include <vm/layout.h>
 #include <vm/types.h>
 #include <vm/vm_fault.h>
 #include <vm/vm_map.h>
@@ -125,6 +127,22 @@ void isr_syscall(registers_t* regs)
     regs->eax               = ret;
 }
 
+// Called from sysenter_entry, with a trapframe laid out as for int $0x80. SYSENTER does not save
+// the user's eip, so the user stub leaves its return address on top of its stack, at ebp.
+void isr_sysenter(registers_t* regs)
+{
+    thread_t*    self   = PCPU_GET(current_thread);
+    trapframe_t* old_tf = self->trapframe;
+    self->trapframe     = (trapframe_t*)regs;
+
+    if (regs->userEsp > USER_SPACE_START + USER_SPACE_SIZE - sizeof(uint32_t))
+        thread_exit(regs); // Nowhere to return to
+    regs->eip = *(uint32_t*)regs->userEsp;
+
+    isr_syscall(regs);
+    self->trapframe = old_tf;
+}
+
 // Exception handlers
 void isr_divide_by_zero(registers_t* regs)
 {
@@ -239,19 +257,26 @@ void isr_simd_floating_point(registers_t* regs)
     asm volatile("hlt");
 }
 
+// The LAPIC one-shot timer, armed by the timer wheel
 void isr_timer_handler(registers_t* regs)
 {
-    // Send an EOI to the PIC
-    outb(0x20, 0x20); // Send EOI to PIC1
-    outb(0xA0, 0x20); // Send EOI to PIC2
+    // Acknowledge first, the tick may switch threads
+    lapic_write(LAPIC_EOI, 0);
+
+    if (timer_interrupt())
+        sched_tick(regs);
+}
 
-    // printf("Thread %s (TID %d) - Timer tick\n",
-    // get_proc_from_thread(PCPU_GET(current_thread))->name, PCPU_GET(current_thread)->tid);
-    // Schedule next task
+// yield() lands here (int 0x20, IRQ0 is left masked now that the PIT no longer ticks)
+void isr_yield_handler(registers_t* regs)
+{
     schedule_from_irq(regs);
+}
 
-    // printf("Thread %s (TID %d) - Resumed after timer tick\n",
-    // get_proc_from_thread(PCPU_GET(current_thread))->name, PCPU_GET(current_thread)->tid);
-    // Send EOI to LAPIC
+// Another CPU queued work here, typically while this one sat in hlt
+void isr_resched_handler(registers_t* regs)
+{
+    // Acknowledge first, the switch below may not return here for a while
     lapic_write(LAPIC_EOI, 0);
+    schedule_from_irq(regs);
 }
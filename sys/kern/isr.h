@@ -14,6 +14,7 @@ void isr_default_handler(void);
 void isr_keyboard_handler(registers_t* regs);
 void isr_page_fault_handler(registers_t* regs);
 void isr_syscall(registers_t* regs);
+void isr_sysenter(registers_t* regs);
 
 // Exception handlers
 void isr_divide_by_zero(registers_t* regs);
@@ -35,5 +36,7 @@ void isr_alignment_check(registers_t* regs);
 void isr_machine_check(registers_t* regs);
 void isr_simd_floating_point(registers_t* regs);
 void isr_timer_handler(registers_t* regs);
+void isr_yield_handler(registers_t* regs);
+void isr_resched_handler(registers_t* regs);
 
 #endif // ISR_H
\ No newline at end of file
@@ -46,6 +46,33 @@ void apic_timer_init(uint32_t ticks)
     lapic_write(LAPIC_TIMER_INITCNT, ticks);
 }
 
+/* Measure the timer's rate (at divide-by-16) against the PIT, in ticks per millisecond */
+uint32_t lapic_timer_calibrate(void)
+{
+    lapic_write(LAPIC_TIMER_DIV, 0x3);
+    lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR | LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITCNT, 0xFFFFFFFF);
+
+    delay_ms(10);
+
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURCNT);
+    lapic_write(LAPIC_TIMER_INITCNT, 0);
+    return elapsed / 10;
+}
+
+/* Fire TIMER_VECTOR once, after ticks timer ticks; 0 stops the timer */
+void lapic_timer_oneshot(uint32_t ticks)
+{
+    lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR); // Unmasked, one-shot mode
+    lapic_write(LAPIC_TIMER_INITCNT, ticks);
+}
+
+/* Ticks left before the one-shot fires, 0 once it has */
+uint32_t lapic_timer_current(void)
+{
+    return lapic_read(LAPIC_TIMER_CURCNT);
+}
+
 void apic_cpu_init()
 {
     // Enable APIC by setting the spurious interrupt vector register (SVR)
@@ -73,7 +100,7 @@ void lapic_init()
 {
     // Map LAPIC base
     lapic_address =
-        vm_map_device(LAPIC_BASE, PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_NONE);
+        vm_map_device(LAPIC_BASE, PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_NOCACHE);
     if (!lapic_address)
         PANIC("Failed to map LAPIC");
 
@@ -116,3 +143,9 @@ void send_startup_ipi(uint32_t apic_id, uint32_t trampoline_paddr)
     // send a second SIPI to be safe on some hardware
     lapic_send_ipi(apic_id, icr);
 }
+
+/* Kick a CPU out of hlt (or preempt it) so it reschedules */
+void send_resched_ipi(uint32_t apic_id)
+{
+    lapic_send_ipi(apic_id, ICR_FIXED | ICR_EDGE_TRIGGER | ICR_PHYSICAL | RESCHED_VECTOR);
+}
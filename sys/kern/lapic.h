@@ -18,6 +18,10 @@
 #define LAPIC_LVT_TIMER     0x320
 #define TIMER_VECTOR        0x40
 #define LAPIC_TIMER_INITCNT 0x380
+#define LAPIC_TIMER_CURCNT  0x390
+#define LAPIC_LVT_MASKED    (1 << 16)
+
+#define RESCHED_VECTOR 0xF0 // IPI asking a CPU to look at its runqueues again
 
 #define ICR_DELIVERY_INIT 0x00000500U
 #define ICR_DELIVERY_SIPI 0x00000600U
@@ -29,9 +33,14 @@
 void lapic_write(uint32_t reg, uint32_t value);
 void lapic_init(void);
 void apic_timer_init(uint32_t ticks);
+
+uint32_t lapic_timer_calibrate(void);
+void     lapic_timer_oneshot(uint32_t ticks);
+uint32_t lapic_timer_current(void);
 void apic_cpu_init(void);
 
 void send_init_ipi(uint32_t apic_id);
 void send_startup_ipi(uint32_t apic_id, uint32_t trampoline_paddr);
+void send_resched_ipi(uint32_t apic_id);
 
 #endif // LAPIC_H
\ No newline at end of file
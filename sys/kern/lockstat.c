@@ -0,0 +1,248 @@
+#include "lockstat.h"
+
+#ifdef LOCKSTAT
+
+#include "errno.h"
+#include "terminal.h"
+
+#include <fs/vfs.h>
+#include <machine/cpufunc.h>
+#include <sys/device.h>
+#include <sys/driver.h>
+#include <vm/kmalloc.h>
+
+#include <string.h>
+
+DECLARE_DRIVER(lockstat, root);
+
+extern lock_class_t* const __lockstat_start[];
+extern lock_class_t* const __lockstat_end[];
+
+/* ---------------- Recording ---------------- */
+
+// Keeps the call sites that waited longest. A new site replaces the one with the least wait time.
+static void lockstat_record_site(lock_class_t* cls, void* pc, uint64_t cycles)
+{
+    lockstat_site_t* victim = &cls->sites[0];
+    for (int i = 0; i < LOCKSTAT_SITES; i++) {
+        lockstat_site_t* site = &cls->sites[i];
+        if (site->pc == pc) {
+            site->contended++;
+            site->wait_cycles += cycles;
+            return;
+        }
+        if (site->wait_cycles < victim->wait_cycles)
+            victim = site;
+    }
+
+    if (victim->pc && victim->wait_cycles >= cycles)
+        return;
+    victim->pc          = pc;
+    victim->contended   = 1;
+    victim->wait_cycles = cycles;
+}
+
+// cycles is 0 for an uncontended acquisition. The class lock is taken with interrupts off, as the
+// same class may be acquired from an interrupt handler.
+static void lockstat_record(lock_class_t* cls, void* pc, bool contended, uint64_t cycles)
+{
+    uint32_t eflags = spin_lock_irqsave(&cls->lock);
+
+    cls->acquisitions++;
+    if (contended) {
+        cls->contended++;
+        cls->wait_cycles += cycles;
+        if (cycles > cls->max_wait_cycles)
+            cls->max_wait_cycles = cycles;
+        lockstat_record_site(cls, pc, cycles);
+    }
+
+    spin_unlock_irqrestore(&cls->lock, eflags);
+}
+
+static void lockstat_spin_lock_at(lock_class_t* cls, spinlock_t* l, void* pc)
+{
+    if (spin_trylock(l) == 0) {
+        lockstat_record(cls, pc, false, 0);
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    spin_lock(l);
+    lockstat_record(cls, pc, true, rdtsc() - start);
+}
+
+static void lockstat_mcs_lock_at(lock_class_t* cls, mcs_lock_t* lock, mcs_node_t* node, void* pc)
+{
+    if (mcs_trylock(lock, node) == 0) {
+        lockstat_record(cls, pc, false, 0);
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    mcs_lock(lock, node);
+    lockstat_record(cls, pc, true, rdtsc() - start);
+}
+
+void lockstat_spin_lock(lock_class_t* cls, spinlock_t* l)
+{
+    lockstat_spin_lock_at(cls, l, __builtin_return_address(0));
+}
+
+uint32_t lockstat_spin_lock_irqsave(lock_class_t* cls, spinlock_t* l)
+{
+    uint32_t eflags = intr_disable();
+    lockstat_spin_lock_at(cls, l, __builtin_return_address(0));
+    return eflags;
+}
+
+void lockstat_mcs_lock(lock_class_t* cls, mcs_lock_t* lock, mcs_node_t* node)
+{
+    lockstat_mcs_lock_at(cls, lock, node, __builtin_return_address(0));
+}
+
+// For a mutex the wait includes the time spent asleep
+void lockstat_mutex_lock(lock_class_t* cls, mutex_t* m)
+{
+    void* pc = __builtin_return_address(0);
+    if (mutex_trylock(m) == 0) {
+        lockstat_record(cls, pc, false, 0);
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    mutex_lock(m);
+    lockstat_record(cls, pc, true, rdtsc() - start);
+}
+
+mcs_guard_t* _lockstat_mcs_guard_lock(lock_class_t* cls, mcs_guard_t* guard)
+{
+    lockstat_mcs_lock_at(cls, guard->lock, &guard->node, __builtin_return_address(0));
+    return guard;
+}
+
+/* ---------------- /dev/lockstat ---------------- */
+
+#define LOCKSTAT_LINE_MAX 128
+
+static size_t lockstat_format_class(lock_class_t* cls, char* buf, size_t size)
+{
+    lock_class_t snap;
+    uint32_t     eflags = spin_lock_irqsave(&cls->lock);
+    snap                = *cls;
+    spin_unlock_irqrestore(&cls->lock, eflags);
+
+    size_t len = snprintf(buf, size, "%s: acquired %lu contended %lu wait %lu max %lu\n", snap.name,
+                          snap.acquisitions, snap.contended, snap.wait_cycles,
+                          snap.max_wait_cycles);
+
+    for (int i = 0; i < LOCKSTAT_SITES && len < size; i++) {
+        if (!snap.sites[i].pc)
+            continue;
+        len += snprintf(buf + len, size - len, "    %p: contended %lu wait %lu\n",
+                        snap.sites[i].pc, snap.sites[i].contended, snap.sites[i].wait_cycles);
+    }
+
+    return len < size ? len : size;
+}
+
+int lockstat_read(device_t* dev, uint64_t offset, uint32_t size, uint8_t* buffer)
+{
+    size_t classes = __lockstat_end - __lockstat_start;
+    size_t cap     = classes * LOCKSTAT_LINE_MAX * (LOCKSTAT_SITES + 1);
+    char*  text    = kmalloc(cap);
+    if (!text)
+        return -ENOMEM;
+
+    size_t len = 0;
+    for (lock_class_t* const* it = __lockstat_start; it < __lockstat_end; it++)
+        len += lockstat_format_class(*it, text + len, cap - len);
+
+    uint32_t copied = 0;
+    if (offset < len) {
+        copied = len - (uint32_t)offset;
+        if (copied > size)
+            copied = size;
+        memcpy(buffer, text + (uint32_t)offset, copied);
+    }
+
+    kfree(text);
+    return copied;
+}
+
+// Writing anything to /dev/lockstat resets the counters
+int lockstat_write(device_t* dev, uint64_t offset, uint32_t size, const uint8_t* buffer)
+{
+    for (lock_class_t* const* it = __lockstat_start; it < __lockstat_end; it++) {
+        lock_class_t* cls    = *it;
+        uint32_t      eflags = spin_lock_irqsave(&cls->lock);
+        cls->acquisitions    = 0;
+        cls->contended       = 0;
+        cls->wait_cycles     = 0;
+        cls->max_wait_cycles = 0;
+        memset(cls->sites, 0, sizeof(cls->sites));
+        spin_unlock_irqrestore(&cls->lock, eflags);
+    }
+
+    return size;
+}
+
+int lockstat_open(device_t* dev)
+{
+    return 0;
+}
+
+int lockstat_close(device_t* dev)
+{
+    return 0;
+}
+
+int lockstat_ioctl(device_t* dev, int cmd, void* arg)
+{
+    return -EINVAL;
+}
+
+// Only created by lockstat_init, never bound to an enumerated device
+int lockstat_probe(device_t* dev)
+{
+    return -ENODEV;
+}
+
+int lockstat_attach(device_t* dev)
+{
+    dev->type = DEV_TYPE_CHAR;
+    strcpy(dev->name, "lockstat");
+    return 0;
+}
+
+int lockstat_detach(device_t* dev)
+{
+    return 0;
+}
+
+int lockstat_suspend(device_t* dev)
+{
+    return 0;
+}
+
+int lockstat_resume(device_t* dev)
+{
+    return 0;
+}
+
+int lockstat_shutdown(device_t* dev)
+{
+    return 0;
+}
+
+int lockstat_init(void)
+{
+    device_t* dev;
+    int       res = device_misc_create(&__driver_lockstat, &dev);
+    if (res)
+        return res;
+
+    return vfs_register_device(dev);
+}
+
+#endif // LOCKSTAT
@@ -0,0 +1,85 @@
+#ifndef KERN_LOCKSTAT_H
+#define KERN_LOCKSTAT_H
+
+#include "mutex.h"
+#include "spinlock.h"
+
+#include <inttypes.h>
+
+/*
+ * Lock contention statistics, built with `make LOCKSTAT=1`. Locks are grouped into classes, e.g. all
+ * pmap locks share one, and every acquisition through a _class variant below is counted. Contended
+ * acquisitions are also timed with the TSC, and the call sites that wait the longest are kept per
+ * class. The results are read from /dev/lockstat.
+ *
+ * Without LOCKSTAT the _class variants are the plain lock calls and classes are never defined.
+ */
+
+#define LOCKSTAT_SITES 4 // Top contending call sites kept per class
+
+typedef struct lock_class lock_class_t;
+
+#ifdef LOCKSTAT
+
+typedef struct lockstat_site {
+    void*    pc; // Return address of the lock call
+    uint64_t contended;
+    uint64_t wait_cycles;
+} lockstat_site_t;
+
+struct lock_class {
+    const char* name;
+    spinlock_t  lock; // Guards the counters below
+
+    uint64_t        acquisitions;
+    uint64_t        contended;
+    uint64_t        wait_cycles;
+    uint64_t        max_wait_cycles;
+    lockstat_site_t sites[LOCKSTAT_SITES];
+};
+
+// A pointer to each class goes in its own section, so /dev/lockstat can walk them without
+// registration. The classes themselves may be padded by the compiler and are not kept there.
+#define LOCK_CLASS(var, desc)                                                                      \
+    lock_class_t        var = {.name = desc, .lock = SPINLOCK_INITIALIZER};                        \
+    static lock_class_t* const _lockstat_##var __attribute__((section(".lockstat"), used)) = &var
+
+#define spin_lock_class(l, cls)         lockstat_spin_lock(&(cls), l)
+#define spin_lock_irqsave_class(l, cls) lockstat_spin_lock_irqsave(&(cls), l)
+#define mcs_lock_class(l, n, cls)       lockstat_mcs_lock(&(cls), l, n)
+#define mutex_lock_class(m, cls)        lockstat_mutex_lock(&(cls), m)
+
+#define WITH_MCS_LOCK_CLASS(lock, cls)                                                             \
+    for (mcs_guard_t _mcs_guard __attribute__((cleanup(_mcs_cleanup))) = {&(lock), {NULL, 0}},     \
+                     *_mcs_once = _lockstat_mcs_guard_lock(&(cls), &_mcs_guard);                   \
+         _mcs_once; _mcs_once = NULL)
+
+#define WITH_MUTEX_CLASS(lock, cls)                                                                \
+    for (mutex_t * _mutex_cleanup_var __attribute__((cleanup(_mutex_cleanup))) =                  \
+             (lockstat_mutex_lock(&(cls), &(lock)), &(lock)),                                      \
+             *_mutex_once = _mutex_cleanup_var;                                                    \
+         _mutex_once; _mutex_once = NULL)
+
+void         lockstat_spin_lock(lock_class_t* cls, spinlock_t* l);
+uint32_t     lockstat_spin_lock_irqsave(lock_class_t* cls, spinlock_t* l);
+void         lockstat_mcs_lock(lock_class_t* cls, mcs_lock_t* lock, mcs_node_t* node);
+void         lockstat_mutex_lock(lock_class_t* cls, mutex_t* m);
+mcs_guard_t* _lockstat_mcs_guard_lock(lock_class_t* cls, mcs_guard_t* guard);
+
+int lockstat_init(void);
+
+#else
+
+#define LOCK_CLASS(var, desc) extern lock_class_t var
+
+#define spin_lock_class(l, cls)         spin_lock(l)
+#define spin_lock_irqsave_class(l, cls) spin_lock_irqsave(l)
+#define mcs_lock_class(l, n, cls)       mcs_lock(l, n)
+#define mutex_lock_class(m, cls)        mutex_lock(m)
+
+#define WITH_MCS_LOCK_CLASS(lock, cls) WITH_MCS_LOCK(lock)
+#define WITH_MUTEX_CLASS(lock, cls)    WITH_MUTEX(lock)
+
+#endif // LOCKSTAT
+
+#endif // KERN_LOCKSTAT_H
@@ -0,0 +1,125 @@
+#include "mutex.h"
+#include "panic.h"
+#include "rcu.h"
+
+#include <sys/pcpu.h>
+
+static bool mutex_cmpxchg(mutex_t* m, uintptr_t expected, uintptr_t owner)
+{
+    uintptr_t prev;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(prev), "+m"(m->owner)
+                 : "r"(owner), "a"(expected)
+                 : "memory");
+    return prev == expected;
+}
+
+// Whether the thread owning m, as of owner, is still running. The owner may unlock and exit at any
+// moment; threads are freed through RCU, so the one read here stays valid inside the section.
+static bool mutex_owner_running(mutex_t* m, uintptr_t owner)
+{
+    bool running = true; // If m changed hands in the meantime, the caller looks again
+    WITH_RCU_READ_LOCK()
+    {
+        // Only an owner loaded inside the section is covered by it
+        if (m->owner == owner)
+            running = ((thread_t*)(owner & ~MUTEX_FLAGS))->on_cpu;
+    }
+    return running;
+}
+
+// Spins while the owner is running on another CPU. Returns whether the mutex was taken.
+static bool mutex_spin(mutex_t* m, thread_t* self)
+{
+    for (int spins = 0; spins < MUTEX_SPIN_MAX; spins++) {
+        uintptr_t owner = m->owner;
+        if (!owner) {
+            if (mutex_cmpxchg(m, 0, (uintptr_t)self))
+                return true;
+            continue;
+        }
+
+        // Sleepers get the mutex handed to them first, and an owner that is not running will not
+        // release it any time soon
+        if ((owner & MUTEX_WAITERS) || !mutex_owner_running(m, owner))
+            return false;
+        asm volatile("pause");
+    }
+
+    return false;
+}
+
+// wait_event condition, checked while queued on the mutex. Takes the mutex if it is free or was
+// handed over, otherwise sets MUTEX_WAITERS so the owner's unlock comes to wake us.
+static bool mutex_acquire_or_flag(mutex_t* m, thread_t* self)
+{
+    for (;;) {
+        uintptr_t owner = m->owner;
+        if ((owner & ~MUTEX_FLAGS) == (uintptr_t)self)
+            return true;
+        if (!owner) {
+            if (mutex_cmpxchg(m, 0, (uintptr_t)self))
+                return true;
+        }
+        else if ((owner & MUTEX_WAITERS) || mutex_cmpxchg(m, owner, owner | MUTEX_WAITERS)) {
+            return false;
+        }
+    }
+}
+
+void mutex_init(mutex_t* m)
+{
+    m->owner = 0;
+    wait_queue_init(&m->waiters);
+}
+
+void mutex_lock(mutex_t* m)
+{
+    thread_t* self = PCPU_GET(current_thread);
+    if (mutex_cmpxchg(m, 0, (uintptr_t)self))
+        return;
+
+    if (mutex_owner(m) == self)
+        PANIC("mutex_lock: Mutex already held by the current thread");
+
+    if (mutex_spin(m, self))
+        return;
+
+    wait_event(m->waiters, mutex_acquire_or_flag(m, self));
+}
+
+void mutex_unlock(mutex_t* m)
+{
+    thread_t* self = PCPU_GET(current_thread);
+    if (mutex_owner(m) != self)
+        PANIC("mutex_unlock: Mutex not held by the current thread");
+
+    if (mutex_cmpxchg(m, (uintptr_t)self, 0))
+        return; // Nobody is sleeping on it
+
+    // Hand the mutex to the oldest sleeper. Waiters queue under the same lock, so the flag left for
+    // the new owner is accurate; later arrivals set it themselves.
+    uint32_t  eflags = spin_lock_irqsave(&m->waiters.lock);
+    thread_t* next   = wake_one_locked(&m->waiters);
+    if (next)
+        m->owner = (uintptr_t)next | (m->waiters.waiters.head ? MUTEX_WAITERS : 0);
+    else
+        m->owner = 0;
+    spin_unlock_irqrestore(&m->waiters.lock, eflags);
+}
+
+int mutex_trylock(mutex_t* m)
+{
+    return !mutex_cmpxchg(m, 0, (uintptr_t)PCPU_GET(current_thread));
+}
+
+bool mutex_held(mutex_t* m)
+{
+    return mutex_owner(m) == PCPU_GET(current_thread);
+}
+
+void _mutex_cleanup(mutex_t** m)
+{
+    if (m && *m)
+        mutex_unlock(*m);
+}
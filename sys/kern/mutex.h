@@ -1,4 +1,53 @@
 #ifndef MUTEX_H
 #define MUTEX_H
 
+#include "process.h"
+#include "wait_queue.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*
+ * Sleeping mutex for long critical sections. A contended locker spins while the owner is running on
+ * another CPU, as the lock is then likely to be released soon, and otherwise sleeps on the mutex's
+ * wait queue. Unlock hands the mutex straight to the oldest sleeper, so waiters are served in order
+ * and a running thread cannot barge in ahead of them.
+ *
+ * Mutexes may only be taken from thread context, never from an interrupt handler.
+ */
+
+#define MUTEX_WAITERS  0x1 // Set in owner while threads sleep on the mutex
+#define MUTEX_FLAGS    0x3 // Low bits of owner that are not part of the thread pointer
+#define MUTEX_SPIN_MAX 1000
+
+typedef struct mutex {
+    volatile uintptr_t owner; // Owning thread_t, NULL while free, plus MUTEX_WAITERS
+    wait_queue_t       waiters;
+} mutex_t;
+
+#define MUTEX_INITIALIZER                                                                          \
+    {                                                                                              \
+        .owner = 0, .waiters = WAIT_QUEUE_INIT                                                     \
+    }
+
+#define WITH_MUTEX(lock)                                                                           \
+    for (mutex_t * _mutex_cleanup_var __attribute__((cleanup(_mutex_cleanup))) =                  \
+             (mutex_lock(&(lock)), &(lock)),                                                       \
+             *_mutex_once = _mutex_cleanup_var;                                                    \
+         _mutex_once; _mutex_once = NULL)
+
+void mutex_init(mutex_t* m);
+void mutex_lock(mutex_t* m);
+void mutex_unlock(mutex_t* m);
+/* Returns 0 on success, non-zero if the mutex is held */
+int  mutex_trylock(mutex_t* m);
+void _mutex_cleanup(mutex_t** m);
+/* Whether the current thread owns m */
+bool mutex_held(mutex_t* m);
+
+static inline thread_t* mutex_owner(mutex_t* m)
+{
+    return (thread_t*)(m->owner & ~MUTEX_FLAGS);
+}
+
 #endif // MUTEX_H
@@ -7,6 +7,7 @@
 #define PIT_PORT_CH0  0x40
 #define PIT_MODE_ONESHOT                                                                           \
     0x30 // Channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count), binary mode
+#define PIT_LATCH_CH0 0x00 // Counter latch command for channel 0
 
 // WARNING: If the time is too long then an overflow error will occur on division causing a DE fault
 void delay_us(int us)
@@ -25,10 +26,15 @@ void delay_us(int us)
     // Then high byte
     outb(PIT_PORT_CH0, (count >> 8) & 0xFF);
 
-    // Wait until counter reaches zero
-    while (inb(PIT_PORT_CH0) != 0) {
+    // Wait until counter reaches zero. The count is latched so both bytes come from the same
+    // reading, and mode 0 keeps counting down past zero, so a wrapped value also means done.
+    uint16_t now;
+    do {
         asm volatile("pause");
-    }
+        outb(PIT_PORT_CMD, PIT_LATCH_CH0);
+        now = inb(PIT_PORT_CH0);
+        now |= inb(PIT_PORT_CH0) << 8;
+    } while (now != 0 && now <= count);
 }
 
 void delay_ms(int ms)
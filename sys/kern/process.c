@@ -1,27 +1,28 @@
 #include "process.h"
 #include "elf.h"
 #include "fd.h"
+#include "ioring.h"
+#include "lockstat.h"
 #include "panic.h"
 #include "terminal.h"
+#include "wait_queue.h"
 
 #include <sys/pcpu.h>
 
 #include <vm/kmalloc.h>
+#include <vm/vm_kstack.h>
 #include <vm/vm_map.h>
 
+#include <machine/cpufunc.h>
 #include <machine/gdt.h>
 
 #include <kern/errno.h>
+#include <kern/lapic.h>
+#include <kern/timer.h>
 
 #include <list.h>
 #include <string.h>
 
-#define STACK_SIZE        4096
-#define USER_STACK_TOP    0xC0000000 // 3GB
-#define USER_STACK_BOTTOM (USER_STACK_TOP - STACK_SIZE)
-
-vaddr_t user_stack_bottom = USER_STACK_BOTTOM;
-
 static list_t all_processes = LIST_INIT_START(&idle_process.node);
 proc_t        idle_process  = {
     .pid      = 0,
@@ -33,86 +34,358 @@ proc_t        idle_process  = {
     .node     = LIST_NODE_INIT(&all_processes),
 };
 
-thread_t idle_thread = {
-    .tid         = 0,
-    .state       = TASK_RUNNING,
-    .priority    = 0,
-    .kstack      = NULL,
-    .kstack_size = 0,
-    .context     = NULL,
-    .trapframe   = NULL,
-    .node        = {0},
-    .proc_node   = LIST_NODE_INIT(&idle_process.threads),
+// One idle thread per CPU, all with TID 0. Each is whatever context brought its CPU up and then
+// called sched_idle, so it has no kernel stack of its own.
+static thread_t idle_threads[MAX_CPUS];
+
+thread_t* sched_idle_thread_init(pcpu_t* pcpu)
+{
+    thread_t* t  = &idle_threads[pcpu - pcpus];
+    t->tid       = 0;
+    t->state     = TASK_RUNNING;
+    t->priority  = 0;
+    t->pcpu      = pcpu;
+    t->proc_node = (list_node_t)LIST_NODE_INIT(&idle_process.threads);
+    return t;
+}
+
+/* ---------------- PIDs / TIDs ---------------- */
+
+// PIDs and TIDs each come from a bitmap, searched from just past the last ID handed out so a freed
+// ID is only reused once the space wraps around. Each space also maps its IDs to their process or
+// thread. IDs are dense, so their low bits spread them evenly over the buckets. ID 0 belongs to
+// the idle process and thread and is never handed out.
+#define ID_MAX     32768
+#define ID_BUCKETS 256
+
+typedef struct id_space {
+    spinlock_t  lock; // Guards everything below
+    uint32_t    last; // Last ID handed out
+    uint32_t    used[ID_MAX / 32];
+    hashtable_t table;
+    list_t      buckets[ID_BUCKETS];
+} id_space_t;
+
+static id_space_t pid_space = {
+    .lock  = SPINLOCK_INITIALIZER,
+    .used  = {1},
+    .table = {.buckets = pid_space.buckets, .bucket_count = ID_BUCKETS},
+};
+static id_space_t tid_space = {
+    .lock  = SPINLOCK_INITIALIZER,
+    .used  = {1},
+    .table = {.buckets = tid_space.buckets, .bucket_count = ID_BUCKETS},
 };
 
-static uint32_t next_pid = 1;
-static uint32_t next_tid = 1;
+// Reserves an unused ID, or returns -EAGAIN once all of them are taken
+static int id_alloc(id_space_t* space)
+{
+    int      id     = -EAGAIN;
+    uint32_t eflags = spin_lock_irqsave(&space->lock);
+
+    uint32_t candidate = space->last;
+    for (uint32_t n = 0; n < ID_MAX; n++) {
+        candidate      = (candidate + 1) & (ID_MAX - 1);
+        uint32_t* word = &space->used[candidate >> 5];
+        if (*word == 0xFFFFFFFF) {
+            candidate |= 31; // Skip the rest of a full word
+            continue;
+        }
+        if (*word & (1u << (candidate & 31)))
+            continue;
 
-thread_t* create_kernel_thread(void (*entry)(void), proc_t* p, uint32_t priority, pcpu_t* pcpu)
+        *word |= 1u << (candidate & 31);
+        space->last = candidate;
+        id          = candidate;
+        break;
+    }
+
+    spin_unlock_irqrestore(&space->lock, eflags);
+    return id;
+}
+
+// Makes entry findable by its key. Done once the object is fully set up.
+static void id_publish(id_space_t* space, hashtable_entry_t* entry)
 {
-    if (!p)
+    WITH_SPINLOCK_IRQSAVE(space->lock)
+    {
+        hashtable_put(&space->table, entry);
+    }
+}
+
+// Unpublishes id, if it was published, and returns it to the free pool
+static void id_free(id_space_t* space, uint32_t id)
+{
+    WITH_SPINLOCK_IRQSAVE(space->lock)
+    {
+        hashtable_remove(&space->table, id, NULL);
+        space->used[id >> 5] &= ~(1u << (id & 31));
+    }
+}
+
+static hashtable_entry_t* id_lookup(id_space_t* space, uint32_t id)
+{
+    hashtable_entry_t* entry = NULL;
+    WITH_SPINLOCK_IRQSAVE(space->lock)
+    {
+        hashtable_get(&space->table, id, &entry);
+    }
+    return entry;
+}
+
+// The result is only safe to use while the caller knows the process cannot be freed
+proc_t* proc_find(uint32_t pid)
+{
+    if (pid == 0)
+        return &idle_process;
+
+    hashtable_entry_t* entry = id_lookup(&pid_space, pid);
+    return entry ? container_of(entry, proc_t, id_entry) : NULL;
+}
+
+// The result is only safe to use while the caller knows the thread cannot be freed. TID 0 is the
+// calling CPU's idle thread.
+thread_t* thread_find(uint32_t tid)
+{
+    if (tid == 0)
+        return get_pcpu()->idle_thread;
+
+    hashtable_entry_t* entry = id_lookup(&tid_space, tid);
+    return entry ? container_of(entry, thread_t, id_entry) : NULL;
+}
+
+LOCK_CLASS(runqueue_lock_class, "runqueue");
+
+/* ---------------- Runqueues ---------------- */
+
+// Takes a CPU's runqueue lock from thread context. Interrupts stay off while it is held, as an
+// interrupt handler waking a thread on this CPU would otherwise spin on it forever.
+static uint32_t rq_lock(pcpu_t* pcpu)
+{
+    return spin_lock_irqsave_class(&pcpu->runqueue_lock, runqueue_lock_class);
+}
+
+static void rq_unlock(pcpu_t* pcpu, uint32_t eflags)
+{
+    spin_unlock_irqrestore(&pcpu->runqueue_lock, eflags);
+}
+
+static void runqueue_push(pcpu_t* pcpu, thread_t* t)
+{
+    list_push_tail(&pcpu->runqueues[t->priority], &t->node);
+    pcpu->runqueue_bitmap |= 1U << t->priority;
+    pcpu->nr_running++;
+}
+
+static void runqueue_remove(pcpu_t* pcpu, thread_t* t)
+{
+    list_remove(&t->node);
+    if (!pcpu->runqueues[t->priority].size)
+        pcpu->runqueue_bitmap &= ~(1U << t->priority);
+    pcpu->nr_running--;
+}
+
+// Dequeues the first thread of the most urgent non-empty level
+static thread_t* runqueue_pop(pcpu_t* pcpu)
+{
+    if (!pcpu->runqueue_bitmap)
         return NULL;
 
+    uint32_t  prio = __builtin_ctz(pcpu->runqueue_bitmap); // A single bsf
+    thread_t* t    = thread_from_runqueue_node(list_pop_head(&pcpu->runqueues[prio]));
+    if (!pcpu->runqueues[prio].size)
+        pcpu->runqueue_bitmap &= ~(1U << prio);
+    pcpu->nr_running--;
+    return t;
+}
+
+// Whether t, just queued on pcpu, should interrupt what pcpu is running. Runqueue lock held.
+static bool sched_should_kick(pcpu_t* pcpu, thread_t* t)
+{
+    if (pcpu == get_pcpu() || !pcpu->started)
+        return false;
+    thread_t* curr = pcpu->current_thread;
+    return curr == pcpu->idle_thread || t->priority < curr->priority;
+}
+
+// Hands a new READY thread to a CPU
+static void sched_attach(thread_t* t, pcpu_t* pcpu)
+{
+    if (t->priority > SCHED_PRIO_MIN)
+        t->priority = SCHED_PRIO_MIN;
+    if (!pcpu)
+        pcpu = select_pcpu();
+    t->pcpu = pcpu;
+
+    uint32_t eflags = rq_lock(pcpu);
+    runqueue_push(pcpu, t);
+    pcpu->total_priority += SCHED_SLICE(t->priority);
+    bool kick = sched_should_kick(pcpu, t);
+    rq_unlock(pcpu, eflags);
+
+    if (kick)
+        send_resched_ipi(pcpu->apic_id);
+}
+
+// Moves a READY thread between CPUs, both runqueue locks held
+static void runqueue_migrate(thread_t* t, pcpu_t* from, pcpu_t* to)
+{
+    runqueue_remove(from, t);
+    from->total_priority -= SCHED_SLICE(t->priority);
+    t->pcpu = to;
+    to->total_priority += SCHED_SLICE(t->priority);
+}
+
+// A thread that ran within the last SCHED_MIGRATION_COST ticks still has a warm cache on its CPU
+static bool thread_cache_hot(thread_t* t)
+{
+    return t->last_ran && get_pcpu_from_thread(t)->ticks - t->last_ran < SCHED_MIGRATION_COST;
+}
+
+// Picks the started peer with the most runnable threads, total_priority breaking ties
+static pcpu_t* find_busiest_pcpu(pcpu_t* self)
+{
+    pcpu_t* busiest = NULL;
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        pcpu_t* pcpu = &pcpus[i];
+        if (pcpu == self || !pcpu->started || !pcpu->nr_running)
+            continue;
+        if (!busiest || pcpu->nr_running > busiest->nr_running ||
+            (pcpu->nr_running == busiest->nr_running &&
+             pcpu->total_priority > busiest->total_priority))
+            busiest = pcpu;
+    }
+    return busiest;
+}
+
+// Pulls one runnable thread from the busiest peer onto self, whose runqueue lock is held. An idle
+// CPU takes any thread that is not mid-switch; the periodic balancer only moves cache-cold threads
+// and only when it narrows the gap. The peer's lock is only tried, as two CPUs may be pulling from
+// each other. Returns the thread, detached from every runqueue, or NULL.
+static thread_t* sched_steal(pcpu_t* self, bool idle)
+{
+    pcpu_t* busiest = find_busiest_pcpu(self);
+    if (!busiest)
+        return NULL;
+    if (!idle && busiest->nr_running < self->nr_running + 2)
+        return NULL;
+    if (spin_trylock(&busiest->runqueue_lock) != 0)
+        return NULL;
+
+    // Most urgent work first, taking the thread that would have waited longest on the peer
+    thread_t* stolen = NULL;
+    for (uint32_t bitmap = busiest->runqueue_bitmap; bitmap && !stolen; bitmap &= bitmap - 1) {
+        list_t* rq = &busiest->runqueues[__builtin_ctz(bitmap)];
+        for (list_node_t* node = rq->tail; node; node = node->prev) {
+            thread_t* t = thread_from_runqueue_node(node);
+            if (t->on_cpu || (!idle && thread_cache_hot(t)))
+                continue;
+            stolen = t;
+            break;
+        }
+    }
+    if (stolen)
+        runqueue_migrate(stolen, busiest, self);
+
+    spin_unlock(&busiest->runqueue_lock);
+    return stolen;
+}
+
+// Periodic rebalance from the timer tick. Idle CPUs take no ticks, so a CPU that still has work
+// queued also kicks one of them into stealing it.
+static void sched_balance(pcpu_t* pcpu)
+{
+    spin_lock(&pcpu->runqueue_lock);
+    thread_t* t = sched_steal(pcpu, false);
+    if (t)
+        runqueue_push(pcpu, t);
+    bool queued = pcpu->nr_running != 0;
+    spin_unlock(&pcpu->runqueue_lock);
+
+    for (uint32_t i = 0; queued && i < cpu_count; i++) {
+        pcpu_t* peer = &pcpus[i];
+        if (peer != pcpu && peer->started && peer->current_thread == peer->idle_thread &&
+            !peer->nr_running) {
+            send_resched_ipi(peer->apic_id);
+            break;
+        }
+    }
+}
+
+static void proc_add_thread(proc_t* p, thread_t* t)
+{
+    WITH_SPINLOCK(p->lock)
+    {
+        list_push_tail(&p->threads, &t->proc_node);
+    }
+}
+
+// Allocates a thread with its TID and kernel stack. It is not findable by TID until published.
+static thread_t* thread_alloc(uint32_t priority)
+{
     thread_t* t = kmalloc(sizeof(thread_t));
     if (!t)
         return NULL;
     memset(t, 0, sizeof(*t));
 
-    t->tid      = next_tid++;
-    t->state    = TASK_READY;
-    t->priority = priority;
+    int tid = id_alloc(&tid_space);
+    if (tid < 0) {
+        kfree(t);
+        return NULL;
+    }
+
+    t->tid          = tid;
+    t->id_entry.key = tid;
+    t->state        = TASK_READY;
+    t->priority     = priority;
 
-    t->kstack = kmalloc(STACK_SIZE);
+    t->kstack = vm_kstack_alloc();
     if (!t->kstack) {
+        id_free(&tid_space, t->tid);
         kfree(t);
         return NULL;
     }
-    memset(t->kstack, 0, STACK_SIZE);
-    t->kstack_size = STACK_SIZE;
+    t->kstack_size = KSTACK_SIZE;
 
-    uint32_t* stk = (uint32_t*)(t->kstack + STACK_SIZE);
-    context_init(t, entry, stk, 0);
+    return t;
+}
+
+thread_t* create_kernel_thread(void (*entry)(void), proc_t* p, uint32_t priority, pcpu_t* pcpu)
+{
+    if (!p)
+        return NULL;
 
-    list_push_tail(&p->threads, &t->proc_node);
+    thread_t* t = thread_alloc(priority);
+    if (!t)
+        return NULL;
 
-    if (!pcpu)
-        pcpu = select_pcpu();
-    list_push_tail(&pcpu->runqueue, &t->node);
+    uint32_t* stk = (uint32_t*)(t->kstack + KSTACK_SIZE);
+    context_init(t, entry, stk, 0);
+
+    proc_add_thread(p, t);
+    id_publish(&tid_space, &t->id_entry);
+    sched_attach(t, pcpu);
 
     return t;
 }
 
 thread_t* create_user_thread(void (*entry)(void), proc_t* p, uint32_t priority, pcpu_t* pcpu,
-                             void* user_stack_top)
+                             void* user_stack_top, uintptr_t tls_base)
 {
     if (!p)
         return NULL;
 
-    thread_t* t = kmalloc(sizeof(thread_t));
+    thread_t* t = thread_alloc(priority);
     if (!t)
         return NULL;
-    memset(t, 0, sizeof(*t));
-
-    t->tid      = next_tid++;
-    t->state    = TASK_READY;
-    t->priority = priority;
-
-    t->kstack = kmalloc(STACK_SIZE);
-    if (!t->kstack) {
-        kfree(t);
-        return NULL;
-    }
-    memset(t->kstack, 0, STACK_SIZE);
-    t->kstack_size = STACK_SIZE;
 
-    uint32_t* stk = (uint32_t*)(t->kstack + STACK_SIZE);
+    uint32_t* stk = (uint32_t*)(t->kstack + KSTACK_SIZE);
     context_init(t, entry, stk, (uint32_t)user_stack_top); // Start user stack at the top
+    t->tls_base = tls_base;
 
-    list_push_tail(&p->threads, &t->proc_node);
-    if (!pcpu)
-        pcpu = select_pcpu();
-    list_push_tail(&pcpu->runqueue, &t->node);
-    pcpu->total_priority += priority;
+    proc_add_thread(p, t);
+    id_publish(&tid_space, &t->id_entry);
+    sched_attach(t, pcpu);
 
     return t;
 }
@@ -123,34 +396,20 @@ thread_t* fork_user_thread(thread_t* parent_thread, proc_t* child_proc, uint32_t
     if (!parent_thread || !child_proc)
         return NULL;
 
-    thread_t* t = kmalloc(sizeof(thread_t));
+    thread_t* t = thread_alloc(priority);
     if (!t)
         return NULL;
-    memset(t, 0, sizeof(*t));
 
-    t->tid      = next_tid++;
-    t->state    = TASK_READY;
-    t->priority = priority;
-
-    t->kstack = kmalloc(STACK_SIZE);
-    if (!t->kstack) {
-        kfree(t);
-        return NULL;
-    }
-    memset(t->kstack, 0, STACK_SIZE);
-    t->kstack_size = STACK_SIZE;
-
-    uint32_t* stk = (uint32_t*)(t->kstack + STACK_SIZE);
+    uint32_t* stk = (uint32_t*)(t->kstack + KSTACK_SIZE);
+    t->tls_base   = parent_thread->tls_base;
 
     context_fork(
         t, parent_thread,
         stk); // Set up context to start at start_fork with a copy of the parent's trapframe
 
-    list_push_tail(&child_proc->threads, &t->proc_node);
-    if (!pcpu)
-        pcpu = select_pcpu();
-    list_push_tail(&pcpu->runqueue, &t->node);
-    pcpu->total_priority += priority;
+    proc_add_thread(child_proc, t);
+    id_publish(&tid_space, &t->id_entry);
+    sched_attach(t, pcpu);
 
     return t;
 }
@@ -161,8 +420,15 @@ proc_t* create_process(const char* name)
     if (!p)
         return NULL;
     memset(p, 0, sizeof(*p));
-    p->pid  = next_pid++;
-    p->ppid = 0; // For now, no parent-child relationships
+
+    int pid = id_alloc(&pid_space);
+    if (pid < 0) {
+        kfree(p);
+        return NULL;
+    }
+    p->pid          = pid;
+    p->id_entry.key = pid;
+    p->ppid         = 0; // For now, no parent-child relationships
     if (name) {
         // Copy name with safety
         strncpy(p->name, name, sizeof(p->name) - 1);
@@ -172,10 +438,15 @@ proc_t* create_process(const char* name)
     list_init(&p->threads, 0);
     p->vmspace = vm_space_fork(&kernel_vm_space); // Start with a copy of the kernel VM space
 
+    for (int i = 0; i < RLIM_NLIMITS; i++)
+        p->rlimits[i] = (rlimit_t){.rlim_cur = RLIM_INFINITY, .rlim_max = RLIM_INFINITY};
+    p->rlimits[RLIMIT_STACK].rlim_cur = RLIMIT_STACK_DEFAULT;
+
     // Create file descriptor table
     p->fd_table = fd_table_create();
     if (!p->fd_table) {
         vm_space_destroy(p->vmspace);
+        id_free(&pid_space, p->pid);
         kfree(p);
         return NULL;
     }
@@ -184,6 +455,7 @@ proc_t* create_process(const char* name)
     fd_init_stdio(p);
 
     list_push_tail(&all_processes, &p->node);
+    id_publish(&pid_space, &p->id_entry);
     return p;
 }
 
@@ -199,33 +471,46 @@ int fork_process(thread_t* t, int flags, proc_t** child_out)
         return -ENOMEM;
     memset(child, 0, sizeof(*child));
 
-    child->pid  = next_pid++;
-    child->ppid = parent->pid;
+    int pid = id_alloc(&pid_space);
+    if (pid < 0) {
+        kfree(child);
+        return pid;
+    }
+    child->pid          = pid;
+    child->id_entry.key = pid;
+    child->ppid         = parent->pid;
 
     strncpy(child->name, parent->name, sizeof(child->name) - 1);
     child->name[sizeof(child->name) - 1] = '\0';
+    memcpy(child->rlimits, parent->rlimits, sizeof(child->rlimits));
 
     child->vmspace = vm_space_fork(parent->vmspace);
     if (IS_ERR(child->vmspace)) {
+        int err = (int)child->vmspace;
+        id_free(&pid_space, child->pid);
         kfree(child);
-        return (int)child->vmspace;
+        return err;
     }
     child->fd_table = fd_table_fork(parent->fd_table);
     if (IS_ERR(child->fd_table)) {
+        int err = (int)child->fd_table;
         vm_space_destroy(child->vmspace);
+        id_free(&pid_space, child->pid);
         kfree(child);
-        return (int)child->fd_table;
+        return err;
     }
 
     printf("Child process cr3: 0x%08x\n", child->vmspace->arch->pd);
 
     list_init(&child->threads, 0);
     list_push_tail(&all_processes, &child->node);
+    id_publish(&pid_space, &child->id_entry);
 
     // Create a new thread for the child process that starts at the same entry point as the parent
     thread_t* child_thread = fork_user_thread(t, child, t->priority, NULL);
     if (!child_thread) {
         list_remove(&child->node);
+        id_free(&pid_space, child->pid);
         vm_space_destroy(child->vmspace);
         fd_table_destroy(child->fd_table);
         kfree(child);
@@ -238,40 +523,67 @@ int fork_process(thread_t* t, int flags, proc_t** child_out)
     return 0;
 }
 
+// Places a new thread on the least loaded started CPU: the smallest sum of time slices, then the
+// shortest runqueue. The loads are read unlocked, a stale value only costs a later rebalance.
 pcpu_t* select_pcpu()
 {
     pcpu_t* lowest = &pcpus[0];
-    return lowest;
     for (uint32_t i = 1; i < cpu_count; i++) {
-        if (pcpus[i].total_priority < lowest->total_priority)
-            lowest = &pcpus[i];
+        pcpu_t* pcpu = &pcpus[i];
+        if (!pcpu->started)
+            continue;
+        if (pcpu->total_priority < lowest->total_priority ||
+            (pcpu->total_priority == lowest->total_priority &&
+             pcpu->nr_running < lowest->nr_running))
+            lowest = pcpu;
     }
     return lowest;
 }
 
 /* ---------------- Freeing / Reaping ---------------- */
 
-// Free a single thread (assumes it's already removed from runqueue and proc list)
+static void free_thread_rcu(rcu_head_t* head)
+{
+    kfree(container_of(head, thread_t, rcu));
+}
+
+// Free a single thread, removing it from its process and from whichever scheduler list holds it.
+// The thread must have been switched away from for good.
 void free_thread(thread_t* t)
 {
     if (!t)
         return;
     pcpu_t* pcpu = get_pcpu_from_thread(t);
-    if (pcpu && t == pcpu->current_thread)
+    if (pcpu && (t == pcpu->current_thread || t->on_cpu))
         PANIC("Attempted to free the current running thread!");
 
-    proc_t* p = get_proc_from_thread(t);
-
-    list_remove(&t->proc_node); // Remove from process thread list
-    list_remove(&t->node);      // Remove from runqueue if still present
-    pcpu->total_priority -= t->priority;
+    proc_t*  p         = get_proc_from_thread(t);
+    uint32_t remaining = 0;
+    if (p) {
+        WITH_SPINLOCK(p->lock)
+        {
+            list_remove(&t->proc_node); // Remove from process thread list
+            remaining = p->threads.size;
+        }
+    }
 
-    if (p && p->threads.size == 0)
+    uint32_t eflags = rq_lock(pcpu);
+    if (t->node.list && t->state == TASK_READY)
+        runqueue_remove(pcpu, t);
+    else if (t->node.list)
+        list_remove(&t->node); // Remove from the zombie list
+    pcpu->total_priority -= SCHED_SLICE(t->priority);
+    rq_unlock(pcpu, eflags);
+
+    if (p && p->ioring && remaining == 1)
+        ioring_release(p); // The ring's worker may be all that is left
+    if (p && remaining == 0)
         free_process(p);
 
+    id_free(&tid_space, t->tid);
     if (t->kstack)
-        kfree(t->kstack);
-    kfree(t);
+        vm_kstack_free(t->kstack);
+    call_rcu(&t->rcu, free_thread_rcu);
 }
 
 void free_process(proc_t* p)
@@ -282,6 +594,7 @@ void free_process(proc_t* p)
     printf("Freeing process %d (%s)\n", p->pid, p->name);
 
     list_remove(&p->node); // Remove from global process list
+    id_free(&pid_space, p->pid);
 
     if (p->vmspace)
         vm_space_destroy(p->vmspace);
@@ -294,26 +607,55 @@ void free_process(proc_t* p)
 
 /* ---------------- Scheduling ---------------- */
 
-thread_t* get_next_ready_thread(thread_t* prev)
+// Exited threads are parked on their CPU's zombie list by the scheduler and freed by the reaper
+// thread, so the switch away from them stays short whatever freeing their process costs
+static wait_queue_t reaper_queue = WAIT_QUEUE_INIT;
+
+// A zombie is freeable once its CPU has finished switching away from it
+static bool sched_zombie_ready(pcpu_t* pcpu)
 {
-    thread_t* next = thread_from_runqueue_node(prev->node.next);
-    if (!next)
-        PANIC("get_next_ready_thread: Current thread not in runqueue or runqueue is empty");
+    list_node_t* node = pcpu->zombies.head;
+    return node && !thread_from_runqueue_node(node)->on_cpu;
+}
 
-    thread_t* start = next;
-    while (next->state != TASK_READY) {
-        if (next->state == TASK_ZOMBIE && next != PCPU_GET(current_thread)) {
-            thread_t* to_free = next;
-            next              = thread_from_runqueue_node(next->node.next);
-            free_thread(to_free);
-        }
-        else {
-            next = thread_from_runqueue_node(next->node.next);
+static bool sched_zombies_ready(void)
+{
+    for (uint32_t i = 0; i < cpu_count; i++)
+        if (sched_zombie_ready(&pcpus[i]))
+            return true;
+    return false;
+}
+
+static thread_t* sched_pop_zombie(pcpu_t* pcpu)
+{
+    thread_t* t      = NULL;
+    uint32_t  eflags = rq_lock(pcpu);
+    if (sched_zombie_ready(pcpu)) {
+        t = thread_from_runqueue_node(pcpu->zombies.head);
+        list_remove(&t->node);
+    }
+    rq_unlock(pcpu, eflags);
+    return t;
+}
+
+static void sched_reaper(void)
+{
+    for (;;) {
+        wait_event(reaper_queue, sched_zombies_ready());
+
+        for (uint32_t i = 0; i < cpu_count; i++) {
+            thread_t* t;
+            while ((t = sched_pop_zombie(&pcpus[i])))
+                free_thread(t);
         }
-        if (!next || next == start)
-            return NULL;
     }
-    return next;
+}
+
+int sched_reaper_init(void)
+{
+    if (!create_kernel_thread(sched_reaper, &idle_process, SCHED_PRIO_DEFAULT, NULL))
+        return -ENOMEM;
+    return 0;
 }
 
 void thread_exit(registers_t* regs)
@@ -326,26 +668,146 @@ void thread_exit(registers_t* regs)
 
 void yield()
 {
+    get_pcpu()->slice_ticks = 0;          // Give up the rest of the slice
     asm volatile("int $0x20" : : "a"(0)); // Trigger scheduler interrupt (vector 64)
 }
 
+void sched_tick(registers_t* regs)
+{
+    pcpu_t* pcpu = get_pcpu();
+
+    pcpu->ticks++;
+    if (--pcpu->balance_ticks == 0) {
+        pcpu->balance_ticks = SCHED_BALANCE_INTERVAL;
+        sched_balance(pcpu);
+    }
+
+    // The idle thread has no slice, it only runs while the runqueues are empty
+    if (pcpu->current_thread != pcpu->idle_thread && pcpu->slice_ticks > 1) {
+        pcpu->slice_ticks--;
+        return;
+    }
+
+    schedule_from_irq(regs);
+}
+
+// Body of the idle thread: halts until an interrupt, the timer or a reschedule IPI, may have put
+// work on the runqueues
+void sched_idle(void)
+{
+    pcpu_t* pcpu = get_pcpu();
+    for (;;) {
+        intr_disable();
+        if (pcpu->nr_running) {
+            intr_enable();
+            yield();
+        }
+        else {
+            intr_enable_halt(); // Returns with interrupts on, after the handler ran
+        }
+    }
+}
+
+void sched_wakeup(thread_t* t)
+{
+    pcpu_t*  pcpu   = get_pcpu_from_thread(t);
+    uint32_t eflags = rq_lock(pcpu);
+    bool     kick   = false;
+
+    // A thread marks itself blocked before yielding, so it may not have been switched out yet. It
+    // then only needs to keep running; the scheduler requeues it like any preempted thread.
+    if (t->state == TASK_BLOCKED || t->state == TASK_SLEEPING || t->state == TASK_STOPPED) {
+        if (t == pcpu->current_thread) {
+            t->state = TASK_RUNNING;
+        }
+        else {
+            t->state = TASK_READY;
+            runqueue_push(pcpu, t);
+            kick = sched_should_kick(pcpu, t);
+        }
+    }
+
+    rq_unlock(pcpu, eflags);
+
+    if (kick)
+        send_resched_ipi(pcpu->apic_id);
+}
+
+// Completes a context switch on whichever CPU the incoming thread now runs on: the outgoing thread
+// may be pulled by other CPUs from here on, and this CPU can be rescheduled. Also the first thing
+// start_thread and start_fork run.
+void sched_switch_finish(void)
+{
+    pcpu_t*   pcpu = get_pcpu();
+    thread_t* prev = pcpu->prev_thread;
+    bool      dead = prev && prev->state == TASK_ZOMBIE;
+
+    pcpu->prev_thread = NULL;
+    if (prev)
+        prev->on_cpu = 0; // From here on a zombie prev may be freed
+    spin_unlock(&pcpu->scheduler_lock);
+
+    if (dead)
+        wake_one(&reaper_queue);
+}
+
 void schedule_from_irq(registers_t* regs)
 {
     pcpu_t* pcpu = get_pcpu();
 
+    // A thread inside an RCU read-side section keeps the CPU; its slice stays used up, so the next
+    // tick tries again
+    if (pcpu->rcu_nesting)
+        return;
+
     if (spin_trylock(&pcpu->scheduler_lock) != 0)
         return;
 
+    pcpu->rcu_qs++; // Whatever ran last has left its read sections, see synchronize_rcu
+
+    // Only runnable threads sit in the runqueues: a preempted thread goes to the back of its level,
+    // a blocked one waits for sched_wakeup, and an exited one waits for the reaper. The runqueue
+    // lock covers the choice and current_thread, which sched_wakeup checks under it.
+    spin_lock(&pcpu->runqueue_lock);
+
     thread_t* prev = pcpu->current_thread;
-    thread_t* next = get_next_ready_thread(prev);
+    prev->last_ran = pcpu->ticks;
+    if (prev->state == TASK_RUNNING && prev != pcpu->idle_thread) {
+        prev->state = TASK_READY;
+        runqueue_push(pcpu, prev);
+    }
+    else if (prev->state == TASK_ZOMBIE) {
+        list_push_tail(&pcpu->zombies, &prev->node);
+    }
 
-    if (!next || next == prev) {
+    thread_t* next = runqueue_pop(pcpu);
+    if (!next) {
+        next = sched_steal(pcpu, true); // Idle, pull work from the busiest peer
+        if (!next)
+            next = pcpu->idle_thread;
+    }
+    pcpu->slice_ticks = SCHED_SLICE(next->priority);
+
+    if (next == prev) {
+        next->state = TASK_RUNNING;
+        spin_unlock(&pcpu->runqueue_lock);
         spin_unlock(&pcpu->scheduler_lock);
         return;
     }
 
     if (prev->state == TASK_RUNNING)
-        prev->state = TASK_READY;
+        prev->state = TASK_READY; // Only the idle thread gets here
+
+    // Ticks only matter while something runs; an idle CPU sleeps until its next timer
+    timer_set_tick(next != pcpu->idle_thread);
+
+    // Set the CPU's notion of current thread. Both stay marked on_cpu, so nobody steals prev
+    // before its registers are saved.
+    pcpu->current_thread = next;
+    pcpu->prev_thread    = prev;
+    next->on_cpu         = 1;
+    next->state          = TASK_RUNNING;
+    spin_unlock(&pcpu->runqueue_lock);
 
     proc_t* next_proc = get_proc_from_thread(next);
 
@@ -355,71 +817,21 @@ void schedule_from_irq(registers_t* regs)
     // Update TSS.ESP0 so interrupts land on next kernel stack
     pcpu->tss.esp0 = (uint32_t)(next->kstack + next->kstack_size);
 
-    // Set the CPU's notion of current thread
-    pcpu->current_thread = next;
-
-    // Load general purpose regs for next thread
-    next->state = TASK_RUNNING;
+    // next reloads %gs when it returns to user mode, picking up its own TLS block
+    gdt_set_user_tls(pcpu, next->tls_base);
 
     // terminal_display_scheduler_info(next);
 
+    // prev may resume on another CPU, so the switch is finished against the CPU it wakes up on
     context_switch(&prev->context, next->context);
-    spin_unlock(&pcpu->scheduler_lock);
+    sched_switch_finish();
 }
 
-/* ---------------- Wait Queue (for blocking I/O) ---------------- */
-
-// // Block the current thread and add it to a wait queue
-// void block_current_thread(list_t* wait_queue)
-// {
-//     thread_t* current = PCPU_GET(current_thread);
-//     if (!current)
-//         return;
-//
-//     // Change state to blocked
-//     current->state = TASK_BLOCKED;
-//
-//     // Add to wait queue if provided
-//     if (wait_queue) {
-//         wait_node_t* wait_node = kmalloc(sizeof(wait_node_t));
-//         if (!wait_node)
-//             PANIC("block_current_thread: Out of memory");
-//         wait_node->thread = current;
-//         list_push_head(wait_queue, &wait_node->node);
-//     }
-//
-//     // Trigger a software interrupt to invoke the scheduler from interrupt context
-//     // This ensures proper context saving/restoration via schedule_from_irq()
-//     // Timer interrupt is on vector 64 (0x40)
-//     __asm__ __volatile__("int $0x40");
-// }
-//
-// // Wake up all threads in a wait queue
-// void wake_up_queue(list_t* wait_queue)
-// {
-//     if (!wait_queue || !wait_queue->head)
-//         return;
-//
-//     list_node_t* node = wait_queue->head;
-//     while (node) {
-//         wait_node_t* wait_node = WAIT_NODE_FROM_NODE(node);
-//         thread_t*    t         = wait_node->thread;
-//         if (t && t->state == TASK_BLOCKED) {
-//             t->state = TASK_READY;
-//         }
-//
-//         list_node_t* to_free = node;
-//         node                 = node->next;
-//         list_remove(to_free);
-//         kfree(wait_node);
-//     }
-// }
-
 /* ---------------- Debugging / Listing ---------------- */
 
 void list_tasks()
 {
-    printf("Process count: %u\n", next_pid - 1);
+    printf("Process count: %u\n", all_processes.size - 1);
     printf("CPU   PID   TID   PPID  STATE    NAME\n");
     printf("==========================================\n");
 
@@ -463,38 +875,39 @@ void list_pcpu_threads(pcpu_t* pcpu)
     printf("TID   PID   PPID  STATE    NAME\n");
     printf("====================================\n");
 
-    list_node_t* node = pcpu->runqueue.head;
-    if (!node) {
+    if (!pcpu->nr_running) {
         printf("<empty>\n");
         return;
     }
 
-    do {
-        thread_t*   t         = thread_from_runqueue_node(node);
-        proc_t*     p         = get_proc_from_thread(t);
-        const char* state_str = "UNKNOWN";
-        switch (t->state) {
-        case TASK_RUNNING:
-            state_str = " RUNNING";
-            break;
-        case TASK_READY:
-            state_str = "   READY";
-            break;
-        case TASK_BLOCKED:
-            state_str = " BLOCKED";
-            break;
-        case TASK_STOPPED:
-            state_str = " STOPPED";
-            break;
-        case TASK_SLEEPING:
-            state_str = "SLEEPING";
-            break;
-        case TASK_ZOMBIE:
-            state_str = "  ZOMBIE";
-            break;
+    list_node_t* node = NULL;
+    for (int prio = 0; prio < SCHED_PRIO_LEVELS; prio++) {
+        list_for_each(node, &pcpu->runqueues[prio])
+        {
+            thread_t*   t         = thread_from_runqueue_node(node);
+            proc_t*     p         = get_proc_from_thread(t);
+            const char* state_str = "UNKNOWN";
+            switch (t->state) {
+            case TASK_RUNNING:
+                state_str = " RUNNING";
+                break;
+            case TASK_READY:
+                state_str = "   READY";
+                break;
+            case TASK_BLOCKED:
+                state_str = " BLOCKED";
+                break;
+            case TASK_STOPPED:
+                state_str = " STOPPED";
+                break;
+            case TASK_SLEEPING:
+                state_str = "SLEEPING";
+                break;
+            case TASK_ZOMBIE:
+                state_str = "  ZOMBIE";
+                break;
+            }
+            printf("%5u %5u %5u %s %s\n", t->tid, p->pid, p->ppid, state_str, p->name);
         }
-        printf("%5u %5u %5u %s %s\n", t->tid, p->pid, p->ppid, state_str, p->name);
-
-        node = node->next;
-    } while (node && node != pcpu->runqueue.head);
+    }
 }
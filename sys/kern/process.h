@@ -4,7 +4,13 @@
 #include <machine/context.h>
 #include <machine/trapframe.h>
 
+#include <kern/rcu.h>
+#include <kern/spinlock.h>
+
+#include <sys/resource.h>
+
 #include <libkern/common.h>
+#include <libkern/hashtable.h>
 
 #include <inttypes.h>
 #include <list.h>
@@ -19,6 +25,20 @@ typedef enum {
 } task_state_t;
 
 struct process;
+struct pcpu;
+
+// Priority 0 is the most urgent. Every level has its own runqueue, and more urgent levels get
+// longer time slices (in timer ticks).
+#define SCHED_PRIO_LEVELS  32
+#define SCHED_PRIO_DEFAULT (SCHED_PRIO_LEVELS / 2)
+#define SCHED_PRIO_MIN     (SCHED_PRIO_LEVELS - 1)
+#define SCHED_SLICE(prio)  (1 + (SCHED_PRIO_MIN - (prio)) / 8)
+#define SCHED_TICK_US      10000 // Timer tick while a CPU is busy; idle CPUs take none
+
+// Load balancing, in timer ticks: how often a CPU pulls work from its busiest peer, and how
+// recently a thread must have run to count as cache-hot and stay put
+#define SCHED_BALANCE_INTERVAL 16
+#define SCHED_MIGRATION_COST   4
 
 typedef struct thread {
     list_node_t node;      // For linking threads in a list
@@ -29,20 +49,29 @@ typedef struct thread {
 
     uint32_t tid;      // Thread ID
     uint8_t  state;    // Thread state (e.g., running, ready, blocked)
-    uint8_t  priority; // Thread priority
+    uint8_t  priority; // Thread priority, 0 to SCHED_PRIO_MIN
+
+    struct pcpu*     pcpu;     // CPU whose runqueues the thread belongs to
+    uint32_t         last_ran; // The CPU's tick count when the thread was last switched out
+    volatile uint8_t on_cpu;   // Running, or still being switched away from; never migrated
 
-    void*    kstack;      // Kernel stack pointer
-    uint32_t kstack_size; // Kernel stack size
+    void*     kstack;      // Kernel stack pointer
+    uint32_t  kstack_size; // Kernel stack size
+    uintptr_t tls_base;    // Base of the user %gs segment, 0 if the thread has no TLS block
+
+    hashtable_entry_t id_entry; // Keyed by tid, for thread_find
+    rcu_head_t        rcu;      // Freed after a grace period, as mutex_spin reads on_cpu unlocked
 } thread_t;
 
 #define get_proc_from_thread(t)      container_of((t)->proc_node.list, proc_t, threads)
-#define get_pcpu_from_thread(t)      container_of((t)->node.list, pcpu_t, runqueue)
+#define get_pcpu_from_thread(t)      ((t)->pcpu)
 #define thread_from_proc_node(node)  container_of((node), thread_t, proc_node)
 #define thread_from_runqueue_node(n) container_of((n), thread_t, node)
 
 typedef struct vm_space vm_space_t;
 typedef struct list     list_t;
 typedef struct fd_table fd_table_t;
+typedef struct ioring   ioring_t;
 
 typedef struct process {
     list_node_t node;     // For linking processes in a list
@@ -53,7 +82,14 @@ typedef struct process {
     vm_space_t* vmspace;  // Memory management info
     fd_table_t* fd_table; // File descriptor table
 
-    list_t threads; // Linked list of threads in the process
+    spinlock_t lock;    // Guards threads
+    list_t     threads; // Linked list of threads in the process
+
+    rlimit_t rlimits[RLIM_NLIMITS]; // Resource limits
+
+    ioring_t* ioring; // Submission/completion rings, NULL until ioring_setup
+
+    hashtable_entry_t id_entry; // Keyed by pid, for proc_find
 } proc_t;
 
 #define get_proc_from_node(node) container_of((node), proc_t, node)
@@ -65,17 +101,24 @@ typedef struct wait_node {
 
 typedef struct pcpu pcpu_t;
 
-extern proc_t   idle_process;
-extern thread_t idle_thread;
+extern proc_t idle_process;
 
 thread_t* create_kernel_thread(void (*entry)(void), proc_t* p, uint32_t priority, pcpu_t* pcpu);
 thread_t* create_user_thread(void (*entry)(void), proc_t* p, uint32_t priority, pcpu_t* pcpu,
-                             void* user_stack_top);
+                             void* user_stack_top, uintptr_t tls_base);
 proc_t*   create_process(const char* name);
+proc_t*   proc_find(uint32_t pid);
+thread_t* thread_find(uint32_t tid);
 int       fork_process(thread_t* t, int flags, proc_t** child_out);
 void      yield();
 pcpu_t*   select_pcpu();
 void      schedule_from_irq(registers_t* regs);
+void      sched_tick(registers_t* regs);
+void      sched_wakeup(thread_t* t);
+void      sched_idle(void);
+thread_t* sched_idle_thread_init(pcpu_t* pcpu);
+void      sched_switch_finish(void);
+int       sched_reaper_init(void);
 void      thread_exit(registers_t* regs);
 void      list_tasks();
 void      list_pcpu_threads(pcpu_t* pcpu);
@@ -83,8 +126,4 @@ void      list_pcpu_threads(pcpu_t* pcpu);
 void free_thread(thread_t* t);
 void free_process(proc_t* proc);
 
-/* Wait queue for blocking operations */
-void block_current_thread(list_t* wait_queue);
-void wake_up_queue(list_t* wait_queue);
-
 #endif // TASK_H
@@ -0,0 +1,100 @@
+#include "rcu.h"
+#include "panic.h"
+#include "process.h"
+#include "spinlock.h"
+#include "wait_queue.h"
+
+#include <sys/pcpu.h>
+
+#include <kern/errno.h>
+
+#include <stddef.h>
+
+static rcu_head_t* volatile rcu_pending = NULL; // Callbacks queued for the next grace period
+static spinlock_t           rcu_lock    = SPINLOCK_INITIALIZER;
+static wait_queue_t         rcu_wq      = WAIT_QUEUE_INIT;
+
+// The nesting count is bumped through %fs in one instruction, so a reader cannot be moved to
+// another CPU between finding its pcpu_t and updating it
+void rcu_read_lock(void)
+{
+    asm volatile("incl %%fs:%c0" : : "i"(offsetof(pcpu_t, rcu_nesting)) : "memory");
+}
+
+void rcu_read_unlock(void)
+{
+    asm volatile("decl %%fs:%c0" : : "i"(offsetof(pcpu_t, rcu_nesting)) : "memory");
+}
+
+void _rcu_read_cleanup(int* once)
+{
+    rcu_read_unlock();
+}
+
+// Whether pcpu has passed a quiescent state since its count was snap. An idle CPU may not take
+// ticks at all, but the idle loop holds no references.
+static bool rcu_cpu_quiescent(pcpu_t* pcpu, uint32_t snap)
+{
+    volatile pcpu_t* p = pcpu;
+    return p->rcu_qs != snap || (p->current_thread == p->idle_thread && !p->rcu_nesting);
+}
+
+void synchronize_rcu(void)
+{
+    if (PCPU_GET(rcu_nesting))
+        PANIC("synchronize_rcu: Called inside an RCU read-side section");
+
+    uint32_t snap[MAX_CPUS];
+    for (uint32_t i = 0; i < cpu_count; i++)
+        snap[i] = ((volatile pcpu_t*)&pcpus[i])->rcu_qs;
+
+    // The calling CPU is outside any read section right now, which is its quiescent state
+    pcpu_t* self = get_pcpu();
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        if (&pcpus[i] == self)
+            continue;
+        while (!rcu_cpu_quiescent(&pcpus[i], snap[i]))
+            yield();
+    }
+}
+
+void call_rcu(rcu_head_t* head, rcu_callback_t func)
+{
+    head->func = func;
+    WITH_SPINLOCK_IRQSAVE(rcu_lock)
+    {
+        head->next  = rcu_pending;
+        rcu_pending = head;
+    }
+    wake_one(&rcu_wq);
+}
+
+// Takes the queued callbacks a batch at a time, and runs them once a grace period has passed
+static void rcu_thread(void)
+{
+    for (;;) {
+        wait_event(rcu_wq, rcu_pending != NULL);
+
+        rcu_head_t* head = NULL;
+        WITH_SPINLOCK_IRQSAVE(rcu_lock)
+        {
+            head        = rcu_pending;
+            rcu_pending = NULL;
+        }
+
+        synchronize_rcu();
+
+        while (head) {
+            rcu_head_t* next = head->next;
+            head->func(head);
+            head = next;
+        }
+    }
+}
+
+int rcu_init(void)
+{
+    if (!create_kernel_thread(rcu_thread, &idle_process, SCHED_PRIO_DEFAULT, NULL))
+        return -ENOMEM;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef KERN_RCU_H
+#define KERN_RCU_H
+
+#include <inttypes.h>
+
+/*
+ * Read-copy-update for read-mostly data. Readers walk the data inside rcu_read_lock and
+ * rcu_read_unlock and take no locks. Writers still serialise among themselves. They unlink an
+ * object with rcu_assign_pointer, then free it only after a grace period, once every reader that
+ * could have seen it has left its section.
+ *
+ * Read-side sections may nest and may be used from interrupt handlers, but must not sleep. The
+ * scheduler does not switch away from a thread inside one. Each context switch is then a quiescent
+ * state for its CPU, and a grace period ends once every CPU has passed through one or sat idle.
+ */
+
+typedef struct rcu_head rcu_head_t;
+typedef void (*rcu_callback_t)(rcu_head_t* head);
+
+struct rcu_head {
+    rcu_head_t*    next;
+    rcu_callback_t func;
+};
+
+// Loads an RCU-protected pointer once, for use inside a read-side section
+#define rcu_dereference(p) (*(__typeof__(p) volatile*)&(p))
+
+// Publishes a pointer to readers once everything it points to has been written
+#define rcu_assign_pointer(p, v)                                                                   \
+    do {                                                                                           \
+        asm volatile("" ::: "memory");                                                             \
+        *(__typeof__(p) volatile*)&(p) = (v);                                                      \
+    } while (0)
+
+#define WITH_RCU_READ_LOCK()                                                                       \
+    for (int _rcu_once __attribute__((cleanup(_rcu_read_cleanup))) = (rcu_read_lock(), 1);         \
+         _rcu_once; _rcu_once = 0)
+
+int  rcu_init(void);
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+void _rcu_read_cleanup(int* once);
+
+/* Waits for a full grace period. Must be called from thread context, outside any read section. */
+void synchronize_rcu(void);
+/* Runs func(head) from the RCU thread after a grace period. Never sleeps. */
+void call_rcu(rcu_head_t* head, rcu_callback_t func);
+
+#endif // KERN_RCU_H
@@ -1,76 +1,98 @@
 #include "rwlock.h"
 #include "process.h"
 
-// For now rwlock is implemented using a spinlock to edit its state. This is not optimal but it
-// works for now. In the future we can implement a more efficient rwlock using futexes or other
-// mechanisms.
-
-void rwlock_read_lock(rwlock_t* rw)
+// Adds delta to the state and returns the previous state
+static inline uint32_t rwlock_xadd(rwlock_t* rw, uint32_t delta)
 {
-    for (;;) {
-
-        spin_lock(&rw->interlock);
-
-        if (!rw->writer && rw->waiting_writers == 0) {
-            rw->readers++;
-            spin_unlock(&rw->interlock);
-            return;
-        }
-
-        rw->waiting_readers++;
+    asm volatile("lock xaddl %0, %1" : "+r"(delta), "+m"(rw->state) : : "memory");
+    return delta;
+}
 
-        spin_unlock(&rw->interlock);
+static inline bool rwlock_cmpxchg(rwlock_t* rw, uint32_t expected, uint32_t state)
+{
+    uint32_t prev;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(prev), "+m"(rw->state)
+                 : "r"(state), "a"(expected)
+                 : "memory");
+    return prev == expected;
+}
 
-        yield();
+// wait_event conditions run right after the waiter is queued. A releasing thread changes the state
+// first and looks at the queue second, so the queue store must be globally visible before the state
+// is loaded here, or each side could miss the other. The spin_unlock ending wait_prepare is a plain
+// store that may sit in the store buffer past later loads, hence the full barrier.
+static inline void rwlock_queued_barrier(void)
+{
+    asm volatile("mfence" ::: "memory");
+}
 
-        spin_lock(&rw->interlock);
-        rw->waiting_readers--;
-        spin_unlock(&rw->interlock);
+// wait_event condition for readers: enters unless a writer holds or waits for the lock
+static bool rwlock_read_tryacquire(rwlock_t* rw)
+{
+    rwlock_queued_barrier();
+    for (;;) {
+        uint32_t state = rw->state;
+        if (state & (RWLOCK_WRITER_ACTIVE | RWLOCK_WRITER_MASK))
+            return false;
+        if (rwlock_cmpxchg(rw, state, state + RWLOCK_READER_ONE))
+            return true;
     }
 }
 
-void rwlock_read_unlock(rwlock_t* rw)
+// wait_event condition for writers: takes the lock once it is free, and stops counting as waiting
+static bool rwlock_write_tryacquire(rwlock_t* rw)
 {
-    spin_lock(&rw->interlock);
+    rwlock_queued_barrier();
+    for (;;) {
+        uint32_t state = rw->state;
+        if (state & (RWLOCK_WRITER_ACTIVE | RWLOCK_READER_MASK))
+            return false;
+        if (rwlock_cmpxchg(rw, state, (state - RWLOCK_WRITER_ONE) | RWLOCK_WRITER_ACTIVE))
+            return true;
+    }
+}
 
-    rw->readers--;
+void rwlock_read_lock(rwlock_t* rw)
+{
+    uint32_t prev = rwlock_xadd(rw, RWLOCK_READER_ONE);
+    if (!(prev & (RWLOCK_WRITER_ACTIVE | RWLOCK_WRITER_MASK)))
+        return;
+
+    // A writer got there first. Back out, and as a waiting writer may have seen our count and gone
+    // to sleep, behave like any reader leaving the lock.
+    rwlock_read_unlock(rw);
+    wait_event(rw->read_queue, rwlock_read_tryacquire(rw));
+}
 
-    spin_unlock(&rw->interlock);
+void rwlock_read_unlock(rwlock_t* rw)
+{
+    uint32_t state = rwlock_xadd(rw, -RWLOCK_READER_ONE) - RWLOCK_READER_ONE;
+    if (!(state & (RWLOCK_READER_MASK | RWLOCK_WRITER_ACTIVE)) && (state & RWLOCK_WRITER_MASK))
+        wake_one(&rw->write_queue);
 }
 
 void rwlock_write_lock(rwlock_t* rw)
 {
-    for (;;) {
-
-        spin_lock(&rw->interlock);
-
-        if (!rw->writer && rw->readers == 0) {
+    if (rwlock_cmpxchg(rw, 0, RWLOCK_WRITER_ACTIVE))
+        return;
 
-            rw->writer = true;
-
-            spin_unlock(&rw->interlock);
-            return;
-        }
-
-        rw->waiting_writers++;
-
-        spin_unlock(&rw->interlock);
-
-        yield();
-
-        spin_lock(&rw->interlock);
-        rw->waiting_writers--;
-        spin_unlock(&rw->interlock);
-    }
+    rwlock_xadd(rw, RWLOCK_WRITER_ONE);
+    wait_event(rw->write_queue, rwlock_write_tryacquire(rw));
 }
 
 void rwlock_write_unlock(rwlock_t* rw)
 {
-    spin_lock(&rw->interlock);
-
-    rw->writer = false;
-
-    spin_unlock(&rw->interlock);
+    // The locked xadd is a full barrier: the cleared flag is visible before the queue is read
+    uint32_t state = rwlock_xadd(rw, -RWLOCK_WRITER_ACTIVE) - RWLOCK_WRITER_ACTIVE;
+
+    // Hand over to the next writer; readers only come in once no writer is left waiting. A reader
+    // queues itself, then fences, then checks the state, so one that is not seen on the queue here
+    // sees the cleared flag. The unlocked peek at the queue is therefore safe.
+    if (state & RWLOCK_WRITER_MASK)
+        wake_one(&rw->write_queue);
+    else if (*(list_node_t* volatile*)&rw->read_queue.waiters.head)
+        wake_all(&rw->read_queue);
 }
 
 void _rwlock_read_cleanup(rwlock_t** lock)
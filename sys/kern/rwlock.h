@@ -2,6 +2,7 @@
 #define RWLOCK_H
 
 #include "spinlock.h"
+#include "wait_queue.h"
 
 #include <inttypes.h>
 #include <stdbool.h>
@@ -10,6 +11,10 @@
  * 0-15:   Reader count
  * 16-30:  Writer waiting count
  * 31:     Writer active flag
+ *
+ * An uncontended reader takes the lock with a single xadd on the state word, and an uncontended
+ * writer with a single cmpxchg. Writers are preferred: readers do not enter while a writer is
+ * waiting, and a releasing writer hands the lock to the next writer before any reader.
  */
 
 #define RWLOCK_READER_MASK   0x0000FFFF
@@ -17,15 +22,14 @@
 #define RWLOCK_WRITER_ACTIVE 0x80000000
 
 #define RWLOCK_WRITER_SHIFT 16
+#define RWLOCK_READER_ONE   1
+#define RWLOCK_WRITER_ONE   (1U << RWLOCK_WRITER_SHIFT)
 
 typedef struct rwlock {
-    spinlock_t interlock;
+    volatile uint32_t state; // See the layout above
 
-    uint32_t readers;
-    uint32_t waiting_readers;
-    uint32_t waiting_writers;
-
-    bool writer;
+    wait_queue_t read_queue;  // Readers sleeping until no writer holds or waits for the lock
+    wait_queue_t write_queue; // Writers sleeping until the lock is free
 } rwlock_t;
 
 typedef void (*lock_func_t)(rwlock_t*);
@@ -33,8 +37,7 @@ typedef void (*lock_func_t)(rwlock_t*);
 #define RWLOCK_INITIALIZER                                                                         \
     (rwlock_t)                                                                                     \
     {                                                                                              \
-        .interlock = SPINLOCK_INITIALIZER, .readers = 0, .waiting_readers = 0,                     \
-        .waiting_writers = 0, .writer = false                                                      \
+        .state = 0, .read_queue = WAIT_QUEUE_INIT, .write_queue = WAIT_QUEUE_INIT                  \
     }
 
 #define WITH_READ_LOCK(lock)                                                                       \
@@ -1,22 +1,23 @@
 #include "spinlock.h"
 
+#include <machine/cpufunc.h>
+
+#define TICKET_ONE     0x10000U // Adds one to the next ticket, in the high half of the lock
+#define TICKET_SHIFT   16
+#define TICKET_SERVING 0xFFFFU
+
 /*
  * Acquire a spinlock
  */
 void spin_lock(spinlock_t* l)
 {
-    uint32_t expected;
+    uint32_t ticket = TICKET_ONE;
+    asm volatile("lock xaddl %0, %1" : "+r"(ticket), "+m"(*l) : : "memory");
 
-    for (;;) {
-        expected = 0;
-        asm volatile("lock cmpxchg %1, %2"
-                     : "=a"(expected)
-                     : "r"(1U), "m"(*l), "a"(expected)
-                     : "memory");
-        if (expected == 0)
-            return;            // acquired
+    ticket >>= TICKET_SHIFT;
+    while ((*l & TICKET_SERVING) != ticket)
         asm volatile("pause"); // reduce contention
-    }
+    asm volatile("" ::: "memory");
 }
 
 /*
@@ -24,8 +25,9 @@ void spin_lock(spinlock_t* l)
  */
 void spin_unlock(spinlock_t* l)
 {
-    asm volatile("" ::: "memory");
-    *l = 0;
+    // Only the holder writes the low half, so it needs no lock prefix; a locked xadd taking a
+    // ticket at the same time rewrites it with the value it read atomically
+    asm volatile("incw %0" : "+m"(*(volatile uint16_t*)l) : : "memory");
 }
 
 /*
@@ -34,12 +36,16 @@ void spin_unlock(spinlock_t* l)
  */
 int spin_trylock(spinlock_t* l)
 {
-    uint32_t expected = 0;
-    asm volatile("lock cmpxchg %1, %2"
-                 : "=a"(expected)
-                 : "r"(1U), "m"(*l), "a"(expected)
+    uint32_t expected = *l;
+    if ((expected & TICKET_SERVING) != expected >> TICKET_SHIFT)
+        return 1;
+
+    uint32_t prev;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(prev), "+m"(*l)
+                 : "r"(expected + TICKET_ONE), "a"(expected)
                  : "memory");
-    return expected; // 0 if acquired, non-zero if already held
+    return prev != expected; // 0 if acquired, non-zero if someone took a ticket first
 }
 
 inline void _spinlock_cleanup(spinlock_t** lock)
@@ -48,3 +54,88 @@ inline void _spinlock_cleanup(spinlock_t** lock)
         spin_unlock(*lock);
     }
 }
+
+uint32_t spin_lock_irqsave(spinlock_t* l)
+{
+    uint32_t eflags = intr_disable();
+    spin_lock(l);
+    return eflags;
+}
+
+void spin_unlock_irqrestore(spinlock_t* l, uint32_t eflags)
+{
+    spin_unlock(l);
+    intr_restore(eflags);
+}
+
+void _spinlock_irq_cleanup(spinlock_irq_guard_t* guard)
+{
+    spin_unlock_irqrestore(guard->lock, guard->eflags);
+}
+
+/* ---------------- MCS locks ---------------- */
+
+static inline mcs_node_t* mcs_xchg(mcs_lock_t* lock, mcs_node_t* node)
+{
+    asm volatile("xchgl %0, %1" : "+r"(node), "+m"(*lock) : : "memory");
+    return node;
+}
+
+static inline mcs_node_t* mcs_cmpxchg(mcs_lock_t* lock, mcs_node_t* expected, mcs_node_t* node)
+{
+    mcs_node_t* prev;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(prev), "+m"(*lock)
+                 : "r"(node), "a"(expected)
+                 : "memory");
+    return prev;
+}
+
+void mcs_lock(mcs_lock_t* lock, mcs_node_t* node)
+{
+    node->next   = NULL;
+    node->locked = 1;
+
+    mcs_node_t* prev = mcs_xchg(lock, node);
+    if (!prev)
+        return; // The queue was empty
+
+    prev->next = node;
+    while (node->locked)
+        asm volatile("pause");
+    asm volatile("" ::: "memory");
+}
+
+void mcs_unlock(mcs_lock_t* lock, mcs_node_t* node)
+{
+    if (!node->next) {
+        if (mcs_cmpxchg(lock, node, NULL) == node)
+            return; // Nobody queued up behind us
+
+        // A waiter swapped itself in as the tail but has not linked itself to us yet
+        while (!node->next)
+            asm volatile("pause");
+    }
+
+    asm volatile("" ::: "memory");
+    node->next->locked = 0;
+}
+
+/* Returns 0 on success, non-zero if the lock is held */
+int mcs_trylock(mcs_lock_t* lock, mcs_node_t* node)
+{
+    node->next   = NULL;
+    node->locked = 0;
+    return mcs_cmpxchg(lock, NULL, node) != NULL;
+}
+
+mcs_guard_t* _mcs_guard_lock(mcs_guard_t* guard)
+{
+    mcs_lock(guard->lock, &guard->node);
+    return guard;
+}
+
+void _mcs_cleanup(mcs_guard_t* guard)
+{
+    mcs_unlock(guard->lock, &guard->node);
+}
@@ -2,6 +2,15 @@
 #define SPINLOCK_H
 
 #include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * spinlock_t is a ticket lock: the high half holds the next ticket to hand out and the low half the
+ * ticket being served, so waiters get the lock in the order they arrived.
+ *
+ * The _irqsave variants also disable interrupts, and are needed for any lock an interrupt handler
+ * takes: a handler spinning on a lock held by the thread it interrupted never gets it.
+ */
 
 #define WITH_SPINLOCK(lock)                                                                        \
     for (spinlock_t * _spinlock_cleanup_var                                                        \
@@ -9,13 +18,61 @@
              *_spinlock_once                             = _spinlock_cleanup_var;                  \
          _spinlock_once; _spinlock_once                  = NULL)
 
+#define WITH_SPINLOCK_IRQSAVE(lock)                                                                \
+    for (spinlock_irq_guard_t _spinlock_irq_guard                                                  \
+         __attribute__((cleanup(_spinlock_irq_cleanup))) = {&(lock), spin_lock_irqsave(&(lock))},  \
+         *_spinlock_once                                 = &_spinlock_irq_guard;                   \
+         _spinlock_once; _spinlock_once                  = NULL)
+
 #define SPINLOCK_INITIALIZER 0
 
 typedef volatile uint32_t spinlock_t;
 
+typedef struct spinlock_irq_guard {
+    spinlock_t* lock;
+    uint32_t    eflags;
+} spinlock_irq_guard_t;
+
 void spin_lock(spinlock_t* l);
 void spin_unlock(spinlock_t* l);
 int  spin_trylock(spinlock_t* l);
 void _spinlock_cleanup(spinlock_t** lock);
 
+/* Disables interrupts, then takes the lock. Returns the EFLAGS to restore on unlock. */
+uint32_t spin_lock_irqsave(spinlock_t* l);
+void     spin_unlock_irqrestore(spinlock_t* l, uint32_t eflags);
+void     _spinlock_irq_cleanup(spinlock_irq_guard_t* guard);
+
+/*
+ * MCS queue lock, for heavily contended locks. Each waiter spins on its own node instead of the
+ * shared lock word, so a hand-off touches only the next waiter's cache line. The node lives on the
+ * locker's stack and must be passed to the matching unlock.
+ */
+
+#define WITH_MCS_LOCK(lock)                                                                        \
+    for (mcs_guard_t _mcs_guard __attribute__((cleanup(_mcs_cleanup))) = {&(lock), {NULL, 0}},     \
+                     *_mcs_once = _mcs_guard_lock(&_mcs_guard);                                    \
+         _mcs_once; _mcs_once = NULL)
+
+#define MCS_LOCK_INITIALIZER NULL
+
+typedef struct mcs_node {
+    struct mcs_node* volatile next;   // Waiter queued behind this one
+    volatile uint32_t         locked; // Set until the previous holder hands the lock over
+} mcs_node_t;
+
+typedef mcs_node_t* volatile mcs_lock_t; // Tail of the waiter queue, NULL while free
+
+typedef struct mcs_guard {
+    mcs_lock_t* lock;
+    mcs_node_t  node;
+} mcs_guard_t;
+
+void mcs_lock(mcs_lock_t* lock, mcs_node_t* node);
+void mcs_unlock(mcs_lock_t* lock, mcs_node_t* node);
+int  mcs_trylock(mcs_lock_t* lock, mcs_node_t* node);
+
+mcs_guard_t* _mcs_guard_lock(mcs_guard_t* guard);
+void         _mcs_cleanup(mcs_guard_t* guard);
+
 #endif // SPINLOCK_H
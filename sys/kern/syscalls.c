@@ -1,8 +1,13 @@
 #include "syscalls.h"
+#include "clock.h"
 #include "exec.h"
+#include "errno.h"
 #include "fd.h"
+#include "futex.h"
+#include "ioring.h"
 #include "process.h"
 #include "terminal.h"
+#include "timer.h"
 
 #include <dev/input/keyboard.h>
 
@@ -10,6 +15,7 @@
 #include <fs/vfs.h>
 
 #include <vm/kmalloc.h>
+#include <vm/layout.h>
 #include <vm/vm_map.h>
 
 #include <sys/pcpu.h>
@@ -33,11 +39,26 @@ void syscalls_init()
     g_syscalls[SYSCALL_READ]      = syscall_read;
     g_syscalls[SYSCALL_WRITE]     = syscall_write;
     g_syscalls[SYSCALL_GETDIRENT] = syscall_getdirent;
+    g_syscalls[SYSCALL_PREAD]     = syscall_pread;
+    g_syscalls[SYSCALL_PWRITE]    = syscall_pwrite;
+    g_syscalls[SYSCALL_READV]     = syscall_readv;
+    g_syscalls[SYSCALL_WRITEV]    = syscall_writev;
+
+    g_syscalls[SYSCALL_IORING_SETUP] = syscall_ioring_setup;
+    g_syscalls[SYSCALL_IORING_ENTER] = syscall_ioring_enter;
 
     // Process Syscalls
     g_syscalls[SYSCALL_FORK]   = syscall_fork;
     g_syscalls[SYSCALL_EXECVE] = syscall_execve;
     g_syscalls[SYSCALL_EXIT]   = syscall_exit;
+
+    g_syscalls[SYSCALL_THREAD_NEW] = syscall_thread_new;
+    g_syscalls[SYSCALL_FUTEX]      = syscall_futex;
+
+    g_syscalls[SYSCALL_GETRLIMIT] = syscall_getrlimit;
+    g_syscalls[SYSCALL_SETRLIMIT] = syscall_setrlimit;
+    g_syscalls[SYSCALL_NANOSLEEP]     = syscall_nanosleep;
+    g_syscalls[SYSCALL_CLOCK_GETTIME] = syscall_clock_gettime;
 }
 
 int syscall_exit(registers_t* regs)
@@ -139,6 +160,73 @@ int syscall_write(int fd, const void* buf, size_t count, SYSCALL2)
     return vfs_write(file, buf, count, 0);
 }
 
+// Positioned I/O leaves the shared file position alone, so threads can share a descriptor
+int syscall_pread(int fd, void* buf, size_t count, uint32_t offset, SYSCALL4)
+{
+    file_t* file = fd_get_file(get_proc_from_thread(PCPU_GET(current_thread)), fd);
+    if (!file)
+        return -EBADF;
+
+    return vfs_pread(file, buf, count, offset);
+}
+
+int syscall_pwrite(int fd, const void* buf, size_t count, uint32_t offset, SYSCALL4)
+{
+    file_t* file = fd_get_file(get_proc_from_thread(PCPU_GET(current_thread)), fd);
+    if (!file)
+        return -EBADF;
+
+    return vfs_pwrite(file, buf, count, offset);
+}
+
+// Copies the segment array in, so its lengths cannot change once vfs has checked them. Small
+// arrays go in the caller's buffer; the result must be freed if it is not fast.
+static iovec_t* iov_copyin(const struct iovec* uiov, int iovcnt, iovec_t* fast)
+{
+    if (iovcnt < 0 || iovcnt > IOV_MAX || !uiov)
+        return ERR_PTR(-EINVAL);
+
+    iovec_t* iov = iovcnt <= UIO_FASTIOV ? fast : kmalloc(iovcnt * sizeof(iovec_t));
+    if (!iov)
+        return ERR_PTR(-ENOMEM);
+    memcpy(iov, uiov, iovcnt * sizeof(iovec_t));
+    return iov;
+}
+
+int syscall_readv(int fd, const struct iovec* uiov, int iovcnt, SYSCALL3)
+{
+    file_t* file = fd_get_file(get_proc_from_thread(PCPU_GET(current_thread)), fd);
+    if (!file)
+        return -EBADF;
+
+    iovec_t  fast[UIO_FASTIOV];
+    iovec_t* iov = iov_copyin(uiov, iovcnt, fast);
+    if (IS_ERR(iov))
+        return (int)iov;
+
+    int res = vfs_readv(file, iov, iovcnt);
+    if (iov != fast)
+        kfree(iov);
+    return res;
+}
+
+int syscall_writev(int fd, const struct iovec* uiov, int iovcnt, SYSCALL3)
+{
+    file_t* file = fd_get_file(get_proc_from_thread(PCPU_GET(current_thread)), fd);
+    if (!file)
+        return -EBADF;
+
+    iovec_t  fast[UIO_FASTIOV];
+    iovec_t* iov = iov_copyin(uiov, iovcnt, fast);
+    if (IS_ERR(iov))
+        return (int)iov;
+
+    int res = vfs_writev(file, iov, iovcnt);
+    if (iov != fast)
+        kfree(iov);
+    return res;
+}
+
 int syscall_getdirent(int fd, char* buf, size_t count, int offset, SYSCALL2)
 {
     if (!buf)
@@ -157,6 +245,21 @@ int syscall_getdirent(int fd, char* buf, size_t count, int offset, SYSCALL2)
     return vfs_getdirent(file, buf, count, offset);
 }
 
+// Returns the user address of the new ring, or -errno
+int syscall_ioring_setup(uint32_t entries, uint32_t flags, SYSCALL2)
+{
+    uintptr_t addr;
+    int       res = ioring_setup(entries, flags, &addr);
+    if (res)
+        return res;
+    return (int)addr;
+}
+
+int syscall_ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags, SYSCALL3)
+{
+    return ioring_enter(to_submit, min_complete, flags);
+}
+
 /* ================
    SOCKET SYSCALLS
    ================ */
@@ -363,6 +466,87 @@ int syscall_fork(SYSCALL1)
     return child->pid; // Return child's PID to parent, 0 to child
 }
 
+// Starts a thread in the caller's process, sharing its address space and file descriptors. It
+// begins at entry on the given user stack, with %gs based at tls_base. Returns the new TID.
+int syscall_thread_new(uintptr_t entry, uintptr_t stack_top, uintptr_t tls_base, SYSCALL2)
+{
+    if (!entry || entry >= USER_SPACE_START + USER_SPACE_SIZE)
+        return -EINVAL;
+    if (!stack_top || stack_top > USER_SPACE_START + USER_SPACE_SIZE)
+        return -EINVAL;
+    if (tls_base >= USER_SPACE_START + USER_SPACE_SIZE)
+        return -EINVAL;
+
+    thread_t* self = PCPU_GET(current_thread);
+    thread_t* t    = create_user_thread((void (*)(void))entry, get_proc_from_thread(self),
+                                        self->priority, NULL, (void*)stack_top, tls_base);
+    if (!t)
+        return -ENOMEM;
+    return t->tid;
+}
+
+int syscall_futex(uint32_t* uaddr, int op, uint32_t val, uint32_t* uaddr2, uint32_t val2)
+{
+    switch (op) {
+    case FUTEX_WAIT:
+        return futex_wait(uaddr, val);
+    case FUTEX_WAKE:
+        return futex_wake(uaddr, (int)val);
+    case FUTEX_REQUEUE:
+        return futex_requeue(uaddr, (int)val, uaddr2, (int)val2);
+    default:
+        return -EINVAL;
+    }
+}
+
+int syscall_getrlimit(int resource, struct rlimit* rlp, SYSCALL2)
+{
+    if (resource < 0 || resource >= RLIM_NLIMITS || !rlp)
+        return -EINVAL;
+
+    proc_t* proc = get_proc_from_thread(PCPU_GET(current_thread));
+    *rlp         = proc->rlimits[resource];
+    return 0;
+}
+
+int syscall_setrlimit(int resource, const struct rlimit* rlp, SYSCALL2)
+{
+    if (resource < 0 || resource >= RLIM_NLIMITS || !rlp)
+        return -EINVAL;
+
+    proc_t*  proc = get_proc_from_thread(PCPU_GET(current_thread));
+    rlimit_t new  = *rlp;
+
+    // Limits can only be tightened; there is no privileged user to raise a hard limit
+    if (new.rlim_cur > new.rlim_max || new.rlim_max > proc->rlimits[resource].rlim_max)
+        return -EINVAL;
+
+    // A smaller RLIMIT_STACK takes effect for the stack reserved by the next execve
+    proc->rlimits[resource] = new;
+    return 0;
+}
+
+int syscall_nanosleep(const struct timespec* rqtp, struct timespec* rmtp, SYSCALL2)
+{
+    if (!rqtp || rqtp->tv_sec < 0 || rqtp->tv_nsec < 0 || rqtp->tv_nsec >= NSEC_PER_SEC)
+        return -EINVAL;
+
+    // Rounded up, a sleep never ends early
+    uint64_t us = (uint64_t)rqtp->tv_sec * USEC_PER_SEC +
+                  (uint32_t)(rqtp->tv_nsec + NSEC_PER_USEC - 1) / NSEC_PER_USEC;
+    timer_sleep_us(us);
+
+    // Nothing interrupts a sleep yet, so none of it is ever left over
+    if (rmtp)
+        *rmtp = (struct timespec){0};
+    return 0;
+}
+
+int syscall_clock_gettime(clockid_t clock_id, struct timespec* tp, SYSCALL2)
+{
+    return clock_gettime(clock_id, tp);
+}
+
 int syscall_execve(const char* path, char* const argv[], char* const envp[], SYSCALL2)
 {
     if (!path)
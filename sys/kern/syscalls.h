@@ -3,6 +3,10 @@
 
 #include <libkern/common.h>
 
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
 #include <inttypes.h>
 #include <stddef.h>
 
@@ -73,6 +77,8 @@
 
 #define SYSCALL_FSYNC 95
 
+#define SYSCALL_READV  120
+#define SYSCALL_WRITEV 121
 #define SYSCALL_FCHOWN 123
 #define SYSCALL_FCHMOD 124
 
@@ -89,13 +95,25 @@
 
 #define SYSCALL_PATHCONF  191
 #define SYSCALL_FPATHCONF 192
+#define SYSCALL_GETRLIMIT 194
+#define SYSCALL_SETRLIMIT 195
+
+#define SYSCALL_CLOCK_GETTIME 232
+#define SYSCALL_NANOSLEEP     240
 
 #define SYSCALL_GETDIRENT 554
 
 #define SYSCALL_PRINT 100
 
+#define SYSCALL_IORING_SETUP 425
+#define SYSCALL_IORING_ENTER 426
+
+#define SYSCALL_FUTEX      454
 #define SYSCALL_THREAD_NEW 455
 
+#define SYSCALL_PREAD  475
+#define SYSCALL_PWRITE 476
+
 // Macro to define syscall function prototypes so that syscalls using < 5 args can be defined easily
 #define SYSCALL1 uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5
 #define SYSCALL2 uint32_t arg3, uint32_t arg4, uint32_t arg5
@@ -118,7 +136,13 @@ int syscall_open(const char* path, int flags, uint32_t mode, SYSCALL2);
 int syscall_close(int fd, SYSCALL1);
 int syscall_read(int fd, void* buf, size_t count, SYSCALL2);
 int syscall_write(int fd, const void* buf, size_t count, SYSCALL2);
+int syscall_pread(int fd, void* buf, size_t count, uint32_t offset, SYSCALL4);
+int syscall_pwrite(int fd, const void* buf, size_t count, uint32_t offset, SYSCALL4);
+int syscall_readv(int fd, const struct iovec* iov, int iovcnt, SYSCALL3);
+int syscall_writev(int fd, const struct iovec* iov, int iovcnt, SYSCALL3);
 int syscall_getdirent(int fd, char* buf, size_t count, int offset, SYSCALL2);
+int syscall_ioring_setup(uint32_t entries, uint32_t flags, SYSCALL2);
+int syscall_ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags, SYSCALL3);
 
 /* Socket syscalls */
 int syscall_socket(int type, SYSCALL1);
@@ -134,6 +158,12 @@ void* syscall_mmap(uintptr_t addr, size_t length, int prot, int flags, SYSCALL1)
 
 /* Process syscalls */
 int syscall_fork(SYSCALL1);
+int syscall_thread_new(uintptr_t entry, uintptr_t stack_top, uintptr_t tls_base, SYSCALL2);
+int syscall_futex(uint32_t* uaddr, int op, uint32_t val, uint32_t* uaddr2, uint32_t val2);
+int syscall_getrlimit(int resource, struct rlimit* rlp, SYSCALL2);
+int syscall_setrlimit(int resource, const struct rlimit* rlp, SYSCALL2);
+int syscall_nanosleep(const struct timespec* rqtp, struct timespec* rmtp, SYSCALL2);
+int syscall_clock_gettime(clockid_t clock_id, struct timespec* tp, SYSCALL2);
 
 /* Exec syscall */
 int syscall_execve(const char* path, char* const argv[], char* const envp[], SYSCALL2);
@@ -1,5 +1,7 @@
 #include "system_init.h"
+#include "clock.h"
 #include "elf.h"
+#include "exec.h"
 #include "panic.h"
 #include "process.h"
 
@@ -17,11 +19,11 @@ void system_init()
     if (!proc)
         PANIC("Failed to create init process!");
 
-    vaddr_t load_addr       = 0x1000000;
-    vaddr_t user_stack_addr = 0xC0000000 - PAGE_SIZE; // Start just below 3GB and grow downwards
+    vaddr_t load_addr = 0x1000000;
 
     thread_t* thread =
-        create_user_thread((void*)load_addr, proc, 0, get_pcpu(), user_stack_addr + PAGE_SIZE);
+        create_user_thread((void*)load_addr, proc, SCHED_PRIO_DEFAULT, get_pcpu(),
+                           (void*)USER_STACK_TOP, 0);
     if (!thread)
         PANIC("Failed to create init process task!");
 
@@ -31,7 +33,9 @@ void system_init()
                 VM_REG_F_EARLYENTER, VM_MAP_F_FIXED);
     memcpy((void*)load_addr, (void*)load_init, 0x1000);
 
-    // Create a thread user stack region
-    vm_map_anon(proc->vmspace, &user_stack_addr, PAGE_SIZE,
-                VM_PROT_READ | VM_PROT_WRITE | VM_PROT_USER, 0, VM_MAP_F_FIXED);
+    // Create a thread user stack region (grows down on demand)
+    if (exec_map_stack(proc))
+        PANIC("Failed to map the init process stack!");
+    if (clock_map_time_page(proc->vmspace))
+        PANIC("Failed to map the time page into the init process!");
 }
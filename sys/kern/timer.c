@@ -0,0 +1,362 @@
+#include "timer.h"
+#include "lapic.h"
+#include "panic.h"
+#include "process.h"
+#include "spinlock.h"
+#include "terminal.h"
+
+#include <sys/pcpu.h>
+#include <sys/time.h>
+
+#include <machine/cpufunc.h>
+
+// Each level has WHEEL_SIZE slots, every slot of level n spanning WHEEL_SIZE^n jiffies of 1024us.
+// Four levels cover about 4.7 hours; later timers park in the top level and cascade back in.
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define JIFFY_SHIFT  10
+
+#define LEVEL_SHIFT(level) ((level) * WHEEL_BITS)
+#define WHEEL_SPAN         (1ULL << LEVEL_SHIFT(WHEEL_LEVELS))
+
+#define TIMER_NEVER ((uint64_t)-1)
+
+// Longest one-shot; a CPU with nothing to do still wakes this often to keep its clock going
+#define TIMER_MAX_ONESHOT_US (60 * USEC_PER_SEC)
+
+typedef struct timer_base {
+    spinlock_t lock;
+    uint64_t   clk; // Next jiffy to process
+    list_t     wheel[WHEEL_LEVELS][WHEEL_SIZE];
+    uint32_t   pending[WHEEL_LEVELS]; // Timers queued on each level
+    uint64_t   tick_next;             // Next scheduler tick, 0 while ticks are off
+    uint64_t   deadline;              // What the one-shot is armed for
+
+    // The clock is kept by adding up the LAPIC ticks counted down between reprograms
+    uint64_t clock_us;
+    uint32_t clock_frac; // Remainder in ticks * 1000, below one microsecond
+    uint32_t armed;      // Count loaded at the last reprogram
+    bool     started;
+} timer_base_t;
+
+static timer_base_t timer_bases[MAX_CPUS];
+static uint32_t     lapic_ticks_per_ms;
+static uint64_t     oneshot_max_us;
+
+#define this_timer_base() (&timer_bases[get_pcpu() - pcpus])
+
+/* ---------------- Clock ---------------- */
+
+// Ticks counted down since the last reprogram. The count stops at 0 once the one-shot fires.
+static uint32_t timer_elapsed(timer_base_t* base)
+{
+    return base->armed - lapic_timer_current();
+}
+
+static uint64_t timer_clock(timer_base_t* base)
+{
+    uint64_t elapsed = (uint64_t)timer_elapsed(base) * 1000 + base->clock_frac;
+    return base->clock_us + udiv64_32(elapsed, lapic_ticks_per_ms, NULL);
+}
+
+uint64_t timer_now(void)
+{
+    if (!lapic_ticks_per_ms)
+        return 0;
+
+    uint32_t eflags = intr_disable();
+    uint64_t now    = timer_clock(this_timer_base());
+    intr_restore(eflags);
+    return now;
+}
+
+/* ---------------- Wheel ---------------- */
+
+static void wheel_insert(timer_base_t* base, ktimer_t* timer)
+{
+    uint64_t jiffy = timer->expires >> JIFFY_SHIFT;
+    if (jiffy < base->clk)
+        jiffy = base->clk;
+    if (jiffy - base->clk >= WHEEL_SPAN)
+        jiffy = base->clk + WHEEL_SPAN - 1;
+
+    uint64_t delta = jiffy - base->clk;
+    uint8_t  level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >> LEVEL_SHIFT(level + 1))
+        level++;
+
+    list_push_tail(&base->wheel[level][(jiffy >> LEVEL_SHIFT(level)) & WHEEL_MASK], &timer->node);
+    base->pending[level]++;
+    timer->level = level;
+    timer->base  = base;
+}
+
+static void wheel_remove(timer_base_t* base, ktimer_t* timer)
+{
+    list_remove(&timer->node);
+    base->pending[timer->level]--;
+    timer->base = NULL;
+}
+
+// Re-sorts the upper level slots whose turn comes at base->clk into the levels below
+static void wheel_cascade(timer_base_t* base)
+{
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if (base->clk & ((1ULL << LEVEL_SHIFT(level)) - 1))
+            break;
+
+        list_t*      slot = &base->wheel[level][(base->clk >> LEVEL_SHIFT(level)) & WHEEL_MASK];
+        list_node_t* node;
+        while ((node = list_pop_head(slot))) {
+            ktimer_t* timer = container_of(node, ktimer_t, node);
+            base->pending[level]--;
+            wheel_insert(base, timer);
+        }
+    }
+}
+
+// Moves every timer due by now onto expired. The jiffy now falls in is processed but not passed,
+// as the rest of its slot expires later within it.
+static void wheel_advance(timer_base_t* base, uint64_t now, list_t* expired)
+{
+    uint64_t target = now >> JIFFY_SHIFT;
+
+    while (base->clk <= target) {
+        wheel_cascade(base);
+
+        list_t*      slot = &base->wheel[0][base->clk & WHEEL_MASK];
+        list_node_t* node = slot->head;
+        while (node && slot->size) {
+            list_node_t* next  = node->next;
+            ktimer_t*    timer = container_of(node, ktimer_t, node);
+            if (timer->expires <= now) {
+                wheel_remove(base, timer);
+                list_push_tail(expired, &timer->node);
+            }
+            node = next;
+        }
+
+        if (base->clk == target)
+            break;
+
+        // With level 0 empty, nothing happens before the next cascade
+        if (!base->pending[0] && (base->clk | WHEEL_MASK) < target)
+            base->clk = (base->clk | WHEEL_MASK) + 1;
+        else
+            base->clk++;
+    }
+}
+
+// The earliest time anything on this CPU needs the timer interrupt
+static uint64_t timer_next_event(timer_base_t* base)
+{
+    uint64_t next = base->tick_next ? base->tick_next : TIMER_NEVER;
+
+    // Level 0 holds the exact expiries of the next WHEEL_SIZE jiffies
+    for (uint32_t i = 0; base->pending[0] && i < WHEEL_SIZE; i++) {
+        list_t* slot = &base->wheel[0][(base->clk + i) & WHEEL_MASK];
+        if (!slot->size)
+            continue;
+
+        list_node_t* node;
+        list_for_each(node, slot)
+        {
+            ktimer_t* timer = container_of(node, ktimer_t, node);
+            if (timer->expires < next)
+                next = timer->expires;
+        }
+        break;
+    }
+
+    // The upper levels only need the interrupt when their next occupied slot cascades down
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if (!base->pending[level])
+            continue;
+
+        uint32_t shift = LEVEL_SHIFT(level);
+        for (uint32_t i = 0; i <= WHEEL_SIZE; i++) {
+            uint64_t jiffy = ((base->clk >> shift) + i) << shift;
+            if (jiffy < base->clk || !base->wheel[level][(jiffy >> shift) & WHEEL_MASK].size)
+                continue;
+            if (jiffy << JIFFY_SHIFT < next)
+                next = jiffy << JIFFY_SHIFT;
+            break;
+        }
+    }
+
+    return next;
+}
+
+// Folds the ticks counted since the last reprogram into the clock and arms the one-shot for the
+// next event. Called with the base lock held and interrupts disabled.
+static void timer_reprogram(timer_base_t* base)
+{
+    uint64_t elapsed = (uint64_t)timer_elapsed(base) * 1000 + base->clock_frac;
+    base->clock_us += udiv64_32(elapsed, lapic_ticks_per_ms, &base->clock_frac);
+
+    uint64_t next  = timer_next_event(base);
+    uint64_t delta = next > base->clock_us ? next - base->clock_us : 1;
+    if (delta > oneshot_max_us)
+        delta = oneshot_max_us;
+
+    uint32_t ticks = udiv64_32(delta * lapic_ticks_per_ms, 1000, NULL);
+    base->armed    = ticks ? ticks : 1;
+    base->deadline = base->clock_us + delta;
+    lapic_timer_oneshot(base->armed);
+}
+
+/* ---------------- Interface ---------------- */
+
+// Calibrates the LAPIC timer on first use and starts this CPU's wheel
+void timer_init(void)
+{
+    if (!lapic_ticks_per_ms) {
+        lapic_ticks_per_ms = lapic_timer_calibrate();
+        if (lapic_ticks_per_ms <= 1000) // Too slow to be real, and the conversions would overflow
+            PANIC("LAPIC timer calibration failed");
+
+        oneshot_max_us = udiv64_32(0xFFFFFFFFULL * 1000, lapic_ticks_per_ms, NULL);
+        if (oneshot_max_us > TIMER_MAX_ONESHOT_US)
+            oneshot_max_us = TIMER_MAX_ONESHOT_US;
+        printf("LAPIC timer: %u ticks/ms\n", lapic_ticks_per_ms);
+    }
+
+    uint32_t      eflags = intr_disable();
+    timer_base_t* base   = this_timer_base();
+
+    base->lock = SPINLOCK_INITIALIZER;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int i = 0; i < WHEEL_SIZE; i++)
+            list_init(&base->wheel[level][i], 0);
+        base->pending[level] = 0;
+    }
+    base->clock_us   = timer_bases[0].clock_us; // Secondary CPUs start from the boot CPU's clock
+    base->clock_frac = 0;
+    base->clk        = base->clock_us >> JIFFY_SHIFT;
+    base->tick_next  = 0;
+    base->armed      = 0;
+    base->started    = true;
+
+    spin_lock(&base->lock);
+    timer_reprogram(base);
+    spin_unlock(&base->lock);
+    intr_restore(eflags);
+}
+
+// Runs the expired timers from the LAPIC timer interrupt. Returns whether a scheduler tick is due.
+bool timer_interrupt(void)
+{
+    timer_base_t* base    = this_timer_base();
+    list_t        expired = LIST_INIT;
+    bool          tick    = false;
+
+    spin_lock(&base->lock);
+    uint64_t now = timer_clock(base);
+    wheel_advance(base, now, &expired);
+    if (base->tick_next && now >= base->tick_next) {
+        tick = true;
+        base->tick_next += SCHED_TICK_US;
+        if (base->tick_next <= now)
+            base->tick_next = now + SCHED_TICK_US; // Ticks that were missed are not made up
+    }
+    spin_unlock(&base->lock);
+
+    // Callbacks run unlocked so they can add timers. A timer is not touched once its callback ran,
+    // as the callback may have freed it.
+    list_node_t* node;
+    while ((node = list_pop_head(&expired))) {
+        ktimer_t*  timer = container_of(node, ktimer_t, node);
+        timer_fn_t func  = timer->func;
+        func(timer->arg);
+    }
+
+    spin_lock(&base->lock);
+    timer_reprogram(base);
+    spin_unlock(&base->lock);
+    return tick;
+}
+
+// Turns this CPU's periodic scheduler tick on or off. Called by the scheduler, interrupts disabled.
+void timer_set_tick(bool enable)
+{
+    timer_base_t* base = this_timer_base();
+    if (!base->started || enable == (base->tick_next != 0))
+        return;
+
+    spin_lock(&base->lock);
+    if (enable) {
+        base->tick_next = timer_clock(base) + SCHED_TICK_US;
+        if (base->tick_next < base->deadline)
+            timer_reprogram(base);
+    }
+    else {
+        base->tick_next = 0; // The next interrupt just does not re-arm it
+    }
+    spin_unlock(&base->lock);
+}
+
+void ktimer_init(ktimer_t* timer, timer_fn_t func, void* arg)
+{
+    timer->node  = (list_node_t){0};
+    timer->func  = func;
+    timer->arg   = arg;
+    timer->base  = NULL;
+    timer->level = 0;
+}
+
+// Queues timer on this CPU to run func at expires, re-queueing it if it was pending
+void ktimer_add(ktimer_t* timer, uint64_t expires)
+{
+    ktimer_cancel(timer);
+
+    uint32_t      eflags = intr_disable();
+    timer_base_t* base   = this_timer_base();
+
+    spin_lock(&base->lock);
+    timer->expires = expires;
+    wheel_insert(base, timer);
+    if (expires < base->deadline)
+        timer_reprogram(base);
+    spin_unlock(&base->lock);
+    intr_restore(eflags);
+}
+
+// Dequeues a pending timer. Returns false if it was not pending, it may then be running already.
+bool ktimer_cancel(ktimer_t* timer)
+{
+    timer_base_t* base = timer->base;
+    if (!base)
+        return false;
+
+    bool     pending = false;
+    uint32_t eflags  = spin_lock_irqsave(&base->lock);
+    if (timer->base == base) {
+        wheel_remove(base, timer);
+        pending = true;
+    }
+    spin_unlock_irqrestore(&base->lock, eflags);
+    return pending;
+}
+
+static void timer_wake_thread(void* arg)
+{
+    sched_wakeup((thread_t*)arg);
+}
+
+// Blocks the current thread for at least us microseconds
+void timer_sleep_us(uint64_t us)
+{
+    thread_t* self = PCPU_GET(current_thread);
+    ktimer_t  timer;
+    ktimer_init(&timer, timer_wake_thread, self);
+
+    // As with wait_event, the state is set before the timer can fire, so the wakeup is never lost
+    uint32_t eflags = intr_disable();
+    self->state     = TASK_SLEEPING;
+    ktimer_add(&timer, timer_now() + us);
+    while (self->state == TASK_SLEEPING)
+        yield();
+    intr_restore(eflags);
+}
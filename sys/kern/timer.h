@@ -0,0 +1,38 @@
+#ifndef KERN_TIMER_H
+#define KERN_TIMER_H
+
+#include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+
+/*
+ * Kernel timers live on a per-CPU hierarchical timer wheel. The LAPIC timer runs one-shot to the
+ * earliest expiry, or to the next scheduler tick while the CPU is busy, so a quiet CPU takes no
+ * interrupts. Times are microseconds since boot.
+ */
+
+typedef void (*timer_fn_t)(void* arg);
+
+struct timer_base;
+
+typedef struct ktimer {
+    list_node_t        node;    // Wheel slot link
+    uint64_t           expires; // Absolute expiry
+    timer_fn_t         func;    // Runs from the timer interrupt, with interrupts disabled
+    void*              arg;
+    struct timer_base* base;  // Wheel the timer is queued on, NULL when not pending
+    uint8_t            level; // Wheel level of the slot holding it
+} ktimer_t;
+
+void     timer_init(void);
+uint64_t timer_now(void);
+bool     timer_interrupt(void);
+void     timer_set_tick(bool enable);
+
+void ktimer_init(ktimer_t* timer, timer_fn_t func, void* arg);
+void ktimer_add(ktimer_t* timer, uint64_t expires);
+bool ktimer_cancel(ktimer_t* timer);
+
+void timer_sleep_us(uint64_t us);
+
+#endif // KERN_TIMER_H
@@ -0,0 +1,71 @@
+#include "wait_queue.h"
+
+#include <sys/pcpu.h>
+
+// The queue lock is also taken from interrupt handlers, so it is only ever held with interrupts
+// disabled. Wakeups happen under it, which orders wq->lock before the scheduler lock.
+
+void wait_queue_init(wait_queue_t* wq)
+{
+    wq->lock = SPINLOCK_INITIALIZER;
+    list_init(&wq->waiters, 0);
+}
+
+void wait_prepare(wait_queue_t* wq, wait_node_t* wait)
+{
+    thread_t* self   = PCPU_GET(current_thread);
+    uint32_t  eflags = spin_lock_irqsave(&wq->lock);
+
+    if (!wait->node.list) {
+        wait->thread = self;
+        list_push_tail(&wq->waiters, &wait->node);
+    }
+    self->state = TASK_BLOCKED;
+
+    spin_unlock_irqrestore(&wq->lock, eflags);
+}
+
+void wait_finish(wait_queue_t* wq, wait_node_t* wait)
+{
+    uint32_t eflags = spin_lock_irqsave(&wq->lock);
+
+    if (wait->node.list)
+        list_remove(&wait->node);
+    PCPU_GET(current_thread)->state = TASK_RUNNING;
+
+    spin_unlock_irqrestore(&wq->lock, eflags);
+}
+
+thread_t* wake_one_locked(wait_queue_t* wq)
+{
+    list_node_t* node = list_pop_head(&wq->waiters);
+    if (!node)
+        return NULL;
+
+    thread_t* thread = container_of(node, wait_node_t, node)->thread;
+    sched_wakeup(thread);
+    return thread;
+}
+
+// Wakes up to nr waiters, or all of them if nr is negative
+static int wake(wait_queue_t* wq, int nr)
+{
+    int      woken  = 0;
+    uint32_t eflags = spin_lock_irqsave(&wq->lock);
+
+    while ((nr < 0 || woken < nr) && wake_one_locked(wq))
+        woken++;
+
+    spin_unlock_irqrestore(&wq->lock, eflags);
+    return woken;
+}
+
+int wake_one(wait_queue_t* wq)
+{
+    return wake(wq, 1);
+}
+
+int wake_all(wait_queue_t* wq)
+{
+    return wake(wq, -1);
+}
@@ -0,0 +1,59 @@
+#ifndef KERN_WAIT_QUEUE_H
+#define KERN_WAIT_QUEUE_H
+
+#include "process.h"
+#include "spinlock.h"
+
+#include <machine/cpufunc.h>
+
+#include <list.h>
+
+/*
+ * Threads waiting for a condition sleep on a wait queue, off every runqueue, until whoever makes
+ * the condition true calls wake_one or wake_all. Waiters always recheck their condition, so
+ * spurious wakeups are harmless.
+ */
+typedef struct wait_queue {
+    spinlock_t lock;
+    list_t     waiters; // wait_node_t, oldest first
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT                                                                            \
+    {                                                                                              \
+        .lock = SPINLOCK_INITIALIZER, .waiters = LIST_INIT                                         \
+    }
+
+/*
+ * Sleeps on wq until cond is true. cond is checked after the thread is queued, so a wakeup that
+ * races with the check is never lost. Interrupts are enabled between checks, so cond may depend on
+ * an interrupt handler even when the waiter is the only runnable thread.
+ */
+#define wait_event(wq, cond)                                                                       \
+    do {                                                                                           \
+        wait_node_t _wait = {.thread = NULL};                                                      \
+        for (;;) {                                                                                 \
+            uint32_t _eflags = intr_disable();                                                     \
+            wait_prepare(&(wq), &_wait);                                                           \
+            if (cond) {                                                                            \
+                intr_restore(_eflags);                                                             \
+                break;                                                                             \
+            }                                                                                      \
+            yield();                                                                               \
+            intr_restore(_eflags);                                                                 \
+        }                                                                                          \
+        wait_finish(&(wq), &_wait);                                                                \
+    } while (0)
+
+void wait_queue_init(wait_queue_t* wq);
+/* Queues the current thread on wq, if it is not already, and marks it blocked */
+void wait_prepare(wait_queue_t* wq, wait_node_t* wait);
+/* Dequeues the current thread if no waker did, and marks it running again */
+void wait_finish(wait_queue_t* wq, wait_node_t* wait);
+
+/* Wake the oldest waiter, or every waiter; both return how many threads were woken */
+int wake_one(wait_queue_t* wq);
+int wake_all(wait_queue_t* wq);
+/* Wakes the oldest waiter with wq->lock already held. Returns it, or NULL if the queue was empty. */
+thread_t* wake_one_locked(wait_queue_t* wq);
+
+#endif // KERN_WAIT_QUEUE_H
@@ -33,7 +33,7 @@ int hashtable_destroy(hashtable_t* ht, void (*free_entry)(void*))
     for (size_t i = 0; i < ht->bucket_count; i++) {
         list_node_t* node;
         while ((node = list_pop_head(&ht->buckets[i])) != NULL) {
-            hashtable_entry_t* entry = (hashtable_entry_t*)node;
+            hashtable_entry_t* entry = container_of(node, hashtable_entry_t, node);
             if (free_entry)
                 free_entry(entry);
         }
@@ -52,7 +52,7 @@ int hashtable_get(hashtable_t* ht, uint64_t key, hashtable_entry_t** result)
     size_t       index = key % ht->bucket_count;
     list_node_t* node  = ht->buckets[index].head;
     while (node) {
-        hashtable_entry_t* entry = (hashtable_entry_t*)node;
+        hashtable_entry_t* entry = container_of(node, hashtable_entry_t, node);
         if (entry->key == key) {
             *result = entry;
             return 0; // Success
@@ -84,7 +84,7 @@ int hashtable_remove(hashtable_t* ht, uint64_t key, void (*free_entry)(void*))
     size_t       index = key % ht->bucket_count;
     list_node_t* node  = ht->buckets[index].head;
     while (node) {
-        hashtable_entry_t* entry = (hashtable_entry_t*)node;
+        hashtable_entry_t* entry = container_of(node, hashtable_entry_t, node);
         if (entry->key == key) {
             list_remove(node);
             if (free_entry)
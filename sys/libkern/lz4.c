@@ -0,0 +1,173 @@
+#include "lz4.h"
+#include <kern/errno.h>
+#include <string.h>
+
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5  // The block always ends with at least this many literals
+#define LZ4_MF_LIMIT      12 // No match may start within this many bytes of the end
+#define LZ4_MAX_OFFSET    0xFFFF
+
+static inline uint32_t lz4_read32(const uint8_t* p)
+{
+    uint32_t v;
+    __builtin_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// Writes the part of a length that did not fit in its token nibble
+static inline uint8_t* lz4_put_length(uint8_t* op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Emits one sequence: literals from anchor, then (if match_len) a match at offset
+static uint8_t* lz4_put_sequence(uint8_t* op, uint8_t* oend, const uint8_t* anchor, size_t lit_len,
+                                 uint16_t offset, size_t match_len)
+{
+    // Worst case: token, literal length bytes, literals, offset, match length bytes
+    size_t worst = 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1;
+    if (worst > (size_t)(oend - op))
+        return NULL;
+
+    uint8_t* token = op++;
+    *token         = (lit_len >= 15 ? 15 : lit_len) << 4;
+    if (lit_len >= 15)
+        op = lz4_put_length(op, lit_len - 15);
+
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    if (!match_len)
+        return op;
+
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+
+    match_len -= LZ4_MIN_MATCH;
+    *token |= match_len >= 15 ? 15 : match_len;
+    if (match_len >= 15)
+        op = lz4_put_length(op, match_len - 15);
+
+    return op;
+}
+
+size_t lz4_compress(const void* src, size_t len, void* dst, size_t capacity, void* work)
+{
+    if (len > LZ4_MAX_INPUT)
+        return 0;
+
+    const uint8_t* base   = src;
+    const uint8_t* ip     = base;
+    const uint8_t* anchor = base;
+    const uint8_t* end    = base + len;
+    uint8_t*       op     = dst;
+    uint8_t*       oend   = op + capacity;
+    uint16_t*      table  = work;
+
+    memset(table, 0, LZ4_WORK_SIZE);
+
+    if (len > LZ4_MF_LIMIT) {
+        const uint8_t* mflimit     = end - LZ4_MF_LIMIT;
+        const uint8_t* match_limit = end - LZ4_LAST_LITERALS;
+
+        while (ip < mflimit) {
+            uint32_t       seq = lz4_read32(ip);
+            uint32_t       h   = lz4_hash(seq);
+            const uint8_t* ref = base + table[h];
+            table[h]           = ip - base;
+
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || lz4_read32(ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            const uint8_t* mp = ip + LZ4_MIN_MATCH;
+            const uint8_t* rp = ref + LZ4_MIN_MATCH;
+            while (mp < match_limit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+
+            op = lz4_put_sequence(op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+            if (!op)
+                return 0;
+
+            ip     = mp;
+            anchor = ip;
+        }
+    }
+
+    op = lz4_put_sequence(op, oend, anchor, end - anchor, 0, 0);
+    if (!op)
+        return 0;
+
+    return op - (uint8_t*)dst;
+}
+
+// Reads the extra bytes of a length whose token nibble was saturated
+static inline const uint8_t* lz4_get_length(const uint8_t* ip, const uint8_t* iend, size_t* len)
+{
+    uint8_t b;
+    do {
+        if (ip >= iend)
+            return NULL;
+        b = *ip++;
+        *len += b;
+    } while (b == 255);
+    return ip;
+}
+
+int lz4_decompress(const void* src, size_t len, void* dst, size_t capacity)
+{
+    const uint8_t* ip   = src;
+    const uint8_t* iend = ip + len;
+    uint8_t*       op   = dst;
+    uint8_t*       oend = op + capacity;
+
+    while (ip < iend) {
+        uint8_t token   = *ip++;
+        size_t  lit_len = token >> 4;
+        if (lit_len == 15 && !(ip = lz4_get_length(ip, iend, &lit_len)))
+            return -EINVAL;
+
+        if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op))
+            return -EINVAL;
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+
+        if (ip == iend)
+            break; // The last sequence has no match
+
+        if (iend - ip < 2)
+            return -EINVAL;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (uint8_t*)dst))
+            return -EINVAL;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !(ip = lz4_get_length(ip, iend, &match_len)))
+            return -EINVAL;
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t)(oend - op))
+            return -EINVAL;
+
+        // Byte by byte, as the match may overlap the bytes it produces
+        const uint8_t* match = op - offset;
+        while (match_len--)
+            *op++ = *match++;
+    }
+
+    return op - (uint8_t*)dst;
+}
@@ -0,0 +1,24 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * Compressor and decompressor for the LZ4 block format: a byte-oriented LZ77
+ * variant that trades ratio for speed. Match offsets are 16 bits, so inputs
+ * are limited to 64KB.
+ *
+ * The compressor needs LZ4_WORK_SIZE bytes of scratch space from the caller,
+ * as it is too large for a kernel stack.
+ */
+#define LZ4_HASH_BITS 12
+#define LZ4_WORK_SIZE ((1 << LZ4_HASH_BITS) * sizeof(uint16_t))
+#define LZ4_MAX_INPUT 0xFFFF
+
+/* Returns the compressed size, or 0 if the result would not fit in capacity bytes */
+size_t lz4_compress(const void* src, size_t len, void* dst, size_t capacity, void* work);
+/* Returns the decompressed size, or -EINVAL if src is malformed or does not fit in capacity */
+int    lz4_decompress(const void* src, size_t len, void* dst, size_t capacity);
+
+#endif // LZ4_H
@@ -157,3 +157,32 @@ int radix_tree_remove(radix_tree_t* tree, unsigned long key, void** removed_valu
     }
     return 0;
 }
+
+static int radix_node_walk(radix_tree_t* tree, radix_node_t* node, int level, unsigned long key,
+                           radix_walk_fn_t fn, void* ctx)
+{
+    for (size_t i = 0; i < (1UL << tree->chunk_bits); i++) {
+        void* child = node->children[i];
+        if (!child)
+            continue;
+
+        // Level 0 holds the lowest chunk of the key, so each level fills in the next chunk up
+        unsigned long child_key = key | ((unsigned long)i << (level * tree->chunk_bits));
+
+        int res = level == tree->height - 1
+                      ? fn(child_key, child, ctx)
+                      : radix_node_walk(tree, (radix_node_t*)child, level + 1, child_key, fn, ctx);
+        if (res)
+            return res;
+    }
+    return 0;
+}
+
+int radix_tree_walk(radix_tree_t* tree, radix_walk_fn_t fn, void* ctx)
+{
+    if (!tree || !fn)
+        return -EINVAL;
+    if (!tree->root)
+        return 0;
+    return radix_node_walk(tree, tree->root, 0, 0, fn, ctx);
+}
@@ -39,4 +39,12 @@ int   radix_tree_insert(radix_tree_t* tree, unsigned long key, void* value);
 void* radix_tree_lookup(radix_tree_t* tree, unsigned long key);
 int   radix_tree_remove(radix_tree_t* tree, unsigned long key, void** removed_value);
 
+/*
+ * Calls fn(key, value, ctx) for every entry in the tree. The walk stops early
+ * and returns fn's result as soon as fn returns non-zero. fn must not insert
+ * into or remove from the tree.
+ */
+typedef int (*radix_walk_fn_t)(unsigned long key, void* value, void* ctx);
+int radix_tree_walk(radix_tree_t* tree, radix_walk_fn_t fn, void* ctx);
+
 #endif // RADIX_H
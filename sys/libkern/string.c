@@ -323,3 +323,16 @@ void memcpy(void* dest, const void* src, unsigned len)
         *d++ = *s++;
     }
 }
+
+int memcmp(const void* a, const void* b, unsigned len)
+{
+    const unsigned char* x = a;
+    const unsigned char* y = b;
+    while (len--) {
+        if (*x != *y)
+            return *x - *y;
+        x++;
+        y++;
+    }
+    return 0;
+}
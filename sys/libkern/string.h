@@ -55,5 +55,7 @@ const char* strrchr(const char* s, int c);
 void memset(void* dest, char val, unsigned len);
 // Copy a block of memory
 void memcpy(void* dest, const void* src, unsigned len);
+// Compare two blocks of memory
+int memcmp(const void* a, const void* b, unsigned len);
 
 #endif // STRING_H
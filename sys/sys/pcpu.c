@@ -12,10 +12,21 @@ int pcpu_init(MACHDEP_PARAMS)
 {
     pcpu_t* pcpu = &pcpus[cpu_count++];
     pcpu->self   = pcpu;
-    list_init(&pcpu->runqueue, 1);
-    list_push_tail(&pcpu->runqueue, &idle_thread.node);
-    pcpu->current_thread = &idle_thread;
-    pcpu->total_priority = 0;
+    for (int i = 0; i < SCHED_PRIO_LEVELS; i++)
+        list_init(&pcpu->runqueues[i], 0);
+    list_init(&pcpu->zombies, 0);
+    pcpu->runqueue_lock   = SPINLOCK_INITIALIZER;
+    pcpu->runqueue_bitmap = 0;
+    pcpu->nr_running      = 0;
+    pcpu->slice_ticks     = 0;
+    pcpu->ticks           = 0;
+    pcpu->balance_ticks   = SCHED_BALANCE_INTERVAL;
+    pcpu->rcu_nesting     = 0;
+    pcpu->rcu_qs          = 0;
+    pcpu->idle_thread     = sched_idle_thread_init(pcpu);
+    pcpu->current_thread  = pcpu->idle_thread;
+    pcpu->prev_thread     = NULL;
+    pcpu->total_priority  = 0;
     pcpu->started        = 0;
     pcpu->vmspace        = &kernel_vm_space;
     machdep_init_pcpu(pcpu, MACHDEP_ARGUMENTS);
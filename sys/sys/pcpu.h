@@ -15,9 +15,22 @@ typedef struct pcpu {
     pcpu_t*     self;           /* Pointer to self for easy access from assembly */
     spinlock_t  scheduler_lock; /* Spinlock for synchronizing access to the scheduler */
     uint32_t    pc_cpu_id;      /* CPU identifier */
-    list_t      runqueue;       /* Runqueue of threads for this CPU */
+
+    spinlock_t runqueue_lock;                /* Runqueues, current_thread and the load counters */
+    list_t     runqueues[SCHED_PRIO_LEVELS]; /* READY threads, one FIFO per priority */
+    uint32_t   runqueue_bitmap;              /* Bit n is set while runqueues[n] is non-empty */
+    uint32_t   nr_running;                   /* Threads in the runqueues */
+    list_t     zombies;                      /* Exited threads waiting to be freed */
+    uint32_t   slice_ticks;                  /* Timer ticks left in the current thread's slice */
+    uint32_t   ticks;                        /* Timer ticks seen by this CPU */
+    uint32_t   balance_ticks;                /* Timer ticks until the next rebalance */
+    uint32_t   rcu_nesting;                  /* Depth of RCU read-side sections, see kern/rcu.h */
+    uint32_t   rcu_qs;                       /* Quiescent states passed, bumped on every switch */
+
+    thread_t*   idle_thread;    /* Runs while the runqueues are empty, see sched_idle */
     thread_t*   current_thread; /* Currently running thread on this CPU */
-    uint32_t    total_priority; /* Total priority of all threads in runqueue */
+    thread_t*   prev_thread;    /* Thread being switched away from, see sched_switch_finish */
+    uint32_t    total_priority; /* Total time slice of all threads assigned to this CPU */
     uint8_t     started;        /* Has this CPU been started? */
     vm_space_t* vmspace;        /* The kernel VM space, shared across all CPUs */
     PCPU_MD_FIELDS
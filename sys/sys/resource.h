@@ -20,4 +20,22 @@ typedef struct resource {
     void* mapped_addr; // For MMIO resources, this will point to the mapped address
 } resource_t;
 
+/* Per-process resource limits (numbering follows the BSD RLIMIT_* constants) */
+#define RLIMIT_CPU   0 // CPU time in seconds
+#define RLIMIT_FSIZE 1 // Maximum file size
+#define RLIMIT_DATA  2 // Data segment size
+#define RLIMIT_STACK 3 // Stack size
+#define RLIM_NLIMITS 4
+
+#define RLIM_INFINITY ((rlim_t)-1)
+
+#define RLIMIT_STACK_DEFAULT (8 * 1024 * 1024)
+
+typedef uint32_t rlim_t;
+
+typedef struct rlimit {
+    rlim_t rlim_cur; // Current (soft) limit
+    rlim_t rlim_max; // Maximum value for rlim_cur
+} rlimit_t;
+
 #endif // SYS_RESOURCE_H
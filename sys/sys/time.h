@@ -0,0 +1,38 @@
+#ifndef SYS_TIME_H
+#define SYS_TIME_H
+
+#include <inttypes.h>
+
+#define NSEC_PER_USEC 1000
+#define USEC_PER_SEC  1000000
+#define NSEC_PER_SEC  1000000000
+
+typedef int32_t time_t;
+
+typedef struct timespec {
+    time_t  tv_sec;  // Seconds
+    int32_t tv_nsec; // Nanoseconds, below NSEC_PER_SEC
+} timespec_t;
+
+typedef int32_t clockid_t;
+
+#define CLOCK_MONOTONIC 4
+
+#define TIME_PAGE_F_TSC      0x1 // The TSC fields are valid, otherwise fall back to clock_gettime
+#define TIME_PAGE_F_SYSENTER 0x2 // SYSENTER is set up, otherwise syscalls must use int $0x80
+
+/*
+ * Mapped read-only at USER_TIME_PAGE in every process, so time can be read without a syscall:
+ * ns = ns_base + ((rdtsc() - tsc_base) * mult >> shift). Readers retry while seq is odd or changes
+ * under them.
+ */
+typedef struct time_page {
+    volatile uint32_t seq;
+    uint32_t          flags;
+    uint32_t          mult;
+    uint32_t          shift;
+    uint64_t          tsc_base;
+    uint64_t          ns_base;
+} time_page_t;
+
+#endif // SYS_TIME_H
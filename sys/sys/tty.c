@@ -304,6 +304,7 @@ int tty_attach(device_t* dev)
     tty->output      = tty_none_output; // default to no output device
     memset(&tty->termios, 0, sizeof(termios_t));
     memset(&tty->winsize, 0, sizeof(winsize_t));
+    wait_queue_init(&tty->read_queue);
 
     // Set default termios settings (e.g. 9600 baud, 8N1)
     tty->termios.c_iflag      = ICRNL | IXON;
@@ -364,6 +365,9 @@ void tty_input(tty_t* tty, char c, uint8_t flags)
         return;
     // SPINLOCK REQUIRED
     tty->tty_ops->rx_char(tty, c, flags);
+
+    // Readers recheck whether their line or VMIN characters are complete
+    wake_all(&tty->read_queue);
 }
 
 /* =========================================================================
@@ -392,6 +396,19 @@ int tty_close(device_t* dev)
     return 0;
 }
 
+// Whether in_ring holds at least one complete line, or an EOF marker
+static bool tty_line_ready(tty_t* tty)
+{
+    // SPINLOCK REQUIRED
+    size_t avail = tty_ring_len(&tty->in_ring);
+    for (size_t i = 0; i < avail; i++) {
+        uint8_t c = ring_peek(&tty->in_ring, i);
+        if (c == 0xFF || c == '\n')
+            return true;
+    }
+    return false;
+}
+
 int tty_read(device_t* dev, uint64_t offset, uint32_t size, uint8_t* buf)
 {
     if (!dev)
@@ -409,23 +426,7 @@ int tty_read(device_t* dev, uint64_t offset, uint32_t size, uint8_t* buf)
     size_t   bytes_read = 0;
 
     if (tty->termios.c_lflag & ICANON) {
-        for (;;) {
-            // SPINLOCK REQUIRED
-            size_t avail    = tty_ring_len(&tty->in_ring);
-            int    complete = 0;
-            for (size_t i = 0; i < avail; i++) {
-                uint8_t c = ring_peek(&tty->in_ring, i);
-                if (c == 0xFF || c == '\n') {
-                    complete = 1;
-                    break;
-                }
-            }
-
-            if (complete)
-                break; // at least one complete line available
-
-            yield(); // wait for more input
-        }
+        wait_event(tty->read_queue, tty_line_ready(tty)); // wait for a complete line
 
         // Read up to the first complete line
         // SPINLOCK REQUIRED
@@ -444,9 +445,7 @@ int tty_read(device_t* dev, uint64_t offset, uint32_t size, uint8_t* buf)
         uint8_t vmin = tty->termios.c_cc[VMIN];
         if (vmin == 0)
             vmin = 1;
-        while (tty_ring_len(&tty->in_ring) < vmin) {
-            yield(); // wait for more input
-        }
+        wait_event(tty->read_queue, tty_ring_len(&tty->in_ring) >= vmin);
 
         // SPINLOCK REQUIRED
         while (bytes_read < size && !tty_ring_empty(&tty->in_ring)) {
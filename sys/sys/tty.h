@@ -5,6 +5,8 @@
 
 #include "termios.h"
 
+#include <kern/wait_queue.h>
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -114,6 +116,8 @@ typedef struct tty {
 
     size_t in_line_len; /* length of current line being input (for canonical mode) */
 
+    wait_queue_t read_queue; /* readers sleeping until in_ring has enough input */
+
     /* --- State --- */
     termios_t termios;
     winsize_t winsize;
@@ -0,0 +1,15 @@
+#ifndef SYS_UIO_H
+#define SYS_UIO_H
+
+#include <stddef.h>
+
+#define IOV_MAX     1024 // Most segments one readv or writev may take
+#define UIO_FASTIOV 8    // Segment arrays up to this size are copied onto the kernel stack
+
+/* One segment of a scatter/gather transfer */
+typedef struct iovec {
+    void*  iov_base;
+    size_t iov_len;
+} iovec_t;
+
+#endif // SYS_UIO_H
@@ -1,5 +1,7 @@
 #include "kmalloc.h"
+#include "vm_shrinker.h"
 
+#include <kern/lockstat.h>
 #include <kern/spinlock.h>
 #include <kern/terminal.h>
 
@@ -10,7 +12,11 @@
 #define KMALLOC_STATE_USED 0x22
 
 static struct kmalloc_unit* head         = 0;
-static spinlock_t           kmalloc_lock = 0;
+static mcs_lock_t           kmalloc_lock = MCS_LOCK_INITIALIZER;
+static size_t               kmalloc_size = 0; // Whole heap, headers included
+static size_t               kmalloc_used = 0; // Bytes in used units, headers included
+
+LOCK_CLASS(kmalloc_lock_class, "kmalloc");
 
 int kmalloc_init(char* heap_start, size_t heap_size)
 {
@@ -19,6 +25,9 @@ int kmalloc_init(char* heap_start, size_t heap_size)
     head->size  = heap_size;
     head->next  = 0;
     head->prev  = 0;
+
+    kmalloc_size = heap_size;
+    kmalloc_used = 0;
     return 0;
 }
 
@@ -34,6 +43,9 @@ static void ksplit(kmalloc_unit_t* u, size_t size)
     n->next  = u->next;
     n->prev  = u;
 
+    if (u->state == KMALLOC_STATE_USED)
+        kmalloc_used -= n->size;
+
     if (u->next)
         u->next->prev = n;
 
@@ -41,6 +53,13 @@ static void ksplit(kmalloc_unit_t* u, size_t size)
     u->next = n;
 }
 
+static void kmark_used(kmalloc_unit_t* u)
+{
+    if (u->state != KMALLOC_STATE_USED)
+        kmalloc_used += u->size;
+    u->state = KMALLOC_STATE_USED;
+}
+
 static void kmerge(kmalloc_unit_t* u)
 {
     if (!u || u->state != KMALLOC_STATE_FREE)
@@ -79,27 +98,38 @@ static void* kmalloc_unsafe(size_t size)
     }
 
     ksplit(u, needed);
-    u->state = KMALLOC_STATE_USED;
+    kmark_used(u);
 
     return (void*)(u + 1);
 }
 
+// Called with kmalloc_lock released, as waking the reclaim thread may take scheduler locks
+static void kmalloc_check_watermark()
+{
+    if (kmalloc_size - kmalloc_used < kmalloc_size / KMALLOC_WATERMARK_DIV)
+        vm_reclaim_wake();
+}
+
 void* kmalloc(size_t size)
 {
-    spin_lock(&kmalloc_lock);
+    mcs_node_t node;
+    mcs_lock_class(&kmalloc_lock, &node, kmalloc_lock_class);
     void* ptr = kmalloc_unsafe(size);
-    spin_unlock(&kmalloc_lock);
+    mcs_unlock(&kmalloc_lock, &node);
+    kmalloc_check_watermark();
     return ptr;
 }
 
 void* kmalloc_aligned(size_t size, size_t alignment)
 {
-    spin_lock(&kmalloc_lock);
+    mcs_node_t node;
+    mcs_lock_class(&kmalloc_lock, &node, kmalloc_lock_class);
     size_t extra   = alignment + KUNIT;
     void*  raw_ptr = kmalloc_unsafe(size + extra);
 
     if (!raw_ptr) {
-        spin_unlock(&kmalloc_lock);
+        mcs_unlock(&kmalloc_lock, &node);
+        kmalloc_check_watermark();
         return 0;
     }
 
@@ -107,7 +137,8 @@ void* kmalloc_aligned(size_t size, size_t alignment)
     uintptr_t aligned_addr = (raw_addr + extra - 1) & ~(alignment - 1);
 
     if (aligned_addr == raw_addr) {
-        spin_unlock(&kmalloc_lock);
+        mcs_unlock(&kmalloc_lock, &node);
+        kmalloc_check_watermark();
         return raw_ptr;
     }
 
@@ -120,11 +151,12 @@ void* kmalloc_aligned(size_t size, size_t alignment)
     }
 
     ksplit(u, size + KUNIT);
-    u->state = KMALLOC_STATE_USED;
+    kmark_used(u);
 
     void* ptr = (void*)(u + 1);
 
-    spin_unlock(&kmalloc_lock);
+    mcs_unlock(&kmalloc_lock, &node);
+    kmalloc_check_watermark();
     return ptr;
 }
 
@@ -133,21 +165,29 @@ void kfree(void* ptr)
     if (!ptr)
         return;
 
-    spin_lock(&kmalloc_lock);
-
     kmalloc_unit_t* u = (kmalloc_unit_t*)ptr - 1;
 
-    if (u->state == KMALLOC_STATE_USED) {
-        u->state = KMALLOC_STATE_FREE;
-        kmerge(u);
+    WITH_MCS_LOCK_CLASS(kmalloc_lock, kmalloc_lock_class)
+    {
+        if (u->state == KMALLOC_STATE_USED) {
+            kmalloc_used -= u->size;
+            u->state = KMALLOC_STATE_FREE;
+            kmerge(u);
+        }
     }
+}
 
-    spin_unlock(&kmalloc_lock);
+size_t kmalloc_reclaim_target()
+{
+    size_t free = kmalloc_size - kmalloc_used;
+    size_t low  = kmalloc_size / KMALLOC_WATERMARK_DIV;
+    return free < low ? 2 * low - free : 0;
 }
 
 void memory_usage()
 {
-    spin_lock(&kmalloc_lock);
+    mcs_node_t node;
+    mcs_lock_class(&kmalloc_lock, &node, kmalloc_lock_class);
     kmalloc_unit_t* u          = head;
     uint32_t        total_free = 0, total_used = 0;
     int             i = 0;
@@ -162,5 +202,5 @@ void memory_usage()
         i++;
     }
     printf("Total used: %u bytes, Total free: %u bytes\n", total_used, total_free);
-    spin_unlock(&kmalloc_lock);
+    mcs_unlock(&kmalloc_lock, &node);
 }
\ No newline at end of file
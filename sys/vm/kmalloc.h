@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <string.h>
 
+#define KMALLOC_WATERMARK_DIV 8 // Low watermark of free heap bytes as a fraction of the heap
+
 #define KMALLOC(var, type, size) type* var __attribute__((cleanup(kfreep))) = kmalloc(size);
 
 #define KMALLOC_RET(var, type, size, ret)                                                          \
@@ -28,8 +30,10 @@ void* kmalloc(size_t size);
 void* kmalloc_aligned(size_t size, size_t alignment);
 void  kfree(void* ptr);
 
-int  kmalloc_init(char* heap_start, size_t heap_size);
-void memory_usage(void);
+int    kmalloc_init(char* heap_start, size_t heap_size);
+/* Bytes to free to get back to twice the low watermark, or 0 while above it */
+size_t kmalloc_reclaim_target(void);
+void   memory_usage(void);
 
 static inline void kfreep(void* ptr)
 {
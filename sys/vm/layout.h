@@ -13,11 +13,22 @@
 
 #define KERNEL_BASE   0xC0000000
 #define DEVICE_BASE   0xF0000000
-#define ADDRESS_LIMIT 0xFFBFF000
+#define ADDRESS_LIMIT 0xFF800000
 
 #define USER_SPACE_START 0x00000000
 #define USER_SPACE_SIZE  0xC0000000
 
+#define USER_STACK_TOP (USER_SPACE_START + USER_SPACE_SIZE)
+#define USER_STACK_MAX 0x04000000 // Largest span a user stack may reserve (64MB)
+
+// Read-only clock page (see kern/clock.c), just below the stack reservation and its guard page
+#define USER_TIME_PAGE (USER_STACK_TOP - USER_STACK_MAX - 0x2000)
+
+// Kernel thread stacks and their guard pages (see vm/vm_kstack.c). Kept within one page table,
+// which is created at boot so every address space shares it.
+#define KSTACK_AREA_START 0xEFC00000
+#define KSTACK_AREA_SIZE  0x00400000
+
 #define KMALLOC_START 0xC0200000
 #define KMALLOC_SIZE  0x00200000
 
@@ -25,8 +36,9 @@
 
 #define LAPIC_BASE 0xFEE00000U // typical xAPIC base (physical)
 
-#define PAGE_TABLE_EDIT_ADDRESS 0xFFBFF000
-#define PAGE_TABLES_ADDRESS     0xFFC00000
+#define PAGE_TABLES_ALT_ADDRESS    0xFF800000
+#define PAGE_TABLES_ADDRESS        0xFFC00000
+#define PAGE_DIRECTORY_ALT_ADDRESS 0xFFFFE000
 
 #define PAGE_TABLE_KERNEL_ADDRESS 0xFFC00000 + 0x1000 * 768
 #define PAGE_DIRECTORY_ADDRESS    0xFFFFF000
@@ -49,6 +49,7 @@ typedef enum vm_region_flags {
     VM_REG_F_KERNEL     = 0x20, // Map in kernel space (ignored for user regions)
     VM_REG_F_NOCACHE    = 0x40, // Don't allow caching of this region
     VM_REG_F_EARLYENTER = 0x80,
+    VM_REG_F_WC         = 0x100, // Write-combining, for framebuffers (falls back to uncached)
 } vm_region_flags_t;
 
 typedef enum vm_obj_flags {
@@ -1,6 +1,7 @@
 #include "vm_fault.h"
 #include "types.h"
 #include "vm_map.h"
+#include "vm_merge.h"
 #include "vm_page.h"
 #include "vm_pager.h"
 #include "vm_region.h"
@@ -17,6 +18,8 @@ int vm_fault(vm_space_t* space, uintptr_t addr, vm_prot_t fault_type)
     vm_region_t* region;
 
     region = vm_region_lookup(space, addr, rwlock_read_lock);
+    if (!region)
+        region = vm_region_grow_stack(space, addr, rwlock_read_lock);
 
     if (!region) {
         vm_space_debug(space);
@@ -37,10 +40,11 @@ int vm_fault(vm_space_t* space, uintptr_t addr, vm_prot_t fault_type)
     uintptr_t page_addr = addr & ~(PAGE_SIZE - 1);
     size_t    offset    = (page_addr - region->base) + region->offset;
 
-    vm_object_t* obj = region->object;
-    vm_page_t*   page;
-    vm_page_t*   new_page;
-    uintptr_t    shadow_addr;
+    vm_object_t*      obj = region->object;
+    vm_page_t*        page;
+    vm_page_t*        new_page;
+    uintptr_t         shadow_addr;
+    vm_merge_frame_t* merged = NULL;
 
     // If the page is already present but read-only, we need to check for copy-on-write (COW)
     // conditions.
@@ -66,9 +70,9 @@ int vm_fault(vm_space_t* space, uintptr_t addr, vm_prot_t fault_type)
 
     // Page not found in any object, allocate a new page
     new_page = vm_page_allocate(region->object, offset);
-    if (!new_page) {
+    if (IS_ERR(new_page)) {
         rwlock_read_unlock(&region->lock);
-        return -ENOMEM;
+        return (int)new_page;
     }
 
     pmap_enter(space->arch, page_addr, new_page->phys_addr, region->prot, 0);
@@ -99,10 +103,31 @@ found_page:
     return 0;
 
 cow:
-    new_page = vm_page_allocate(region->object, offset);
-    if (!new_page) {
-        rwlock_read_unlock(&region->lock);
-        return -ENOMEM;
+    // A merged page already belongs to this object, it only needs a private frame again
+    page = vm_page_lookup(region->object, offset);
+    if (page && (page->state & VM_PAGE_FLAG_MERGED)) {
+        merged = vm_merge_unshare(page);
+        if (IS_ERR(merged)) {
+            rwlock_read_unlock(&region->lock);
+            return (int)merged;
+        }
+
+        if (!merged) {
+            // It was the last page using the frame, which is now private again
+            pmap_enter(space->arch, page_addr, page->phys_addr, region->prot, 0);
+            rwlock_read_unlock(&region->lock);
+            return 0;
+        }
+
+        shadow_addr = merged->phys;
+        new_page    = page;
+    }
+    else {
+        new_page = vm_page_allocate(region->object, offset);
+        if (IS_ERR(new_page)) {
+            rwlock_read_unlock(&region->lock);
+            return (int)new_page;
+        }
     }
 
     vaddr_t temp_page = (vaddr_t)kvm_alloc(PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, 0);
@@ -117,6 +142,9 @@ cow:
     pmap_remove(space->arch, temp_page, temp_page + PAGE_SIZE);
     kvm_free((void*)temp_page, PAGE_SIZE);
 
+    if (merged)
+        vm_merge_frame_put(merged);
+
     rwlock_read_unlock(&region->lock);
 
     return 0;
@@ -0,0 +1,135 @@
+#include "vm_kstack.h"
+#include "layout.h"
+#include "vm_map.h"
+#include "vm_phys.h"
+#include "vm_space.h"
+
+#include <sys/pcpu.h>
+
+#include <machine/cpufunc.h>
+#include <machine/pmap.h>
+
+#include <kern/errno.h>
+#include <kern/spinlock.h>
+
+#define KSTACK_SLOT_SIZE  (PAGE_SIZE + KSTACK_SIZE) // The guard page, then the stack
+#define KSTACK_SLOTS      (KSTACK_AREA_SIZE / KSTACK_SLOT_SIZE)
+#define KSTACK_CACHE_SIZE 8
+
+typedef struct kstack_free {
+    struct kstack_free* next;
+} kstack_free_t;
+
+typedef struct kstack_cache {
+    uint32_t count;
+    void*    stacks[KSTACK_CACHE_SIZE];
+} kstack_cache_t;
+
+static kstack_cache_t kstack_caches[MAX_CPUS];
+
+static kstack_free_t* kstack_free_list = NULL; // Mapped stacks no CPU is caching, linked in place
+static uint32_t       kstack_next_slot = 0;    // Slots from here on have never been mapped
+static spinlock_t     kstack_lock      = SPINLOCK_INITIALIZER;
+
+// Only valid with interrupts off, so the caller stays on this CPU
+static kstack_cache_t* kstack_cache(void)
+{
+    return &kstack_caches[get_pcpu() - pcpus];
+}
+
+static void kstack_unmap(vaddr_t stack, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+        vm_phys_free_page(pmap_extract(kernel_vm_space.arch, stack + offset));
+    pmap_remove(kernel_vm_space.arch, stack, stack + size);
+}
+
+static void* kstack_map(uint32_t slot)
+{
+    vaddr_t stack = KSTACK_AREA_START + slot * KSTACK_SLOT_SIZE + PAGE_SIZE;
+
+    for (size_t offset = 0; offset < KSTACK_SIZE; offset += PAGE_SIZE) {
+        paddr_t phys = vm_phys_alloc_page();
+        if (!phys) {
+            kstack_unmap(stack, offset);
+            return NULL;
+        }
+
+        int res = pmap_enter(kernel_vm_space.arch, stack + offset, phys,
+                             VM_PROT_READ | VM_PROT_WRITE, PMAP_FLAG_WIRED);
+        if (IS_ERR(res)) {
+            vm_phys_free_page(phys);
+            kstack_unmap(stack, offset);
+            return NULL;
+        }
+    }
+
+    return (void*)stack;
+}
+
+int vm_kstack_init(void)
+{
+    // Keep the rest of the kernel out of the window; its pages are mapped here, not by vm_fault
+    vaddr_t base = KSTACK_AREA_START;
+    int     res  = vm_map_anon(&kernel_vm_space, &base, KSTACK_AREA_SIZE, VM_PROT_NONE,
+                               VM_REG_F_KERNEL | VM_REG_F_WIRED, VM_MAP_F_FIXED);
+    if (IS_ERR(res))
+        return res;
+
+    // Mapping the first stack now creates the window's page table, which every address space
+    // created from here on shares
+    void* stack = vm_kstack_alloc();
+    if (!stack)
+        return -ENOMEM;
+    vm_kstack_free(stack);
+    return 0;
+}
+
+void* vm_kstack_alloc(void)
+{
+    void*    stack  = NULL;
+    uint32_t eflags = intr_disable();
+
+    kstack_cache_t* cache = kstack_cache();
+    if (cache->count)
+        stack = cache->stacks[--cache->count];
+    intr_restore(eflags);
+
+    if (stack)
+        return stack;
+
+    uint32_t slot = KSTACK_SLOTS;
+    WITH_SPINLOCK_IRQSAVE(kstack_lock)
+    {
+        if (kstack_free_list) {
+            stack            = kstack_free_list;
+            kstack_free_list = kstack_free_list->next;
+        }
+        else if (kstack_next_slot < KSTACK_SLOTS) {
+            slot = kstack_next_slot++;
+        }
+    }
+
+    if (!stack && slot < KSTACK_SLOTS)
+        stack = kstack_map(slot);
+    return stack;
+}
+
+void vm_kstack_free(void* stack)
+{
+    uint32_t eflags = intr_disable();
+
+    kstack_cache_t* cache = kstack_cache();
+    if (cache->count < KSTACK_CACHE_SIZE) {
+        cache->stacks[cache->count++] = stack;
+        intr_restore(eflags);
+        return;
+    }
+    intr_restore(eflags);
+
+    WITH_SPINLOCK_IRQSAVE(kstack_lock)
+    {
+        ((kstack_free_t*)stack)->next = kstack_free_list;
+        kstack_free_list              = stack;
+    }
+}
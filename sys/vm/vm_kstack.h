@@ -0,0 +1,20 @@
+#ifndef VM_KSTACK_H
+#define VM_KSTACK_H
+
+#include "types.h"
+
+/*
+ * Kernel thread stacks come from their own window of kernel address space (see layout.h), each
+ * with an unmapped guard page below it, so running off the bottom of a stack faults instead of
+ * corrupting whatever lies under it. Freed stacks stay mapped and are kept for reuse, first in a
+ * small per-CPU cache, so creating a thread normally costs a pointer pop.
+ */
+
+#define KSTACK_SIZE PAGE_SIZE
+
+int   vm_kstack_init(void);
+/* Returns a KSTACK_SIZE stack (lowest address), or NULL when none is left */
+void* vm_kstack_alloc(void);
+void  vm_kstack_free(void* stack);
+
+#endif // VM_KSTACK_H
@@ -1,6 +1,7 @@
 #include "vm_map.h"
 #include "types.h"
 #include "vm_page.h"
+#include "vm_pager.h"
 #include "vm_region.h"
 #include "vm_space.h"
 
@@ -9,6 +10,7 @@
 #include <kern/spinlock.h>
 #include <kern/terminal.h>
 
+#include <radix.h>
 #include <string.h>
 
 int vm_map(vm_space_t* space, vaddr_t* virt, size_t size, vm_prot_t prot, vm_region_flags_t flags,
@@ -54,6 +56,81 @@ int vm_unmap(vm_space_t* space, uintptr_t virt, size_t size)
     return 0;
 }
 
+int vm_map_stack(vm_space_t* space, vaddr_t top, size_t size, size_t max_size, vm_prot_t prot)
+{
+    size     = PAGE_ALIGN_UP(size);
+    max_size = PAGE_ALIGN_UP(max_size);
+    if (size == 0 || size > max_size || max_size + VM_STACK_GUARD_SIZE > top)
+        return -EINVAL;
+
+    // Reserve the whole span, guard page included, so nothing else gets placed inside it
+    vaddr_t      reserve = top - max_size - VM_STACK_GUARD_SIZE;
+    vm_region_t* region  = vm_region_create(space, &reserve, max_size + VM_STACK_GUARD_SIZE, NULL, 0,
+                                            prot, VM_REG_F_PRIVATE, VM_MAP_F_FIXED);
+    if (IS_ERR(region))
+        return (int)region;
+
+    // Then shrink it to the initial size; vm_fault grows it back down as the stack is used
+    WITH_WRITE_LOCK(space->regions_lock)
+    {
+        region->flags |= VM_REG_F_STACK;
+        region->stack_limit = top - max_size;
+        region->base        = top - size;
+        region->offset      = max_size - size;
+    }
+
+    return 0;
+}
+
+int vm_page_out_locked(vm_space_t* space, vm_region_t* region, vaddr_t virt)
+{
+    int          res    = 0;
+    vm_object_t* obj    = region->object;
+    size_t       offset = (virt - region->base) + region->offset;
+
+    WITH_SPINLOCK(obj->lock)
+    {
+        vm_page_t* page = radix_tree_lookup(&obj->pages, offset >> 12);
+        if (!page) {
+            res = -ENOENT;
+            break;
+        }
+
+        // Merged frames are already paying for themselves
+        if (page->state & VM_PAGE_FLAG_MERGED) {
+            res = -EBUSY;
+            break;
+        }
+
+        // Unmap first so nothing writes to the page while it is being stored
+        pmap_remove(space->arch, virt, virt + PAGE_SIZE);
+
+        res = obj->pager->ops->put_page(obj, page);
+        if (res)
+            break; // The page stays in the object and faults back in from there
+
+        radix_tree_remove(&obj->pages, offset >> 12, NULL);
+        vm_page_free(page);
+    }
+
+    return res;
+}
+
+int vm_page_out(vm_space_t* space, vaddr_t virt)
+{
+    virt = PAGE_ALIGN_DOWN(virt);
+
+    vm_region_t* region = vm_region_lookup(space, virt, rwlock_write_lock);
+    if (!region)
+        return -ENOENT;
+
+    // A page shared with other regions could still be mapped somewhere this cannot unmap
+    int res = vm_region_owns_pages(region) ? vm_page_out_locked(space, region, virt) : -EPERM;
+
+    rwlock_write_unlock(&region->lock);
+    return res;
+}
+
 int vm_protect(vm_space_t* space, uintptr_t virt, size_t size, vm_prot_t prot)
 {
     vm_region_protect_range(space, virt, size, prot);
@@ -74,13 +151,15 @@ void* vm_map_device(paddr_t addr, size_t size, vm_prot_t prot, vm_region_flags_t
 
     vaddr_t virt = (vaddr_t)kvm_alloc(aligned_size, prot,
                                       VM_REG_F_DEVICE | VM_REG_F_WIRED |
-                                          (flags & VM_REG_F_NOCACHE ? VM_REG_F_NOCACHE : 0));
+                                          (flags & (VM_REG_F_NOCACHE | VM_REG_F_WC)));
     if (IS_ERR(virt))
         return ERR_PTR(-ENOMEM);
 
     int pmap_flags = PMAP_FLAG_WIRED;
-    if (flags & VM_DEV_NOCACHE)
+    if (flags & VM_REG_F_NOCACHE)
         pmap_flags |= PMAP_FLAG_NOCACHE;
+    else if (flags & VM_REG_F_WC)
+        pmap_flags |= PMAP_FLAG_WC;
 
     for (paddr_t phys = aligned_phys; phys < end_phys; phys += PAGE_SIZE) {
         // TODO: Consider bookkeeping in object for device mappings to allow for proper unmapping
@@ -138,6 +217,8 @@ void* kvm_map(size_t size, vm_prot_t prot, vm_region_flags_t flags)
     int pmap_flags = PMAP_FLAG_WIRED;
     if (flags & VM_REG_F_NOCACHE)
         pmap_flags |= PMAP_FLAG_NOCACHE;
+    else if (flags & VM_REG_F_WC)
+        pmap_flags |= PMAP_FLAG_WC;
 
     vm_region_t* region = vm_region_lookup(&kernel_vm_space, kva, rwlock_read_lock);
     vm_object_t* obj    = region->object;
@@ -17,6 +17,15 @@ int vm_map_anon(vm_space_t* space, vaddr_t* virt, size_t size, vm_prot_t prot,
 
 int vm_protect(vm_space_t* space, vaddr_t virt, size_t size, vm_prot_t prot);
 
+// Evicts the page mapped at virt to its object's pager, freeing its frame.
+int vm_page_out(vm_space_t* space, vaddr_t virt);
+// vm_page_out for a page-aligned virt in region, which the caller holds write-locked and which must
+// own its pages (see vm_region_owns_pages).
+int vm_page_out_locked(vm_space_t* space, vm_region_t* region, vaddr_t virt);
+
+// Maps a stack of size bytes ending at top, which grows down on demand up to max_size bytes.
+int vm_map_stack(vm_space_t* space, vaddr_t top, size_t size, size_t max_size, vm_prot_t prot);
+
 void* vm_map_device(paddr_t phys, size_t size, vm_prot_t prot, vm_region_flags_t flags);
 void  vm_unmap_device(void* virt, size_t size);
 
@@ -0,0 +1,256 @@
+#include "vm_merge.h"
+#include "kmalloc.h"
+#include "vm_map.h"
+#include "vm_object.h"
+#include "vm_page.h"
+#include "vm_phys.h"
+#include "vm_region.h"
+#include "vm_space.h"
+
+#include <machine/pmap.h>
+
+#include <kern/errno.h>
+#include <kern/process.h>
+#include <kern/spinlock.h>
+#include <kern/timer.h>
+
+#include <radix.h>
+#include <string.h>
+
+#define VM_MERGE_BUCKETS 256
+
+vm_merge_stats_t vm_merge_stats = {0};
+
+static hashtable_t* merge_table  = NULL;
+static spinlock_t   merge_lock   = SPINLOCK_INITIALIZER; // Protects merge_table and frame refs
+static vaddr_t      merge_window = 0;                    // Two kernel pages for reading frames
+
+typedef struct vm_merge_ctx {
+    vm_space_t*  space;
+    vm_region_t* region;
+} vm_merge_ctx_t;
+
+// FNV-1a over the page, one word at a time
+static uint32_t vm_merge_hash(const uint32_t* data)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash ? hash : 1; // 0 means "never scanned" in vm_page_t
+}
+
+static void* vm_merge_map(int slot, paddr_t phys)
+{
+    vaddr_t virt = merge_window + slot * PAGE_SIZE;
+    pmap_enter(kernel_vm_space.arch, virt, phys, VM_PROT_READ, 0);
+    return (void*)virt;
+}
+
+static void vm_merge_frame_get(vm_merge_frame_t* frame)
+{
+    if (frame->refs >= 1) {
+        vm_merge_stats.pages_merged++;
+        if (frame->refs == 1)
+            vm_merge_stats.pages_shared++;
+    }
+    frame->refs++;
+}
+
+void vm_merge_frame_put(vm_merge_frame_t* frame)
+{
+    bool last = false;
+
+    WITH_SPINLOCK(merge_lock)
+    {
+        if (frame->refs >= 2) {
+            vm_merge_stats.pages_merged--;
+            if (frame->refs == 2)
+                vm_merge_stats.pages_shared--;
+        }
+
+        if (--frame->refs == 0) {
+            hashtable_remove(merge_table, frame->entry.key, NULL);
+            last = true;
+        }
+    }
+
+    if (last) {
+        vm_phys_free_page(frame->phys);
+        kfree(frame);
+    }
+}
+
+vm_merge_frame_t* vm_merge_unshare(vm_page_t* page)
+{
+    vm_merge_frame_t* frame = page->merge_frame;
+
+    WITH_SPINLOCK(merge_lock)
+    {
+        if (frame->refs == 1) {
+            // Nobody else maps the frame, so it can go back to being private without a copy
+            hashtable_remove(merge_table, frame->entry.key, NULL);
+            page->state &= ~(VM_PAGE_FLAG_MERGED | VM_PAGE_FLAG_COW);
+            page->merge_frame = NULL;
+            page->checksum    = 0;
+            kfree(frame);
+            return NULL;
+        }
+    }
+
+    paddr_t phys = vm_phys_alloc_page();
+    if (!phys)
+        return ERR_PTR(-ENOMEM);
+
+    // The page's reference on the frame passes to the caller until the copy is done
+    page->phys_addr = phys;
+    page->state &= ~(VM_PAGE_FLAG_MERGED | VM_PAGE_FLAG_COW);
+    page->merge_frame = NULL;
+    page->checksum    = 0;
+    return frame;
+}
+
+static int vm_merge_scan_page(unsigned long index, void* value, void* data)
+{
+    vm_merge_ctx_t* ctx    = data;
+    vm_region_t*    region = ctx->region;
+    vm_page_t*      page   = value;
+
+    if (page->state & VM_PAGE_FLAG_MERGED)
+        return 0;
+
+    size_t offset = (size_t)index * PAGE_SIZE;
+    if (offset < region->offset || offset - region->offset >= region->end - region->base)
+        return 0;
+
+    vaddr_t virt   = region->base + (offset - region->offset);
+    paddr_t mapped = pmap_extract(ctx->space->arch, virt);
+    bool    is_map = !IS_ERR(mapped);
+    if (is_map && mapped != page->phys_addr)
+        return 0;
+
+    // Pages that changed since the last pass are likely to change again; merging them would only
+    // buy a copy-on-write fault
+    uint32_t sum = vm_merge_hash(vm_merge_map(0, page->phys_addr));
+    vm_merge_stats.pages_scanned++;
+    if (sum != page->checksum) {
+        page->checksum = sum;
+        return 0;
+    }
+
+    // Write-protect first, then make sure nothing slipped in before the protection took effect
+    vm_prot_t ro_prot = region->prot & ~VM_PROT_WRITE;
+    if (is_map)
+        pmap_protect(ctx->space->arch, virt, virt + PAGE_SIZE, ro_prot);
+    bool    merged   = false;
+    paddr_t old_phys = page->phys_addr;
+
+    if (vm_merge_hash(vm_merge_map(0, old_phys)) == sum) {
+        WITH_SPINLOCK(merge_lock)
+        {
+            hashtable_entry_t* entry;
+            hashtable_get(merge_table, sum, &entry);
+
+            vm_merge_frame_t* frame = entry ? container_of(entry, vm_merge_frame_t, entry) : NULL;
+            if (frame) {
+                // A hash collision leaves the page alone rather than shadowing the existing frame
+                if (memcmp(vm_merge_map(0, old_phys), vm_merge_map(1, frame->phys), PAGE_SIZE))
+                    break;
+            }
+            else {
+                // First page with these contents: its own frame becomes the shared one
+                frame = kmalloc(sizeof(vm_merge_frame_t));
+                if (!frame)
+                    break;
+                frame->entry.key = sum;
+                frame->phys      = old_phys;
+                frame->refs      = 0;
+                hashtable_put(merge_table, frame);
+            }
+
+            vm_merge_frame_get(frame);
+            page->phys_addr   = frame->phys;
+            page->merge_frame = frame;
+            page->state |= VM_PAGE_FLAG_MERGED | VM_PAGE_FLAG_COW;
+            merged = true;
+        }
+    }
+
+    if (!merged) {
+        page->checksum = 0;
+        if (is_map)
+            pmap_protect(ctx->space->arch, virt, virt + PAGE_SIZE, region->prot);
+        return 0;
+    }
+
+    if (page->phys_addr != old_phys) {
+        if (is_map)
+            pmap_enter(ctx->space->arch, virt, page->phys_addr, ro_prot, 0);
+        vm_phys_free_page(old_phys);
+    }
+
+    return 0;
+}
+
+void vm_merge_scan()
+{
+    WITH_READ_LOCK(vm_spaces_lock)
+    {
+        list_node_t* space_node;
+        list_for_each(space_node, &vm_spaces)
+        {
+            vm_space_t* space = container_of(space_node, vm_space_t, node);
+
+            WITH_READ_LOCK(space->regions_lock)
+            {
+                list_node_t* region_node;
+                list_for_each(region_node, &space->regions)
+                {
+                    vm_region_t* region = list_node_to_region(region_node);
+                    // Pages shared with other regions may be mapped where the scan cannot see
+                    if (!vm_region_owns_pages(region))
+                        continue;
+
+                    // The write lock keeps vm_fault out while pages change frames
+                    WITH_WRITE_LOCK(region->lock)
+                    {
+                        vm_merge_ctx_t ctx = {.space = space, .region = region};
+                        WITH_SPINLOCK(region->object->lock)
+                        {
+                            radix_tree_walk(&region->object->pages, vm_merge_scan_page, &ctx);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    vm_merge_stats.full_scans++;
+}
+
+static void vm_merge_thread()
+{
+    while (1) {
+        vm_merge_scan();
+        timer_sleep_us(VM_MERGE_SCAN_INTERVAL_US);
+    }
+}
+
+int vm_merge_init()
+{
+    int res = hashtable_create(VM_MERGE_BUCKETS, &merge_table);
+    if (res)
+        return res;
+
+    merge_window = (vaddr_t)kvm_alloc(2 * PAGE_SIZE, VM_PROT_READ, VM_REG_F_WIRED);
+    if (IS_ERR(merge_window))
+        return (int)merge_window;
+
+    // Populate the window's page table now so every address space created later inherits it
+    vm_merge_map(0, 0);
+    vm_merge_map(1, 0);
+
+    if (!create_kernel_thread(vm_merge_thread, &idle_process, SCHED_PRIO_DEFAULT, NULL))
+        return -ENOMEM;
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef VM_MERGE_H
+#define VM_MERGE_H
+
+#include "types.h"
+
+#include <libkern/hashtable.h>
+
+#include <inttypes.h>
+
+typedef struct vm_page vm_page_t;
+
+#define VM_MERGE_SCAN_INTERVAL_US 500000 // Scanner thread sleeps this long between passes
+
+// A read-only frame shared by every anonymous page found to hold the same contents
+typedef struct vm_merge_frame {
+    hashtable_entry_t entry; // Keyed by content hash
+    paddr_t           phys;
+    uint32_t          refs; // Number of vm_pages mapping the frame
+} vm_merge_frame_t;
+
+typedef struct vm_merge_stats {
+    uint32_t pages_shared;  // Frames mapped by more than one page
+    uint32_t pages_merged;  // Pages mapping a frame someone else already maps (frames saved)
+    uint32_t pages_scanned; // Pages hashed since boot
+    uint32_t full_scans;    // Completed passes over all address spaces
+} vm_merge_stats_t;
+
+extern vm_merge_stats_t vm_merge_stats;
+
+/* Sets up the merge tables and starts the scanner thread */
+int  vm_merge_init();
+/* Runs one pass over every user address space, merging pages whose contents are stable */
+void vm_merge_scan();
+
+/*
+ * Detaches a merged page from its shared frame before a write. Returns NULL if the page was the
+ * last user and simply took the frame back, otherwise the page gets a fresh frame and the shared
+ * one is returned still referenced: the caller copies from it, then drops it with
+ * vm_merge_frame_put().
+ */
+vm_merge_frame_t* vm_merge_unshare(vm_page_t* page);
+void              vm_merge_frame_put(vm_merge_frame_t* frame);
+
+#endif // VM_MERGE_H
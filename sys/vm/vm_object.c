@@ -3,6 +3,7 @@
 #include "vm_page.h"
 #include "vm_pager.h"
 #include "vm_vnode_pager.h"
+#include "vm_zswap_pager.h"
 
 #include <fs/vfs.h>
 
@@ -59,7 +60,7 @@ vm_object_t* vm_object_create_anon(void)
     new_obj->shadow_offset = 0;
     new_obj->lock          = SPINLOCK_INITIALIZER;
 
-    new_obj->pager = vm_pager_create(&dead_pager_ops, NULL);
+    new_obj->pager = vm_pager_create(&zswap_pager_ops, NULL);
     if (IS_ERR(new_obj->pager)) {
         kfree(new_obj);
         return ERR_PTR(-ENOMEM);
@@ -81,7 +82,7 @@ vm_object_t* vm_object_create_shadow(vm_object_t* shadow, vm_ooffset_t offset)
     new_obj->shadow_offset = offset;
     new_obj->lock          = SPINLOCK_INITIALIZER;
 
-    new_obj->pager = vm_pager_create(&dead_pager_ops, NULL);
+    new_obj->pager = vm_pager_create(&zswap_pager_ops, NULL);
     radix_tree_init(&new_obj->pages, 3, 4); // Example: 8 entries per node, 4 levels
 
     if (shadow) {
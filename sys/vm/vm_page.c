@@ -1,5 +1,6 @@
 #include "vm_page.h"
 #include "kmalloc.h"
+#include "vm_merge.h"
 #include "vm_object.h"
 #include "vm_phys.h"
 #include <kern/errno.h>
@@ -27,6 +28,24 @@ vm_page_t* vm_page_lookup(vm_object_t* obj, size_t offset)
     return page;
 }
 
+vm_page_t* vm_page_create(paddr_t phys, size_t offset)
+{
+    vm_page_t* page = kmalloc(sizeof(*page));
+    if (!page)
+        return ERR_PTR(-ENOMEM);
+
+    page->phys_addr   = phys;
+    page->offset      = offset;
+    page->state       = VM_PAGE_FLAG_ALLOCATED;
+    page->dirty       = false;
+    page->lock        = SPINLOCK_INITIALIZER;
+    page->ref_count   = 1;
+    page->checksum    = 0;
+    page->merge_frame = NULL;
+
+    return page;
+}
+
 vm_page_t* vm_page_allocate(vm_object_t* obj, size_t offset)
 {
     if (!obj)
@@ -36,13 +55,11 @@ vm_page_t* vm_page_allocate(vm_object_t* obj, size_t offset)
     if (!phys)
         return ERR_PTR(-ENOMEM);
 
-    vm_page_t* page = kmalloc(sizeof(*page));
-    if (!page) {
+    vm_page_t* page = vm_page_create(phys, offset);
+    if (IS_ERR(page)) {
         vm_phys_free_page(phys);
-        return ERR_PTR(-ENOMEM);
+        return page;
     }
-    page->phys_addr = phys;
-    page->offset    = offset;
 
     WITH_SPINLOCK(obj->lock)
     {
@@ -66,6 +83,9 @@ void vm_page_free(vm_page_t* page)
 {
     if (!page)
         return;
-    vm_phys_free_page(page->phys_addr);
+    if (page->state & VM_PAGE_FLAG_MERGED)
+        vm_merge_frame_put(page->merge_frame);
+    else
+        vm_phys_free_page(page->phys_addr);
     kfree(page);
 }
@@ -8,12 +8,14 @@
 
 #include <list.h>
 
-typedef struct vm_page vm_page_t;
+typedef struct vm_page        vm_page_t;
+typedef struct vm_merge_frame vm_merge_frame_t;
 
 typedef enum vm_page_flags {
     VM_PAGE_FLAG_FREE      = 0x0,
     VM_PAGE_FLAG_ALLOCATED = 0x1,
     VM_PAGE_FLAG_COW       = 0x2, // Copy-on-write page
+    VM_PAGE_FLAG_MERGED    = 0x4, // Frame is shared with identical pages (see vm_merge.c)
 } vm_page_flags_t;
 
 typedef int (*vm_page_fault_handler_t)(vm_page_t* page, vm_prot_t fault_type);
@@ -29,6 +31,9 @@ typedef struct vm_page {
     spinlock_t
         lock;      // Lock for synchronizing access to the page when swapping or modifying its state
     int ref_count; // Reference count for shared pages
+
+    uint32_t          checksum;    // Content hash from the last merge scan, 0 if never scanned
+    vm_merge_frame_t* merge_frame; // VM_PAGE_FLAG_MERGED: the shared frame this page maps
 } vm_page_t;
 
 inline vm_page_t* list_node_to_page(list_node_t* node)
@@ -42,6 +47,8 @@ inline vm_object_t* vm_page_get_object(vm_page_t* page)
 }
 
 vm_page_t* vm_page_lookup(vm_object_t* obj, size_t offset);
+/* Wraps an already allocated frame in a vm_page without adding it to any object */
+vm_page_t* vm_page_create(paddr_t phys, size_t offset);
 vm_page_t* vm_page_allocate(vm_object_t* obj, size_t offset);
 void       vm_page_free(vm_page_t* page);
 
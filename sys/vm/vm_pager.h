@@ -7,6 +7,8 @@ typedef struct vm_object vm_object_t;
 typedef struct vm_page   vm_page_t;
 
 typedef struct vm_pager_ops {
+    // get_page takes the object lock itself, put_page is called with it held. A successful
+    // put_page leaves the page in the object; removing and freeing it is up to the caller.
     int (*get_page)(vm_object_t* obj, vm_ooffset_t offset, vm_page_t** page);
     int (*put_page)(vm_object_t* obj, vm_page_t* page);
     bool (*has_page)(vm_object_t* obj, vm_ooffset_t offset);
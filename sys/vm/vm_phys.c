@@ -1,4 +1,5 @@
 #include "vm_phys.h"
+#include "vm_shrinker.h"
 
 #include <vm/layout.h>
 
@@ -13,6 +14,11 @@ bitmap_t* page_bitmap = NULL;
 size_t total_memory      = 0;
 size_t total_free_memory = 0;
 
+// Below the low watermark the reclaim thread is woken to have shrinkers bring free pages back up to
+// the high one
+static uint32_t watermark_low  = 0;
+static uint32_t watermark_high = 0;
+
 int vm_phys_init(memory_map_entry_t* mem_map, size_t mem_map_length)
 {
     for (size_t i = 0; i < mem_map_length; i++) {
@@ -43,6 +49,11 @@ int vm_phys_init(memory_map_entry_t* mem_map, size_t mem_map_length)
     size_t kernel_pages = (16 * 1024 * 1024) / PAGE_SIZE;
     set_blocks(page_bitmap, 0, kernel_pages, 1);
 
+    watermark_low = page_count / VM_PHYS_WATERMARK_DIV;
+    if (watermark_low < VM_PHYS_WATERMARK_MIN)
+        watermark_low = VM_PHYS_WATERMARK_MIN;
+    watermark_high = 2 * watermark_low;
+
     return 0;
 }
 
@@ -52,20 +63,39 @@ void vm_phys_dump_info()
     printf("Free Memory: %u MB\n", total_free_memory / (1024 * 1024));
 }
 
+size_t vm_phys_free_count()
+{
+    return page_bitmap->free_blocks;
+}
+
+size_t vm_phys_reclaim_target()
+{
+    uint32_t free = page_bitmap->free_blocks;
+    return free < watermark_low ? watermark_high - free : 0;
+}
+
+static void vm_phys_check_watermark()
+{
+    if (page_bitmap->free_blocks < watermark_low)
+        vm_reclaim_wake();
+}
+
 paddr_t vm_phys_alloc_page()
 {
-    paddr_t page    = allocate_block(page_bitmap);
-    paddr_t address = page * PAGE_SIZE;
-    return address;
+    int page = allocate_block(page_bitmap);
+    vm_phys_check_watermark();
+    if (page < 0)
+        return 0;
+    return (paddr_t)page * PAGE_SIZE;
 }
 
 paddr_t vm_phys_alloc_pages(size_t npages)
 {
-    paddr_t page = allocate_blocks(page_bitmap, npages);
-    if (page)
-        return ENOMEM;
-    paddr_t address = page * PAGE_SIZE;
-    return address;
+    int page = allocate_blocks(page_bitmap, npages);
+    vm_phys_check_watermark();
+    if (page < 0)
+        return 0;
+    return (paddr_t)page * PAGE_SIZE;
 }
 
 void vm_phys_alloc_specific_page(paddr_t phys)
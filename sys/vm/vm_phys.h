@@ -12,6 +12,9 @@
 #define MEM_MAP_TYPE_ACPI_NVS         4
 #define MEM_MAP_TYPE_BADRAM           5
 
+#define VM_PHYS_WATERMARK_DIV 64 // Low watermark as a fraction of all pages
+#define VM_PHYS_WATERMARK_MIN 16 // but never fewer pages than this
+
 typedef struct memory_map_entry_t {
     uint64_t base_addr;
     uint64_t length;
@@ -21,6 +24,10 @@ typedef struct memory_map_entry_t {
 
 int     vm_phys_init(memory_map_entry_t* mem_map, size_t mem_map_length);
 void    vm_phys_dump_info();
+size_t  vm_phys_free_count();
+/* Pages to free to get back to the high watermark, or 0 while above the low one */
+size_t  vm_phys_reclaim_target();
+/* Both return 0 when no memory is left; page 0 is always reserved, so it is never handed out */
 paddr_t vm_phys_alloc_page();
 paddr_t vm_phys_alloc_pages(size_t npages);
 void    vm_phys_alloc_specific_page(paddr_t phys);
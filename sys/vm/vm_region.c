@@ -17,7 +17,7 @@
 
 static inline bool vm_region_overlaps(vm_region_t* region, uintptr_t start, uintptr_t end)
 {
-    return !(start >= region->end || end <= region->base);
+    return !(start >= region->end || end <= vm_region_floor(region));
 }
 
 vm_region_t* vm_region_lookup(vm_space_t* space, uintptr_t addr, lock_func_t lock_func)
@@ -39,6 +39,50 @@ vm_region_t* vm_region_lookup(vm_space_t* space, uintptr_t addr, lock_func_t loc
     return NULL;
 }
 
+vm_region_t* vm_region_grow_stack(vm_space_t* space, uintptr_t addr, lock_func_t lock_func)
+{
+    vaddr_t page_addr = PAGE_ALIGN_DOWN(addr);
+
+    WITH_WRITE_LOCK(space->regions_lock)
+    {
+        list_node_t* node;
+        list_for_each(node, &space->regions)
+        {
+            vm_region_t* region = list_node_to_region(node);
+            if (!(region->flags & VM_REG_F_STACK) || addr >= region->base)
+                continue;
+
+            // Only faults inside the reservation and close to the current bottom grow the stack;
+            // anything else (including the guard page) is a stray access
+            if (page_addr < region->stack_limit || region->base - page_addr > VM_STACK_GROW_GAP)
+                continue;
+
+            WITH_WRITE_LOCK(region->lock)
+            {
+                // Offsets are anchored at stack_limit, so they stay valid as the base moves down
+                region->offset -= region->base - page_addr;
+                region->base = page_addr;
+            }
+
+            if (lock_func)
+                lock_func(&region->lock);
+            return region;
+        }
+    }
+
+    return NULL;
+}
+
+bool vm_region_owns_pages(vm_region_t* region)
+{
+    if (region->flags & (VM_REG_F_KERNEL | VM_REG_F_SHARED | VM_REG_F_DEVICE | VM_REG_F_WIRED))
+        return false;
+
+    vm_object_t* obj = region->object;
+    return obj && obj->ref_count == 1 &&
+           (obj->type == VM_OBJECT_ANON || obj->type == VM_OBJECT_SHADOW);
+}
+
 vaddr_t vm_find_free_region(vm_space_t* space, size_t size, vm_region_flags_t flags)
 {
     uintptr_t last_end = 0;
@@ -51,7 +95,8 @@ vaddr_t vm_find_free_region(vm_space_t* space, size_t size, vm_region_flags_t fl
     list_for_each(node, &space->regions)
     {
         vm_region_t* region = list_node_to_region(node);
-        if (last_end < region->base && region->base - last_end >= size)
+        vaddr_t      floor  = vm_region_floor(region);
+        if (last_end < floor && floor - last_end >= size)
             return last_end; // Found a gap large enough for the new region
 
         last_end = region->end;
@@ -70,7 +115,7 @@ vm_region_t* vm_region_lookup_range(vm_space_t* space, uintptr_t addr, size_t si
     list_for_each(node, &space->regions)
     {
         vm_region_t* region = list_node_to_region(node);
-        if (addr < region->end && addr + size > region->base)
+        if (addr < region->end && addr + size > vm_region_floor(region))
             return region;
     }
 
@@ -207,6 +252,8 @@ vm_region_t* vm_region_create(vm_space_t* space, vaddr_t* addr, size_t size, vm_
         region->offset = offset;
         region->lock   = RWLOCK_INITIALIZER;
 
+        region->stack_limit = region->base;
+
         vm_region_t* new_region = vm_region_insert(space, region);
         if (IS_ERR(new_region)) {
             vm_object_dec_ref(object);
@@ -24,8 +24,21 @@ typedef struct vm_region {
 
     vm_object_t* object;
     size_t       offset;
+
+    vaddr_t stack_limit; // VM_REG_F_STACK: lowest address the region may grow down to
 } vm_region_t;
 
+#define VM_STACK_GUARD_SIZE PAGE_SIZE   // Unmapped page kept below every stack reservation
+#define VM_STACK_GROW_GAP   (64 * 1024) // How far below a stack a fault may still grow it
+
+/* Returns the lowest address reserved by region, including the guard page of a stack */
+static inline vaddr_t vm_region_floor(vm_region_t* region)
+{
+    if (region->flags & VM_REG_F_STACK)
+        return region->stack_limit - VM_STACK_GUARD_SIZE;
+    return region->base;
+}
+
 #define list_node_to_region(nptr)    container_of(nptr, vm_region_t, node)
 #define vm_space_from_region(region) container_of((region)->node.list, vm_space_t, regions)
 #define GET_NEXT_REGION(region)      list_node_to_region((region)->node.next)
@@ -33,6 +46,11 @@ typedef struct vm_region {
 
 /* Returns the region that contains the address addr, or NULL if no such region exists */
 vm_region_t* vm_region_lookup(vm_space_t* space, uintptr_t addr, lock_func_t lock_func);
+/* Extends a stack region down to cover addr, returning it locked, or NULL if addr is out of reach */
+vm_region_t* vm_region_grow_stack(vm_space_t* space, uintptr_t addr, lock_func_t lock_func);
+/* Whether region is the only user of its object's pages (private, anonymous, not shared by a fork),
+ * so they can be moved between frames by touching this region's mappings alone */
+bool         vm_region_owns_pages(vm_region_t* region);
 /* Returns the first region that overlaps with the range [addr, addr + size) */
 vm_region_t* vm_region_lookup_range(vm_space_t* space, uintptr_t addr, size_t size);
 void         vm_region_free_range(vm_space_t* space, uintptr_t addr, size_t size);
@@ -0,0 +1,98 @@
+#include "kmalloc.h"
+#include "vm_phys.h"
+#include "vm_shrinker.h"
+
+#include <kern/errno.h>
+#include <kern/mutex.h>
+#include <kern/process.h>
+#include <kern/wait_queue.h>
+
+static list_t  shrinkers      = LIST_INIT;
+static mutex_t shrinkers_lock = MUTEX_INITIALIZER;
+
+static wait_queue_t      reclaim_wq      = WAIT_QUEUE_INIT;
+static volatile uint32_t reclaim_pending = 0; // Set by the first wake since the last pass began
+
+void vm_shrinker_register(vm_shrinker_t* shrinker)
+{
+    WITH_MUTEX(shrinkers_lock)
+    {
+        list_push_tail(&shrinkers, &shrinker->node);
+    }
+}
+
+void vm_shrinker_unregister(vm_shrinker_t* shrinker)
+{
+    WITH_MUTEX(shrinkers_lock)
+    {
+        list_remove(&shrinker->node);
+    }
+}
+
+size_t vm_shrink(vm_shrink_pool_t pool, size_t nr)
+{
+    size_t freed = 0;
+    size_t total = 0;
+
+    mutex_lock(&shrinkers_lock);
+
+    list_node_t* node;
+    list_for_each(node, &shrinkers)
+    {
+        vm_shrinker_t* shrinker = container_of(node, vm_shrinker_t, node);
+        if (shrinker->pool == pool)
+            total += shrinker->count(shrinker);
+    }
+
+    if (total) {
+        list_for_each(node, &shrinkers)
+        {
+            vm_shrinker_t* shrinker = container_of(node, vm_shrinker_t, node);
+            if (shrinker->pool != pool)
+                continue;
+            size_t count = shrinker->count(shrinker);
+            if (!count)
+                continue;
+
+            // Bigger caches give back more; every non-empty cache gives back something
+            size_t share = nr >= total ? count : count / ((total + nr - 1) / nr);
+            freed += shrinker->scan(shrinker, share ? share : 1);
+        }
+    }
+
+    mutex_unlock(&shrinkers_lock);
+    return freed;
+}
+
+// Allocations never reclaim themselves: they can happen with any lock held, and a pool that sits
+// below its low watermark would otherwise rescan every cache on every allocation. They wake this
+// thread instead, which sleeps until then, so an idle system takes no reclaim ticks.
+static void vm_reclaim_thread()
+{
+    while (1) {
+        wait_event(reclaim_wq, reclaim_pending);
+        // Cleared before the pass, so memory running low again during it brings us straight back
+        __sync_lock_release(&reclaim_pending);
+
+        size_t nr = vm_phys_reclaim_target();
+        if (nr)
+            vm_shrink(VM_SHRINK_PHYS, nr);
+
+        nr = kmalloc_reclaim_target();
+        if (nr)
+            vm_shrink(VM_SHRINK_KMALLOC, nr);
+    }
+}
+
+void vm_reclaim_wake(void)
+{
+    if (!reclaim_pending && !__sync_lock_test_and_set(&reclaim_pending, 1))
+        wake_one(&reclaim_wq);
+}
+
+int vm_reclaim_init(void)
+{
+    if (!create_kernel_thread(vm_reclaim_thread, &idle_process, SCHED_PRIO_DEFAULT, NULL))
+        return -ENOMEM;
+    return 0;
+}
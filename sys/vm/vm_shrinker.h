@@ -0,0 +1,40 @@
+#ifndef VM_SHRINKER_H
+#define VM_SHRINKER_H
+
+#include <list.h>
+#include <stddef.h>
+
+/*
+ * Caches that can give memory back register a shrinker against the pool their memory comes from.
+ * An allocation that leaves a pool below its low watermark wakes the reclaim thread, which asks
+ * that pool's shrinkers to release a share of the deficit proportional to how much they hold.
+ *
+ * count and scan work in the pool's unit, and scan must only report memory that actually went back
+ * to that pool. They run on the reclaim thread, so they may sleep, but must not wait on anything
+ * an allocation could be holding.
+ */
+typedef enum vm_shrink_pool {
+    VM_SHRINK_PHYS,    // Pages released to vm_phys
+    VM_SHRINK_KMALLOC, // Bytes released to the kernel heap
+} vm_shrink_pool_t;
+
+typedef struct vm_shrinker {
+    list_node_t      node;
+    const char*      name;
+    vm_shrink_pool_t pool;
+
+    size_t (*count)(struct vm_shrinker* shrinker);           // Units that could be freed now
+    size_t (*scan)(struct vm_shrinker* shrinker, size_t nr); // Free up to nr, return units freed
+} vm_shrinker_t;
+
+void   vm_shrinker_register(vm_shrinker_t* shrinker);
+void   vm_shrinker_unregister(vm_shrinker_t* shrinker);
+/* Asks pool's shrinkers to free about nr units between them, returns the total freed */
+size_t vm_shrink(vm_shrink_pool_t pool, size_t nr);
+/* Starts the reclaim thread */
+int    vm_reclaim_init(void);
+/* Called by allocators below their low watermark. Safe from any context, and cheap once the thread
+ * has already been woken. */
+void   vm_reclaim_wake(void);
+
+#endif // VM_SHRINKER_H
@@ -13,8 +13,13 @@
 
 #include <list.h>
 
-vm_space_t kernel_vm_space = {
-    .regions = LIST_INIT, .arch = NULL, .regions_lock = RWLOCK_INITIALIZER};
+vm_space_t kernel_vm_space = {.regions        = LIST_INIT,
+                               .arch           = NULL,
+                               .regions_lock   = RWLOCK_INITIALIZER,
+                               .lifecycle_lock = MUTEX_INITIALIZER};
+
+list_t   vm_spaces      = LIST_INIT;
+rwlock_t vm_spaces_lock = RWLOCK_INITIALIZER;
 
 int kvm_space_init()
 {
@@ -43,6 +48,7 @@ vm_space_t* vm_space_create()
         return ERR_PTR(-ENOMEM);
 
     space->regions_lock = RWLOCK_INITIALIZER;
+    mutex_init(&space->lifecycle_lock);
     list_init(&space->regions, 0);
 
     space->arch = pmap_create();
@@ -51,6 +57,11 @@ vm_space_t* vm_space_create()
         return ERR_PTR(-ENOMEM);
     }
 
+    WITH_WRITE_LOCK(vm_spaces_lock)
+    {
+        list_push_tail(&vm_spaces, &space->node);
+    }
+
     return space;
 }
 
@@ -63,18 +74,24 @@ vm_space_t* vm_space_fork(vm_space_t* parent)
     if (IS_ERR(child))
         return ERR_PTR(-ENOMEM);
 
-    WITH_READ_LOCK(parent->regions_lock)
+    // vm_region_fork swaps the parent's objects for shadows, which the read lock alone does not
+    // cover. Page faults keep going meanwhile; only a second fork or clean waits, sleeping.
+    WITH_MUTEX(parent->lifecycle_lock)
     {
-        // Copy the regions list (shallow copy)
-        for (list_node_t* node = parent->regions.head; node; node = node->next) {
-            vm_region_t* reference_region = list_node_to_region(node);
-            vm_region_t* child_region     = vm_region_fork(reference_region);
-            if (IS_ERR(child_region)) {
-                vm_space_destroy(child); // Clean up the child space and all regions created so far
-                return ERR_PTR(child_region);
+        WITH_READ_LOCK(parent->regions_lock)
+        {
+            // Copy the regions list (shallow copy)
+            for (list_node_t* node = parent->regions.head; node; node = node->next) {
+                vm_region_t* reference_region = list_node_to_region(node);
+                vm_region_t* child_region     = vm_region_fork(reference_region);
+                if (IS_ERR(child_region)) {
+                    // Clean up the child space and all regions created so far
+                    vm_space_destroy(child);
+                    return ERR_PTR(child_region);
+                }
+                // Insert the child region into the child's region list
+                list_push_tail(&child->regions, &child_region->node);
             }
-            // Insert the child region into the child's region list
-            list_push_tail(&child->regions, &child_region->node);
         }
     }
 
@@ -86,12 +103,20 @@ void vm_space_destroy(vm_space_t* space)
     if (!space)
         return;
 
+    WITH_WRITE_LOCK(vm_spaces_lock)
+    {
+        list_remove(&space->node);
+    }
+
     WITH_WRITE_LOCK(space->regions_lock)
     {
         // Decrement reference counts for all regions and their objects (this will free them if this
-        // was the last reference)
+        // was the last reference). The mappings go first: the objects own the frames, which may
+        // still be mapped elsewhere, so pmap_destroy must not find and free them.
         while (space->regions.head) {
             vm_region_t* region = list_node_to_region(space->regions.head);
+            if (!(region->flags & VM_REG_F_KERNEL))
+                pmap_remove(space->arch, region->base, region->end);
             vm_region_destroy(region);
         }
     }
@@ -107,6 +132,7 @@ void vm_space_clean(vm_space_t* space)
     if (!space)
         return;
 
+    mutex_lock(&space->lifecycle_lock);
     WITH_WRITE_LOCK(space->regions_lock)
     {
         // Similar to destroy, but kernel regions should not be freed, and the vm_space itself
@@ -121,6 +147,7 @@ void vm_space_clean(vm_space_t* space)
             }
         }
     }
+    mutex_unlock(&space->lifecycle_lock);
 }
 
 void vm_space_activate(vm_space_t* space)
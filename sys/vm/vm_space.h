@@ -3,22 +3,28 @@
 
 #include <machine/pmap.h>
 
+#include <kern/mutex.h>
 #include <kern/rwlock.h>
-#include <kern/spinlock.h>
 
 #include <list.h>
 
 typedef struct vm_region vm_region_t;
 
 typedef struct vm_space {
-    list_t     regions;
-    rwlock_t   regions_lock;   // Read-write lock for synchronizing access to the regions list
-    pmap_t*    arch;           // Architecture-specific data (e.g. page directory)
-    spinlock_t lifecycle_lock; // Lock for synchronizing access to the lifecycle of the vm_space
+    list_t   regions;
+    rwlock_t regions_lock;   // Read-write lock for synchronizing access to the regions list
+    pmap_t*  arch;           // Architecture-specific data (e.g. page directory)
+    mutex_t  lifecycle_lock; // Serialises forks and cleans, which rewrite the regions' objects
+
+    list_node_t node; // Entry in vm_spaces
 } vm_space_t;
 
 extern vm_space_t kernel_vm_space;
 
+// Every user space created by vm_space_create, for scanners that walk all address spaces
+extern list_t   vm_spaces;
+extern rwlock_t vm_spaces_lock;
+
 int         kvm_space_init();
 vm_space_t* vm_space_create();
 void        vm_space_clean(vm_space_t* space);
@@ -0,0 +1,530 @@
+#include "vm_zswap_pager.h"
+#include "kmalloc.h"
+#include "vm_map.h"
+#include "vm_object.h"
+#include "vm_page.h"
+#include "vm_phys.h"
+#include "vm_region.h"
+#include "vm_shrinker.h"
+#include "vm_space.h"
+
+#include <machine/pmap.h>
+
+#include <fs/vfs.h>
+
+#include <sys/device.h>
+#include <sys/driver.h>
+
+#include <libkern/lz4.h>
+
+#include <kern/errno.h>
+#include <kern/spinlock.h>
+#include <kern/terminal.h>
+
+#include <radix.h>
+#include <string.h>
+
+typedef struct zswap_pool_page {
+    paddr_t  phys; // 0 while the slot has no frame
+    uint64_t used; // One bit per allocated chunk
+} zswap_pool_page_t;
+
+// Where one compressed page lives in the pool
+typedef struct zswap_slot {
+    uint16_t pool_page;
+    uint8_t  chunk;
+    uint8_t  nchunks;
+    uint16_t size; // Compressed length in bytes
+} zswap_slot_t;
+
+zswap_stats_t zswap_stats = {0};
+
+DECLARE_DRIVER(zswap, root);
+
+// Protects the pool, the per-object slot trees and the scratch buffers below
+static spinlock_t        zswap_lock = SPINLOCK_INITIALIZER;
+static zswap_pool_page_t zswap_pool[ZSWAP_POOL_PAGES];
+static vaddr_t           zswap_window = 0; // Slot 0 maps a pool frame, slot 1 the page itself
+static uint8_t           zswap_buffer[ZSWAP_MAX_SIZE];
+static uint8_t           zswap_work[LZ4_WORK_SIZE];
+
+static inline unsigned long zswap_index(vm_ooffset_t offset)
+{
+    return (unsigned long)(offset >> 12);
+}
+
+static uint8_t* zswap_map(int slot, paddr_t phys)
+{
+    vaddr_t virt = zswap_window + slot * PAGE_SIZE;
+    pmap_enter(kernel_vm_space.arch, virt, phys, VM_PROT_READ | VM_PROT_WRITE, 0);
+    return (uint8_t*)virt;
+}
+
+static uint8_t* zswap_slot_data(zswap_slot_t* slot)
+{
+    return zswap_map(0, zswap_pool[slot->pool_page].phys) + slot->chunk * ZSWAP_CHUNK_SIZE;
+}
+
+// Finds nchunks contiguous free chunks, first fit, growing the pool by a frame if none are left
+static int zswap_alloc(zswap_slot_t* slot, size_t nchunks)
+{
+    uint64_t mask      = (1ULL << nchunks) - 1; // nchunks < 64, see ZSWAP_MAX_SIZE
+    int      free_page = -1;
+
+    for (int i = 0; i < ZSWAP_POOL_PAGES; i++) {
+        zswap_pool_page_t* page = &zswap_pool[i];
+        if (!page->phys) {
+            if (free_page < 0)
+                free_page = i;
+            continue;
+        }
+
+        for (size_t chunk = 0; chunk + nchunks <= ZSWAP_CHUNKS; chunk++) {
+            if (!(page->used & (mask << chunk))) {
+                page->used |= mask << chunk;
+                slot->pool_page = i;
+                slot->chunk     = chunk;
+                slot->nchunks   = nchunks;
+                return 0;
+            }
+        }
+    }
+
+    if (free_page < 0)
+        return -ENOSPC;
+
+    paddr_t phys = vm_phys_alloc_page();
+    if (!phys)
+        return -ENOMEM;
+
+    zswap_pool[free_page].phys = phys;
+    zswap_pool[free_page].used = mask;
+    zswap_stats.pool_pages++;
+
+    slot->pool_page = free_page;
+    slot->chunk     = 0;
+    slot->nchunks   = nchunks;
+    return 0;
+}
+
+static void zswap_release(void* data)
+{
+    zswap_slot_t*      slot = data;
+    zswap_pool_page_t* page = &zswap_pool[slot->pool_page];
+
+    page->used &= ~(((1ULL << slot->nchunks) - 1) << slot->chunk);
+    if (!page->used) {
+        vm_phys_free_page(page->phys);
+        page->phys = 0;
+        zswap_stats.pool_pages--;
+    }
+
+    zswap_stats.stored_pages--;
+    zswap_stats.stored_bytes -= slot->size;
+    zswap_stats.used_chunks -= slot->nchunks;
+    kfree(slot);
+}
+
+int zswap_pager_get_page(vm_object_t* obj, vm_ooffset_t offset, vm_page_t** page)
+{
+    int        res      = -ENOENT;
+    vm_page_t* new_page = NULL;
+
+    WITH_SPINLOCK(obj->lock)
+    {
+        // A racing fault may already have brought the page back in
+        new_page = radix_tree_lookup(&obj->pages, zswap_index(offset));
+        if (new_page) {
+            res = 0;
+            break;
+        }
+
+        WITH_SPINLOCK(zswap_lock)
+        {
+            radix_tree_t* tree = obj->pager->data;
+            zswap_slot_t* slot = tree ? radix_tree_lookup(tree, zswap_index(offset)) : NULL;
+            if (!slot)
+                break;
+
+            paddr_t phys = vm_phys_alloc_page();
+            if (!phys) {
+                res = -ENOMEM;
+                break;
+            }
+
+            if (lz4_decompress(zswap_slot_data(slot), slot->size, zswap_map(1, phys), PAGE_SIZE) !=
+                PAGE_SIZE) {
+                vm_phys_free_page(phys);
+                res = -EIO;
+                break;
+            }
+
+            new_page = vm_page_create(phys, offset);
+            if (IS_ERR(new_page)) {
+                vm_phys_free_page(phys);
+                res = (int)new_page;
+                break;
+            }
+
+            res = radix_tree_insert(&obj->pages, zswap_index(offset), new_page);
+            if (res) {
+                vm_page_free(new_page);
+                break;
+            }
+
+            radix_tree_remove(tree, zswap_index(offset), NULL);
+            zswap_release(slot);
+            zswap_stats.loads++;
+        }
+    }
+
+    if (res)
+        return res;
+
+    *page = new_page;
+    return 0;
+}
+
+// Called with the object lock held; on success the caller drops the page from the object
+int zswap_pager_put_page(vm_object_t* obj, vm_page_t* page)
+{
+    if (!zswap_window)
+        return -ENOSYS;
+
+    int res = 0;
+
+    WITH_SPINLOCK(zswap_lock)
+    {
+        radix_tree_t* tree = obj->pager->data;
+        if (!tree) {
+            tree = kmalloc(sizeof(radix_tree_t));
+            if (!tree) {
+                res = -ENOMEM;
+                break;
+            }
+            radix_tree_init(tree, VM_RADIX_CHUNK_BITS, VM_RADIX_HEIGHT);
+            obj->pager->data = tree;
+        }
+
+        size_t size = lz4_compress(zswap_map(1, page->phys_addr), PAGE_SIZE, zswap_buffer,
+                                   ZSWAP_MAX_SIZE, zswap_work);
+        if (!size) {
+            zswap_stats.rejected++;
+            res = -E2BIG;
+            break;
+        }
+
+        zswap_slot_t* slot = kmalloc(sizeof(zswap_slot_t));
+        if (!slot) {
+            res = -ENOMEM;
+            break;
+        }
+
+        res = zswap_alloc(slot, (size + ZSWAP_CHUNK_SIZE - 1) / ZSWAP_CHUNK_SIZE);
+        if (res) {
+            kfree(slot);
+            break;
+        }
+
+        slot->size = size;
+        memcpy(zswap_slot_data(slot), zswap_buffer, size);
+
+        zswap_stats.stored_pages++;
+        zswap_stats.stored_bytes += size;
+        zswap_stats.used_chunks += slot->nchunks;
+
+        // A copy left over from an earlier eviction of this offset is stale now
+        zswap_slot_t* old;
+        if (!radix_tree_remove(tree, zswap_index(page->offset), (void**)&old))
+            zswap_release(old);
+
+        res = radix_tree_insert(tree, zswap_index(page->offset), slot);
+        if (res)
+            zswap_release(slot);
+    }
+
+    return res;
+}
+
+bool zswap_pager_has_page(vm_object_t* obj, vm_ooffset_t offset)
+{
+    bool found = false;
+
+    WITH_SPINLOCK(zswap_lock)
+    {
+        radix_tree_t* tree = obj->pager->data;
+        found              = tree && radix_tree_lookup(tree, zswap_index(offset));
+    }
+
+    return found;
+}
+
+void zswap_pager_destroy(vm_object_t* obj)
+{
+    radix_tree_t* tree = obj->pager->data;
+    if (!tree)
+        return;
+
+    WITH_SPINLOCK(zswap_lock)
+    {
+        radix_tree_destroy(tree, zswap_release);
+    }
+
+    kfree(tree);
+    obj->pager->data = NULL;
+}
+
+vm_pager_ops_t zswap_pager_ops = {.get_page = zswap_pager_get_page,
+                                  .put_page = zswap_pager_put_page,
+                                  .has_page = zswap_pager_has_page,
+                                  .destroy  = zswap_pager_destroy};
+
+typedef struct zswap_scan_ctx {
+    vm_space_t*   space;
+    vm_region_t*  region;
+    size_t        found; // Evictable pages seen by count, pages evicted by scan
+    size_t        nr;    // Pages scan should evict
+    unsigned long next;  // First page index the current batch may take
+    unsigned long batch[ZSWAP_SCAN_BATCH];
+    size_t        nbatch;
+} zswap_scan_ctx_t;
+
+// Walks the regions whose pages zswap may evict, each write-locked so vm_fault stays out while
+// pages leave it. Stops once fn returns true.
+static void zswap_for_each_region(bool (*fn)(zswap_scan_ctx_t* ctx), zswap_scan_ctx_t* ctx)
+{
+    bool done = false;
+    WITH_READ_LOCK(vm_spaces_lock)
+    {
+        list_node_t* space_node;
+        list_for_each(space_node, &vm_spaces)
+        {
+            ctx->space = container_of(space_node, vm_space_t, node);
+
+            WITH_READ_LOCK(ctx->space->regions_lock)
+            {
+                list_node_t* region_node;
+                list_for_each(region_node, &ctx->space->regions)
+                {
+                    ctx->region = list_node_to_region(region_node);
+                    // Pages shared with other regions may be mapped where eviction cannot unmap
+                    if (!vm_region_owns_pages(ctx->region))
+                        continue;
+
+                    WITH_WRITE_LOCK(ctx->region->lock)
+                    {
+                        done = fn(ctx);
+                    }
+                    if (done)
+                        break;
+                }
+            }
+            if (done)
+                break;
+        }
+    }
+}
+
+static bool zswap_evictable(vm_region_t* region, unsigned long index, vm_page_t* page)
+{
+    // Merged frames are already paying for themselves
+    size_t offset = (size_t)index * PAGE_SIZE;
+    return !(page->state & VM_PAGE_FLAG_MERGED) && offset >= region->offset &&
+           offset - region->offset < region->end - region->base;
+}
+
+static int zswap_count_page(unsigned long index, void* value, void* data)
+{
+    zswap_scan_ctx_t* ctx = data;
+    if (zswap_evictable(ctx->region, index, value))
+        ctx->found++;
+    return 0;
+}
+
+static bool zswap_count_region(zswap_scan_ctx_t* ctx)
+{
+    WITH_SPINLOCK(ctx->region->object->lock)
+    {
+        radix_tree_walk(&ctx->region->object->pages, zswap_count_page, ctx);
+    }
+    return false;
+}
+
+// Pages can't leave the tree during the walk, so they are collected first and evicted after it
+static int zswap_collect_page(unsigned long index, void* value, void* data)
+{
+    zswap_scan_ctx_t* ctx = data;
+    if (index >= ctx->next && zswap_evictable(ctx->region, index, value))
+        ctx->batch[ctx->nbatch++] = index;
+    return ctx->nbatch == ZSWAP_SCAN_BATCH;
+}
+
+static bool zswap_scan_region(zswap_scan_ctx_t* ctx)
+{
+    vm_region_t* region = ctx->region;
+    ctx->next           = 0;
+
+    do {
+        ctx->nbatch = 0;
+        WITH_SPINLOCK(region->object->lock)
+        {
+            radix_tree_walk(&region->object->pages, zswap_collect_page, ctx);
+        }
+
+        for (size_t i = 0; i < ctx->nbatch && ctx->found < ctx->nr; i++) {
+            vaddr_t virt = region->base + (ctx->batch[i] * PAGE_SIZE - region->offset);
+            if (!vm_page_out_locked(ctx->space, region, virt))
+                ctx->found++;
+        }
+        if (ctx->nbatch)
+            ctx->next = ctx->batch[ctx->nbatch - 1] + 1;
+    } while (ctx->nbatch == ZSWAP_SCAN_BATCH && ctx->found < ctx->nr);
+
+    return ctx->found >= ctx->nr;
+}
+
+static size_t zswap_shrinker_count(vm_shrinker_t* shrinker)
+{
+    (void)shrinker;
+
+    zswap_scan_ctx_t ctx = {0};
+    zswap_for_each_region(zswap_count_region, &ctx);
+    return ctx.found;
+}
+
+// There are no accessed bits to go by, so pages are evicted in address order. The pool frames the
+// stores take are subtracted, so only pages that actually went back to vm_phys are reported.
+static size_t zswap_shrinker_scan(vm_shrinker_t* shrinker, size_t nr)
+{
+    (void)shrinker;
+
+    uint32_t         pool = zswap_stats.pool_pages;
+    zswap_scan_ctx_t ctx  = {.nr = nr};
+    zswap_for_each_region(zswap_scan_region, &ctx);
+
+    uint32_t grown = zswap_stats.pool_pages > pool ? zswap_stats.pool_pages - pool : 0;
+    return ctx.found > grown ? ctx.found - grown : 0;
+}
+
+static vm_shrinker_t zswap_shrinker = {
+    .name  = "zswap",
+    .pool  = VM_SHRINK_PHYS,
+    .count = zswap_shrinker_count,
+    .scan  = zswap_shrinker_scan,
+};
+
+int zswap_init()
+{
+    vaddr_t window = (vaddr_t)kvm_alloc(2 * PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_WIRED);
+    if (IS_ERR(window))
+        return (int)window;
+
+    // Populate the window's page table now so every address space created later inherits it
+    zswap_window = window;
+    zswap_map(0, 0);
+    zswap_map(1, 0);
+
+    vm_shrinker_register(&zswap_shrinker);
+    return 0;
+}
+
+/* ---------------- /dev/zswap ---------------- */
+
+#define ZSWAP_STATS_MAX 256
+
+int zswap_read(device_t* dev, uint64_t offset, uint32_t size, uint8_t* buffer)
+{
+    char          text[ZSWAP_STATS_MAX];
+    zswap_stats_t snap;
+    WITH_SPINLOCK(zswap_lock)
+    {
+        snap = zswap_stats;
+    }
+
+    // Ratio of original to compressed size, in hundredths; chunk use shows pool fragmentation
+    uint32_t stored = snap.stored_bytes ? snap.stored_bytes : 1;
+    uint32_t ratio  = (uint32_t)((uint64_t)snap.stored_pages * PAGE_SIZE * 100 / stored);
+    uint32_t chunks = snap.pool_pages ? snap.pool_pages * ZSWAP_CHUNKS : 1;
+
+    size_t len = snprintf(text, sizeof(text),
+                          "stored %u pages in %u bytes, ratio %u.%02u\n"
+                          "pool %u frames, %u%% of chunks used\n"
+                          "rejected %u loads %u\n",
+                          snap.stored_pages, snap.stored_bytes, ratio / 100, ratio % 100,
+                          snap.pool_pages, snap.used_chunks * 100 / chunks, snap.rejected,
+                          snap.loads);
+    if (len > sizeof(text))
+        len = sizeof(text);
+
+    uint32_t copied = 0;
+    if (offset < len) {
+        copied = len - (uint32_t)offset;
+        if (copied > size)
+            copied = size;
+        memcpy(buffer, text + (uint32_t)offset, copied);
+    }
+    return copied;
+}
+
+int zswap_write(device_t* dev, uint64_t offset, uint32_t size, const uint8_t* buffer)
+{
+    return -EINVAL;
+}
+
+int zswap_open(device_t* dev)
+{
+    return 0;
+}
+
+int zswap_close(device_t* dev)
+{
+    return 0;
+}
+
+int zswap_ioctl(device_t* dev, int cmd, void* arg)
+{
+    return -EINVAL;
+}
+
+// Only created by zswap_dev_init, never bound to an enumerated device
+int zswap_probe(device_t* dev)
+{
+    return -ENODEV;
+}
+
+int zswap_attach(device_t* dev)
+{
+    dev->type = DEV_TYPE_CHAR;
+    strcpy(dev->name, "zswap");
+    return 0;
+}
+
+int zswap_detach(device_t* dev)
+{
+    return 0;
+}
+
+int zswap_suspend(device_t* dev)
+{
+    return 0;
+}
+
+int zswap_resume(device_t* dev)
+{
+    return 0;
+}
+
+int zswap_shutdown(device_t* dev)
+{
+    return 0;
+}
+
+int zswap_dev_init()
+{
+    device_t* dev;
+    int       res = device_misc_create(&__driver_zswap, &dev);
+    if (res)
+        return res;
+
+    return vfs_register_device(dev);
+}
@@ -0,0 +1,38 @@
+#ifndef VM_ZSWAP_PAGER_H
+#define VM_ZSWAP_PAGER_H
+
+#include "vm_pager.h"
+
+#include <inttypes.h>
+
+/*
+ * Compressed in-RAM swap for anonymous objects. Evicted pages are LZ4
+ * compressed into a pool of frames carved into ZSWAP_CHUNK_SIZE chunks, and
+ * decompressed back into a fresh frame when they fault in again.
+ */
+#define ZSWAP_CHUNK_SIZE 64
+#define ZSWAP_CHUNKS     (PAGE_SIZE / ZSWAP_CHUNK_SIZE) // Per pool frame, one bit each
+#define ZSWAP_POOL_PAGES 1024                           // Frames the pool may grow to (4MB)
+#define ZSWAP_MAX_SIZE   (PAGE_SIZE * 3 / 4)            // Pages compressing worse stay resident
+#define ZSWAP_SCAN_BATCH 32                             // Pages the shrinker takes per tree walk
+
+typedef struct zswap_stats {
+    uint32_t stored_pages; // Pages currently held compressed
+    uint32_t stored_bytes; // Their total compressed size
+    uint32_t used_chunks;  // Pool chunks holding compressed data
+    uint32_t pool_pages;   // Frames currently owned by the pool
+    uint32_t rejected;     // Stores refused because the page did not compress well enough
+    uint32_t loads;        // Pages decompressed back on fault
+} zswap_stats_t;
+
+extern zswap_stats_t zswap_stats;
+
+/* Sets up the pool window and registers the shrinker that evicts anonymous pages into the pool.
+ * Needs the scheduler's per-CPU state, as registering takes a mutex. */
+int zswap_init();
+/* Creates /dev/zswap, which reports the stats above. Needs the VFS. */
+int zswap_dev_init();
+
+DECLARE_VM_PAGER_OPS(zswap);
+
+#endif // VM_ZSWAP_PAGER_H
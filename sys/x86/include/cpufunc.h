@@ -0,0 +1,83 @@
+#ifndef X86_CPUFUNC_H
+#define X86_CPUFUNC_H
+
+#include <inttypes.h>
+
+#define CPUID_FEATURES 0x1
+#define CPUID_EDX_TSC  (1 << 4)  // Time Stamp Counter
+#define CPUID_EDX_SEP  (1 << 11) // SYSENTER/SYSEXIT
+#define CPUID_EDX_PAT  (1 << 16) // Page Attribute Table
+
+#define MSR_IA32_SYSENTER_CS  0x174
+#define MSR_IA32_SYSENTER_ESP 0x175
+#define MSR_IA32_SYSENTER_EIP 0x176
+#define MSR_IA32_PAT          0x277
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx)
+{
+    asm volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* 64 by 32 bit division with a single divl, for code without libgcc. The quotient must fit in 32
+ * bits, or divl faults. */
+static inline uint32_t udiv64_32(uint64_t n, uint32_t d, uint32_t* rem)
+{
+    uint32_t q, r;
+    asm("divl %4" : "=a"(q), "=d"(r) : "a"((uint32_t)n), "d"((uint32_t)(n >> 32)), "rm"(d));
+    if (rem)
+        *rem = r;
+    return q;
+}
+
+static inline void wbinvd(void)
+{
+    asm volatile("wbinvd" : : : "memory");
+}
+
+#define EFLAGS_IF 0x200 // Interrupts enabled
+
+/* Disables interrupts and returns the previous EFLAGS, for intr_restore */
+static inline uint32_t intr_disable(void)
+{
+    uint32_t eflags;
+    asm volatile("pushfl; popl %0; cli" : "=r"(eflags) : : "memory");
+    return eflags;
+}
+
+static inline void intr_restore(uint32_t eflags)
+{
+    asm volatile("pushl %0; popfl" : : "r"(eflags) : "memory", "cc");
+}
+
+static inline void intr_enable(void)
+{
+    asm volatile("sti" : : : "memory");
+}
+
+/* Enables interrupts and halts until the next one. sti only takes effect after the following
+ * instruction, so an interrupt arriving after the caller's checks still ends the hlt. */
+static inline void intr_enable_halt(void)
+{
+    asm volatile("sti; hlt" : : : "memory");
+}
+
+#endif // X86_CPUFUNC_H
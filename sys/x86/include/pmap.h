@@ -17,37 +17,69 @@
 #define PAGE_ENTRIES_PER_TABLE  1024
 #define KERNEL_PAGE_ENTRY_START (PAGE_ENTRIES_PER_TABLE - KERNEL_PAGE_ENTRIES)
 
+// The directory slot just below the recursive one is the alternate recursive slot. Pointing it at
+// a foreign page directory exposes that directory at alt_pd and its page tables at alt_pts, so
+// page tables of another address space can be edited without reloading CR3.
+#define PMAP_ALT_SLOT (PAGE_ENTRIES_PER_TABLE - 2)
+
 extern page_table_t** current_pd_addr;
 extern page_table_t*  current_pd;
 extern page_table_t*  current_pts;
-extern page_table_t*  edit_pd;
+extern page_table_t*  alt_pd;
+extern page_table_t*  alt_pts;
 
 void tlb_invlpg(void* addr);
 void tlb_flush();
 void switch_page_directory(page_table_t** pd_ptr);
 
-#define SWITCH_SPACE(pmap)                                                                         \
-    page_table_t* old_pd __cleanup(switch_page_directory) = *current_pd_addr;                      \
-    if (pmap && old_pd != pmap->pd)                                                                \
-        switch_page_directory((void*)&pmap->pd);
-
 typedef struct pmap {
     page_table_t* pd; // Page directory
-    spinlock_t    lock;
+    mcs_lock_t    lock;
 } pmap_t;
 
+/* A view of a pmap's page tables, through either the recursive or the alternate slot */
+typedef struct pmap_window {
+    page_table_t* pd;  // Page directory of the pmap
+    page_table_t* pts; // Page tables of the pmap
+    bool          alt; // Whether the alternate slot is in use
+} pmap_window_t;
+
 typedef enum pmap_flags {
     PMAP_FLAG_NONE    = 0x0,
     PMAP_FLAG_WIRED   = 0x1, // Prevent the page from being swapped out
     PMAP_FLAG_NOCACHE = 0x2, // Disable caching for this page
     PMAP_FLAG_ZERO    = 0x4, // Zero out the page after mapping
+    PMAP_FLAG_WC      = 0x8, // Write-combining, for framebuffers and similar streaming MMIO
 } pmap_flags_t;
 
+// PAT layout programmed by pmap_init_pat. The upper four entries repeat the lower four, so the
+// memory type only depends on PWT and PCD: 0 = WB, PWT = WC, PCD = UC-, PWT | PCD = UC.
+#define PMAP_PAT_WB  0x06
+#define PMAP_PAT_WC  0x01
+#define PMAP_PAT_UCM 0x07
+#define PMAP_PAT_UC  0x00
+#define PMAP_PAT_VALUE                                                                             \
+    ((uint64_t)(PMAP_PAT_WB | PMAP_PAT_WC << 8 | PMAP_PAT_UCM << 16 | PMAP_PAT_UC << 24) *         \
+     0x100000001ULL)
+
+// Page table bits that select the memory type
+#define PMAP_CACHE_MASK (VM_PROT_PWT | VM_PROT_NOCACHE)
+
 int     pmap_init();
+void    pmap_init_pat();
 pmap_t* pmap_create();
 void    pmap_debug(pmap_t* pmap);
 void    pmap_destroy(pmap_t* pmap);
 void    pmap_activate(pmap_t* pmap);
+bool    pmap_is_current(pmap_t* pmap);
+
+void          pmap_window_enter(pmap_t* pmap, pmap_window_t* win);
+page_table_t* pmap_window_table(pmap_window_t* win, uint32_t table_idx);
+void          pmap_window_exit(pmap_window_t* win);
+void          pmap_zero_page(paddr_t phys);
+
+/* Page table bits giving a mapping the memory type requested by PMAP_FLAG_NOCACHE / PMAP_FLAG_WC */
+uint32_t pmap_cache_bits(pmap_flags_t flags);
 
 int     pmap_enter(pmap_t* pmap, vaddr_t virt, paddr_t phys, vm_prot_t prot, pmap_flags_t flags);
 void    pmap_remove(pmap_t* pmap, vaddr_t sva, vaddr_t eva);
@@ -26,7 +26,8 @@ static inline uint32_t ioapic_read(uint32_t reg)
 
 void ioapic_init()
 {
-    ioapic = vm_map_device(IOAPIC_BASE, PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_NONE);
+    ioapic =
+        vm_map_device(IOAPIC_BASE, PAGE_SIZE, VM_PROT_READ | VM_PROT_WRITE, VM_REG_F_NOCACHE);
     if (IS_ERR(ioapic))
         PANIC("Failed to map IOAPIC");
 }
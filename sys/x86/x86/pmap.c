@@ -1,3 +1,4 @@
+#include <machine/cpufunc.h>
 #include <machine/page_table.h>
 #include <machine/pmap.h>
 #include <vm/vm_space.h>
@@ -16,7 +17,14 @@
 page_table_t** current_pd_addr = (page_table_t**)0xFFFFFFFC;
 page_table_t*  current_pd      = (page_table_t*)PAGE_DIRECTORY_ADDRESS;
 page_table_t*  current_pts     = (page_table_t*)PAGE_TABLES_ADDRESS;
-page_table_t*  edit_pd         = (page_table_t*)PAGE_TABLE_EDIT_ADDRESS;
+page_table_t*  alt_pd          = (page_table_t*)PAGE_DIRECTORY_ALT_ADDRESS;
+page_table_t*  alt_pts         = (page_table_t*)PAGE_TABLES_ALT_ADDRESS;
+
+// Serialises use of the alternate slot, which lives in whichever page directory is loaded
+static spinlock_t alt_lock = SPINLOCK_INITIALIZER;
+
+// Whether the PAT has been reprogrammed so that PWT selects write-combining
+static bool pat_enabled = false;
 
 void tlb_invlpg(void* addr)
 {
@@ -37,18 +45,105 @@ void switch_page_directory(page_table_t** pd_ptr)
     asm volatile("mov %0, %%cr3" : : "r"(*pd_ptr) : "memory");
 }
 
+bool pmap_is_current(pmap_t* pmap)
+{
+    // Kernel mappings are shared by every page directory, so the kernel pmap is always reachable
+    // through the recursive slot
+    if (pmap == kernel_vm_space.arch)
+        return true;
+    return ((uintptr_t)*current_pd_addr & ~PAGE_MASK) == ((uintptr_t)pmap->pd & ~PAGE_MASK);
+}
+
+/* Points the alternate slot at a physical page, which then appears at alt_pd */
+static void pmap_alt_install(paddr_t phys)
+{
+    spin_lock(&alt_lock);
+    current_pd->entries[PMAP_ALT_SLOT] = (phys & ~PAGE_MASK) | VM_PROT_READ | VM_PROT_WRITE;
+    tlb_invlpg(alt_pd);
+}
+
+static void pmap_alt_release()
+{
+    current_pd->entries[PMAP_ALT_SLOT] = 0;
+    tlb_invlpg(alt_pd);
+    spin_unlock(&alt_lock);
+}
+
+void pmap_window_enter(pmap_t* pmap, pmap_window_t* win)
+{
+    win->alt = !pmap_is_current(pmap);
+    if (!win->alt) {
+        win->pd  = current_pd;
+        win->pts = current_pts;
+        return;
+    }
+
+    pmap_alt_install((paddr_t)pmap->pd);
+    win->pd  = alt_pd;
+    win->pts = alt_pts;
+}
+
+page_table_t* pmap_window_table(pmap_window_t* win, uint32_t table_idx)
+{
+    // The alternate tables may still be cached for the directory that was last installed
+    if (win->alt)
+        tlb_invlpg(&win->pts[table_idx]);
+    return &win->pts[table_idx];
+}
+
+void pmap_window_exit(pmap_window_t* win)
+{
+    if (win->alt)
+        pmap_alt_release();
+}
+
+void pmap_zero_page(paddr_t phys)
+{
+    pmap_alt_install(phys);
+    memset(alt_pd, 0, PAGE_SIZE);
+    pmap_alt_release();
+}
+
+void pmap_init_pat()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_PAT))
+        return;
+
+    // Every CPU must agree on the PAT, and no stale lines may survive the change of type
+    wbinvd();
+    wrmsr(MSR_IA32_PAT, PMAP_PAT_VALUE);
+    wbinvd();
+    tlb_flush();
+
+    pat_enabled = true;
+}
+
+uint32_t pmap_cache_bits(pmap_flags_t flags)
+{
+    if (flags & PMAP_FLAG_NOCACHE)
+        return VM_PROT_NOCACHE;
+
+    // Without the PAT there is no write-combining type, and uncached is the only safe fallback
+    if (flags & PMAP_FLAG_WC)
+        return pat_enabled ? VM_PROT_PWT : VM_PROT_NOCACHE;
+
+    return 0;
+}
+
 void pmap_debug(pmap_t* pmap)
 {
     printf("Page Directory at: %p\n", *current_pd_addr);
-    pmap_enter(kernel_vm_space.arch, PAGE_TABLE_EDIT_ADDRESS, (paddr_t)pmap->pd,
-               VM_PROT_READ | VM_PROT_WRITE, PMAP_FLAG_NONE);
+    pmap_window_t win;
+    pmap_window_enter(pmap, &win);
     for (int i = 767; i < 768; i++) {
-        if (edit_pd->entries[i] & 0x1) {
-            printf("PD Entry %d: %p\n", i, edit_pd->entries[i] & 0xFFFFF000);
+        if (win.pd->entries[i] & 0x1) {
+            printf("PD Entry %d: %p\n", i, win.pd->entries[i] & 0xFFFFF000);
             i += 15;
         }
     }
-    pmap_remove(kernel_vm_space.arch, PAGE_TABLE_EDIT_ADDRESS, PAGE_TABLE_EDIT_ADDRESS + PAGE_SIZE);
+    pmap_window_exit(&win);
 }
 
 pmap_t* pmap_create()
@@ -58,23 +153,27 @@ pmap_t* pmap_create()
         return ERR_PTR(-ENOMEM);
 
     pmap->pd = (page_table_t*)vm_phys_alloc_page();
-    if (is_errno((paddr_t)pmap->pd)) {
+    if (!pmap->pd) {
         kfree(pmap);
         return ERR_PTR(-ENOMEM);
     }
-    pmap->lock = 0;
-    pmap_enter(kernel_vm_space.arch, PAGE_TABLE_EDIT_ADDRESS, (paddr_t)pmap->pd,
-               VM_PROT_READ | VM_PROT_WRITE, PMAP_FLAG_NONE);
+    pmap->lock = MCS_LOCK_INITIALIZER;
+
+    // The new directory is not valid yet, so reach it as a plain page rather than as a window
+    pmap_alt_install((paddr_t)pmap->pd);
 
     // Copy kernel mappings from the current page directory, leaving user-space entries as not
     // present
-    for (int i = KERNEL_PAGE_ENTRY_START; i < PAGE_ENTRIES_PER_TABLE - 1; i++) {
-        edit_pd->entries[i] = current_pd->entries[i];
+    memset(alt_pd, 0, KERNEL_PAGE_ENTRY_START * sizeof(page_entry_t));
+    for (int i = KERNEL_PAGE_ENTRY_START; i < PMAP_ALT_SLOT; i++) {
+        alt_pd->entries[i] = current_pd->entries[i];
     }
-    edit_pd->entries[PAGE_ENTRIES_PER_TABLE - 1] =
+    alt_pd->entries[PMAP_ALT_SLOT] = 0;
+    alt_pd->entries[PAGE_ENTRIES_PER_TABLE - 1] =
         ((uint32_t)pmap->pd) | VM_PROT_READ |
         VM_PROT_WRITE; // Recursive mapping for the page directory
-    pmap_remove(kernel_vm_space.arch, PAGE_TABLE_EDIT_ADDRESS, PAGE_TABLE_EDIT_ADDRESS + PAGE_SIZE);
+
+    pmap_alt_release();
 
     return pmap;
 }
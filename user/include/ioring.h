@@ -0,0 +1,131 @@
+#ifndef USER_IORING_H
+#define USER_IORING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Batched asynchronous I/O through rings shared with the kernel. Operations are queued with
+ * ioring_get_sqe and handed over with a single ioring_submit; a kernel worker runs them and posts
+ * one completion each, carrying the submission's user_data.
+ *
+ * With IORING_SETUP_SQPOLL the worker watches the submission ring itself, so ioring_submit only
+ * enters the kernel once the worker has gone idle and asked to be woken.
+ *
+ * The structures below must match sys/kern/ioring.h.
+ */
+
+#define IORING_MAX_ENTRIES 256
+
+#define IORING_SETUP_SQPOLL    0x1
+#define IORING_ENTER_GETEVENTS 0x1
+#define IORING_SQ_NEED_WAKEUP  0x1
+#define IORING_SQE_CUR_POS     0x1
+
+enum ioring_op {
+    IORING_OP_NOP,
+    IORING_OP_READ,
+    IORING_OP_WRITE,
+    IORING_OP_OPEN,
+    IORING_OP_CLOSE,
+    IORING_OP_FSYNC,
+    IORING_OP_POLL,
+};
+
+#define IORING_POLLIN  0x1
+#define IORING_POLLOUT 0x4
+
+struct ioring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t _reserved;
+    int32_t  fd;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t off;
+    uint32_t op_flags;
+    uint64_t user_data;
+};
+
+struct ioring_cqe {
+    uint64_t user_data;
+    int32_t  res;
+    uint32_t flags;
+};
+
+struct ioring_hdr {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    uint32_t          sq_mask;
+    volatile uint32_t sq_flags;
+
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t          cq_mask;
+
+    uint32_t sqes_off;
+    uint32_t cqes_off;
+};
+
+struct ioring {
+    struct ioring_hdr* hdr;
+    struct ioring_sqe* sqes;
+    struct ioring_cqe* cqes;
+    uint32_t           sq_tail; // Local tail, published by ioring_submit
+    uint32_t           flags;
+};
+
+int                ioring_setup(struct ioring* ring, uint32_t entries, uint32_t flags);
+struct ioring_sqe* ioring_get_sqe(struct ioring* ring);
+int                ioring_submit(struct ioring* ring);
+int                ioring_wait_cqe(struct ioring* ring, struct ioring_cqe** cqe);
+void               ioring_cqe_seen(struct ioring* ring);
+
+static inline void ioring_prep_rw(struct ioring_sqe* sqe, int op, int fd, const void* buf,
+                                  uint32_t len, uint32_t off)
+{
+    sqe->opcode = op;
+    sqe->fd     = fd;
+    sqe->addr   = (uint32_t)buf;
+    sqe->len    = len;
+    sqe->off    = off;
+}
+
+// Reads and writes go to off and leave the file position alone, as pread() and pwrite() do. Set
+// IORING_SQE_CUR_POS in the entry's flags to use and advance the position instead.
+static inline void ioring_prep_read(struct ioring_sqe* sqe, int fd, void* buf, uint32_t len,
+                                    uint32_t off)
+{
+    ioring_prep_rw(sqe, IORING_OP_READ, fd, buf, len, off);
+}
+
+static inline void ioring_prep_write(struct ioring_sqe* sqe, int fd, const void* buf, uint32_t len,
+                                     uint32_t off)
+{
+    ioring_prep_rw(sqe, IORING_OP_WRITE, fd, buf, len, off);
+}
+
+static inline void ioring_prep_open(struct ioring_sqe* sqe, const char* path, int flags,
+                                    uint32_t mode)
+{
+    ioring_prep_rw(sqe, IORING_OP_OPEN, -1, path, mode, 0);
+    sqe->op_flags = flags;
+}
+
+static inline void ioring_prep_close(struct ioring_sqe* sqe, int fd)
+{
+    ioring_prep_rw(sqe, IORING_OP_CLOSE, fd, NULL, 0, 0);
+}
+
+static inline void ioring_prep_fsync(struct ioring_sqe* sqe, int fd)
+{
+    ioring_prep_rw(sqe, IORING_OP_FSYNC, fd, NULL, 0, 0);
+}
+
+static inline void ioring_prep_poll(struct ioring_sqe* sqe, int fd, uint32_t events)
+{
+    ioring_prep_rw(sqe, IORING_OP_POLL, fd, NULL, 0, 0);
+    sqe->op_flags = events;
+}
+
+#endif // USER_IORING_H
@@ -0,0 +1,76 @@
+#ifndef USER_PTHREAD_H
+#define USER_PTHREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Minimal POSIX-style threads on top of the thread_new syscall. Threads share the address space and
+ * file descriptors of their process.
+ *
+ * There is no allocator yet, so the caller provides each thread's stack through pthread_attr_t.
+ * The thread's control block is carved from the top of that stack, and doubles as its TLS block:
+ * %gs:0 points back at it. The stack must stay untouched until pthread_join returns.
+ */
+
+typedef struct pthread* pthread_t;
+
+struct pthread {
+    pthread_t self; // At %gs:0, for pthread_self
+    int       tid;
+
+    void* (*start)(void*);
+    void* arg;
+    void* result;
+
+    volatile uint32_t done; // Set and futex-woken by the thread as it exits
+};
+
+typedef struct {
+    void*  stack;
+    size_t stack_size;
+} pthread_attr_t;
+
+int  pthread_attr_init(pthread_attr_t* attr);
+int  pthread_attr_setstack(pthread_attr_t* attr, void* stack, size_t stack_size);
+int  pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*),
+                    void* arg);
+int  pthread_join(pthread_t thread, void** result);
+void pthread_exit(void* result) __attribute__((noreturn));
+
+// Only valid in threads started by pthread_create; the initial thread has no TLS block
+pthread_t pthread_self(void);
+
+/**
+ * Mutexes and condition variables, built on futexes. Taking a free mutex and releasing one nobody
+ * waits for are single atomic operations that never enter the kernel.
+ */
+
+typedef struct {
+    volatile uint32_t state; // PTHREAD_MUTEX_UNLOCKED, _LOCKED or _CONTENDED
+} pthread_mutex_t;
+
+#define PTHREAD_MUTEX_UNLOCKED  0
+#define PTHREAD_MUTEX_LOCKED    1 // Held, nobody sleeping
+#define PTHREAD_MUTEX_CONTENDED 2 // Held, and there may be sleepers to wake on unlock
+
+#define PTHREAD_MUTEX_INITIALIZER {PTHREAD_MUTEX_UNLOCKED}
+
+typedef struct {
+    volatile uint32_t seq;   // Bumped by every signal, so a waiter cannot miss one
+    pthread_mutex_t*  mutex; // The mutex waiters use, which broadcast requeues them onto
+} pthread_cond_t;
+
+#define PTHREAD_COND_INITIALIZER {0, NULL}
+
+int pthread_mutex_init(pthread_mutex_t* mutex, const void* attr);
+int pthread_mutex_lock(pthread_mutex_t* mutex);
+int pthread_mutex_trylock(pthread_mutex_t* mutex);
+int pthread_mutex_unlock(pthread_mutex_t* mutex);
+
+int pthread_cond_init(pthread_cond_t* cond, const void* attr);
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+int pthread_cond_signal(pthread_cond_t* cond);
+int pthread_cond_broadcast(pthread_cond_t* cond);
+
+#endif // USER_PTHREAD_H
@@ -12,11 +12,69 @@
 #define SYSCALL_OPEN  5
 #define SYSCALL_CLOSE 6
 
+#define SYSCALL_READV  120
+#define SYSCALL_WRITEV 121
+#define SYSCALL_PREAD  475
+#define SYSCALL_PWRITE 476
+
 #define SYSCALL_GETDIRENT 554
 
 #define SYSCALL_PRINT  100
 #define SYSCALL_EXECVE 59
 
+#define SYSCALL_GETRLIMIT 194
+#define SYSCALL_SETRLIMIT 195
+
+#define SYSCALL_CLOCK_GETTIME 232
+#define SYSCALL_NANOSLEEP     240
+
+#define SYSCALL_IORING_SETUP 425
+#define SYSCALL_IORING_ENTER 426
+
+#define SYSCALL_FUTEX      454
+#define SYSCALL_THREAD_NEW 455
+
+// Futex operations
+#define FUTEX_WAIT    0
+#define FUTEX_WAKE    1
+#define FUTEX_REQUEUE 3
+
+// Resource limits
+#define RLIMIT_STACK  3
+#define RLIM_INFINITY ((rlim_t)-1)
+
+typedef uint32_t rlim_t;
+
+struct rlimit {
+    rlim_t rlim_cur;
+    rlim_t rlim_max;
+};
+
+typedef int32_t time_t;
+
+struct timespec {
+    time_t  tv_sec;
+    int32_t tv_nsec;
+};
+
+typedef int32_t clockid_t;
+
+#define CLOCK_MONOTONIC 4
+
+// Kernel clock page, mapped read-only into every process (must match sys/sys/time.h)
+#define USER_TIME_PAGE       0xBBFFE000
+#define TIME_PAGE_F_TSC      0x1
+#define TIME_PAGE_F_SYSENTER 0x2
+
+struct time_page {
+    volatile uint32_t seq;
+    uint32_t          flags;
+    uint32_t          mult;
+    uint32_t          shift;
+    uint64_t          tsc_base;
+    uint64_t          ns_base;
+};
+
 // Memory mapping flags
 #define MMAP_FRAMEBUFFER 0x1
 
@@ -33,6 +91,14 @@
 #define O_TRUNC  0x0200
 #define O_APPEND 0x0400
 
+// Scatter/gather segments (must match sys/sys/uio.h)
+#define IOV_MAX 1024
+
+struct iovec {
+    void*  iov_base;
+    size_t iov_len;
+};
+
 // Standard file descriptors
 #define STDIN_FILENO  0
 #define STDOUT_FILENO 1
@@ -40,10 +106,10 @@
 
 /**
  * Low-level syscall wrapper - invokes int 0x80
- * Users should use the higher-level wrappers below instead
+ * Works on any CPU, and needs no stack, but costs an interrupt gate and an iret
  */
-static inline int syscall(uint32_t syscall_id, uint32_t arg1, uint32_t arg2, uint32_t arg3,
-                          uint32_t arg4, uint32_t arg5)
+static inline int syscall_int80(uint32_t syscall_id, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                                uint32_t arg4, uint32_t arg5)
 {
     int ret;
     __asm__ volatile("int $0x80"
@@ -53,6 +119,36 @@ static inline int syscall(uint32_t syscall_id, uint32_t arg1, uint32_t arg2, uin
     return ret;
 }
 
+/**
+ * Low-level syscall wrapper - invokes sysenter
+ * Users should use the higher-level wrappers below instead
+ *
+ * SYSENTER saves neither eip nor esp, so the return address is pushed and the stack pointer is
+ * passed in ebp. The kernel returns to that address with esp pointing at it, and SYSEXIT clobbers
+ * ecx, edx and the flags. On CPUs without it the kernel leaves TIME_PAGE_F_SYSENTER clear, and
+ * int 0x80 is used instead.
+ */
+static inline int syscall(uint32_t syscall_id, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                          uint32_t arg4, uint32_t arg5)
+{
+    const struct time_page* page = (const struct time_page*)USER_TIME_PAGE;
+    if (!(page->flags & TIME_PAGE_F_SYSENTER))
+        return syscall_int80(syscall_id, arg1, arg2, arg3, arg4, arg5);
+
+    int ret;
+    __asm__ volatile("pushl %%ebp\n"
+                     "pushl $1f\n"
+                     "movl %%esp, %%ebp\n"
+                     "sysenter\n"
+                     "1:\n"
+                     "addl $4, %%esp\n"
+                     "popl %%ebp"
+                     : "=a"(ret), "+c"(arg2), "+d"(arg3)
+                     : "0"(syscall_id), "b"(arg1), "S"(arg4), "D"(arg5)
+                     : "memory", "cc");
+    return ret;
+}
+
 // Process syscalls
 static inline void exit(int status)
 {
@@ -85,6 +181,28 @@ static inline int write(int fd, const void* buf, size_t count)
     return syscall(SYSCALL_WRITE, fd, (uint32_t)buf, count, 0, 0);
 }
 
+// Reads at offset without moving the file position
+static inline int pread(int fd, void* buf, size_t count, uint32_t offset)
+{
+    return syscall(SYSCALL_PREAD, fd, (uint32_t)buf, count, offset, 0);
+}
+
+static inline int pwrite(int fd, const void* buf, size_t count, uint32_t offset)
+{
+    return syscall(SYSCALL_PWRITE, fd, (uint32_t)buf, count, offset, 0);
+}
+
+// Reads into up to IOV_MAX buffers in order, with one syscall
+static inline int readv(int fd, const struct iovec* iov, int iovcnt)
+{
+    return syscall(SYSCALL_READV, fd, (uint32_t)iov, iovcnt, 0, 0);
+}
+
+static inline int writev(int fd, const struct iovec* iov, int iovcnt)
+{
+    return syscall(SYSCALL_WRITEV, fd, (uint32_t)iov, iovcnt, 0, 0);
+}
+
 static inline int getdirent(int fd, char* buf, size_t count, uintptr_t offset)
 {
     return syscall(SYSCALL_GETDIRENT, fd, (uint32_t)buf, count, 0, 0);
@@ -95,9 +213,110 @@ static inline int fork()
     return syscall(SYSCALL_FORK, 0, 0, 0, 0, 0);
 }
 
+// Starts a thread in this process at entry, on the stack below stack_top, with %gs based at
+// tls_base. Returns the new thread's ID. See pthread.h for the usual interface.
+static inline int thread_new(void (*entry)(void), void* stack_top, void* tls_base)
+{
+    return syscall(SYSCALL_THREAD_NEW, (uint32_t)entry, (uint32_t)stack_top, (uint32_t)tls_base, 0,
+                   0);
+}
+
+// Sleeps while *uaddr equals val, until woken through the same address
+static inline int futex_wait(volatile uint32_t* uaddr, uint32_t val)
+{
+    return syscall(SYSCALL_FUTEX, (uint32_t)uaddr, FUTEX_WAIT, val, 0, 0);
+}
+
+// Wakes up to nr threads sleeping on uaddr
+static inline int futex_wake(volatile uint32_t* uaddr, int nr)
+{
+    return syscall(SYSCALL_FUTEX, (uint32_t)uaddr, FUTEX_WAKE, nr, 0, 0);
+}
+
+// Wakes up to nr_wake threads sleeping on uaddr and moves up to nr_requeue others onto uaddr2
+static inline int futex_requeue(volatile uint32_t* uaddr, int nr_wake, volatile uint32_t* uaddr2,
+                                int nr_requeue)
+{
+    return syscall(SYSCALL_FUTEX, (uint32_t)uaddr, FUTEX_REQUEUE, nr_wake, (uint32_t)uaddr2,
+                   nr_requeue);
+}
+
+// Maps a submission/completion ring and returns its address, or -errno (see ioring.h)
+static inline int ioring_setup_syscall(uint32_t entries, uint32_t flags)
+{
+    return syscall(SYSCALL_IORING_SETUP, entries, flags, 0, 0, 0);
+}
+
+// Kicks the ring's worker, optionally waiting for completions. Returns how many are waiting.
+static inline int ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    return syscall(SYSCALL_IORING_ENTER, to_submit, min_complete, flags, 0, 0);
+}
+
 static inline int execve(const char* path, char* const argv[], char* const envp[])
 {
     return syscall(SYSCALL_EXECVE, (uint32_t)path, (uint32_t)argv, (uint32_t)envp, 0, 0);
 }
 
+static inline int getrlimit(int resource, struct rlimit* rlp)
+{
+    return syscall(SYSCALL_GETRLIMIT, resource, (uint32_t)rlp, 0, 0, 0);
+}
+
+static inline int setrlimit(int resource, const struct rlimit* rlp)
+{
+    return syscall(SYSCALL_SETRLIMIT, resource, (uint32_t)rlp, 0, 0, 0);
+}
+
+// Time syscalls
+static inline int nanosleep(const struct timespec* rqtp, struct timespec* rmtp)
+{
+    return syscall(SYSCALL_NANOSLEEP, (uint32_t)rqtp, (uint32_t)rmtp, 0, 0, 0);
+}
+
+static inline int usleep(uint32_t usec)
+{
+    struct timespec ts = {.tv_sec = usec / 1000000, .tv_nsec = (usec % 1000000) * 1000};
+    return nanosleep(&ts, NULL);
+}
+
+static inline int clock_gettime_syscall(clockid_t clock_id, struct timespec* tp)
+{
+    return syscall(SYSCALL_CLOCK_GETTIME, clock_id, (uint32_t)tp, 0, 0, 0);
+}
+
+/**
+ * Reads CLOCK_MONOTONIC straight from the time page with rdtsc, entering the kernel only when the
+ * TSC is unusable. No libgcc here, so the 64 bit division is done with a single divl.
+ */
+static inline int clock_gettime(clockid_t clock_id, struct timespec* tp)
+{
+    const struct time_page* page = (const struct time_page*)USER_TIME_PAGE;
+    if (clock_id != CLOCK_MONOTONIC || !(page->flags & TIME_PAGE_F_TSC))
+        return clock_gettime_syscall(clock_id, tp);
+
+    uint32_t seq, lo, hi;
+    uint64_t ns;
+    do {
+        seq = page->seq;
+        __sync_synchronize();
+        asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+        uint64_t delta = (((uint64_t)hi << 32) | lo) - page->tsc_base;
+
+        // delta * mult can be 96 bits wide, so each 32 bit half is scaled on its own
+        ns = page->ns_base;
+        ns += ((uint64_t)(uint32_t)delta * page->mult) >> page->shift;
+        ns += ((uint64_t)(uint32_t)(delta >> 32) * page->mult) << (32 - page->shift);
+        __sync_synchronize();
+    } while ((seq & 1) || seq != page->seq);
+
+    uint32_t sec, nsec;
+    asm("divl %4"
+        : "=a"(sec), "=d"(nsec)
+        : "a"((uint32_t)ns), "d"((uint32_t)(ns >> 32)), "rm"(1000000000U));
+    tp->tv_sec  = sec;
+    tp->tv_nsec = nsec;
+    return 0;
+}
+
 #endif // USER_SYSCALLS_H
@@ -0,0 +1,70 @@
+#include "ioring.h"
+#include "syscalls.h"
+
+#include <stdint.h>
+
+int ioring_setup(struct ioring* ring, uint32_t entries, uint32_t flags)
+{
+    // A user address may have its top bit set, so only -4095 to -1 are errors
+    int res = ioring_setup_syscall(entries, flags);
+    if ((uint32_t)res >= (uint32_t)-4095)
+        return res;
+
+    ring->hdr     = (struct ioring_hdr*)res;
+    ring->sqes    = (struct ioring_sqe*)((uintptr_t)res + ring->hdr->sqes_off);
+    ring->cqes    = (struct ioring_cqe*)((uintptr_t)res + ring->hdr->cqes_off);
+    ring->sq_tail = ring->hdr->sq_tail;
+    ring->flags   = flags;
+    return 0;
+}
+
+// Returns a cleared submission entry, or NULL if the ring is full until the kernel catches up
+struct ioring_sqe* ioring_get_sqe(struct ioring* ring)
+{
+    if (ring->sq_tail - ring->hdr->sq_head > ring->hdr->sq_mask)
+        return NULL;
+
+    struct ioring_sqe* sqe = &ring->sqes[ring->sq_tail++ & ring->hdr->sq_mask];
+    *sqe                   = (struct ioring_sqe){0};
+    return sqe;
+}
+
+// Publishes every entry taken since the last submit. Returns how many that was, or -errno.
+int ioring_submit(struct ioring* ring)
+{
+    uint32_t count = ring->sq_tail - ring->hdr->sq_tail;
+
+    // The entries must be written before the kernel can see the new tail, and the tail before
+    // NEED_WAKEUP is checked, or a worker going to sleep in between would never see the batch
+    __sync_synchronize();
+    ring->hdr->sq_tail = ring->sq_tail;
+    __sync_synchronize();
+
+    if (!(ring->flags & IORING_SETUP_SQPOLL) || (ring->hdr->sq_flags & IORING_SQ_NEED_WAKEUP)) {
+        int res = ioring_enter(count, 0, 0);
+        if (res < 0)
+            return res;
+    }
+    return count;
+}
+
+// Waits for the next completion. It stays at the head of the ring until ioring_cqe_seen.
+int ioring_wait_cqe(struct ioring* ring, struct ioring_cqe** cqe)
+{
+    struct ioring_hdr* hdr = ring->hdr;
+    while (hdr->cq_head == hdr->cq_tail) {
+        int res = ioring_enter(0, 1, IORING_ENTER_GETEVENTS);
+        if (res < 0)
+            return res;
+    }
+
+    __sync_synchronize(); // Read the entry only after seeing the tail that covers it
+    *cqe = &ring->cqes[hdr->cq_head & hdr->cq_mask];
+    return 0;
+}
+
+void ioring_cqe_seen(struct ioring* ring)
+{
+    __sync_synchronize(); // Done reading the entry before the kernel may reuse its slot
+    ring->hdr->cq_head++;
+}
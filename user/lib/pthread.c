@@ -0,0 +1,177 @@
+#include "pthread.h"
+#include "syscalls.h"
+
+#include <stdint.h>
+
+#define FUTEX_WAKE_ALL 0x7FFFFFFF
+
+int pthread_attr_init(pthread_attr_t* attr)
+{
+    attr->stack      = NULL;
+    attr->stack_size = 0;
+    return 0;
+}
+
+int pthread_attr_setstack(pthread_attr_t* attr, void* stack, size_t stack_size)
+{
+    if (!stack || stack_size < sizeof(struct pthread) + 256)
+        return -1;
+    attr->stack      = stack;
+    attr->stack_size = stack_size;
+    return 0;
+}
+
+pthread_t pthread_self(void)
+{
+    pthread_t self;
+    __asm__ volatile("movl %%gs:0, %0" : "=r"(self));
+    return self;
+}
+
+// Marks the thread done, wakes its joiners and exits in one asm block, so nothing touches the
+// stack once a joiner may already be reusing it. That rules out the syscall wrappers, even
+// syscall_int80: the compiler may spill around them, and sysenter itself pushes onto the stack.
+void pthread_exit(void* result)
+{
+    pthread_t self = pthread_self();
+    self->result   = result;
+    __asm__ volatile("movl $1, (%%ebx)\n"
+                     "int $0x80\n" // futex_wake(&self->done, FUTEX_WAKE_ALL)
+                     "movl %[exit], %%eax\n"
+                     "xorl %%ebx, %%ebx\n"
+                     "int $0x80"
+                     :
+                     : "a"(SYSCALL_FUTEX), "b"(&self->done), "c"(FUTEX_WAKE), "d"(FUTEX_WAKE_ALL),
+                       [exit] "i"(SYSCALL_EXIT)
+                     : "memory");
+    __builtin_unreachable();
+}
+
+// First code run by a new thread, on its own stack with %gs already set up
+static void pthread_trampoline(void)
+{
+    pthread_t self = pthread_self();
+    pthread_exit(self->start(self->arg));
+}
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg)
+{
+    if (!thread || !attr || !attr->stack || !start)
+        return -1;
+
+    // The control block sits at the top of the stack, and the thread's stack grows down below it
+    uintptr_t top = (uintptr_t)attr->stack + attr->stack_size;
+    pthread_t t   = (pthread_t)((top - sizeof(struct pthread)) & ~(uintptr_t)15);
+    t->self       = t;
+    t->start      = start;
+    t->arg        = arg;
+    t->result     = NULL;
+    t->done       = 0;
+
+    t->tid = thread_new(pthread_trampoline, t, t);
+    if (t->tid < 0)
+        return -1;
+
+    *thread = t;
+    return 0;
+}
+
+int pthread_join(pthread_t thread, void** result)
+{
+    if (!thread)
+        return -1;
+
+    while (!thread->done)
+        futex_wait(&thread->done, 0);
+
+    if (result)
+        *result = thread->result;
+    return 0;
+}
+
+/* ---------------- Mutexes ---------------- */
+
+int pthread_mutex_init(pthread_mutex_t* mutex, const void* attr)
+{
+    mutex->state = PTHREAD_MUTEX_UNLOCKED;
+    return 0;
+}
+
+// Sleepers always take the mutex as contended, as they cannot know whether others still sleep
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    uint32_t state = __sync_val_compare_and_swap(&mutex->state, PTHREAD_MUTEX_UNLOCKED,
+                                                 PTHREAD_MUTEX_LOCKED);
+    if (state == PTHREAD_MUTEX_UNLOCKED)
+        return 0;
+
+    if (state != PTHREAD_MUTEX_CONTENDED)
+        state = __sync_lock_test_and_set(&mutex->state, PTHREAD_MUTEX_CONTENDED);
+    while (state != PTHREAD_MUTEX_UNLOCKED) {
+        futex_wait(&mutex->state, PTHREAD_MUTEX_CONTENDED);
+        state = __sync_lock_test_and_set(&mutex->state, PTHREAD_MUTEX_CONTENDED);
+    }
+    return 0;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t* mutex)
+{
+    if (__sync_bool_compare_and_swap(&mutex->state, PTHREAD_MUTEX_UNLOCKED, PTHREAD_MUTEX_LOCKED))
+        return 0;
+    return -1;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t* mutex)
+{
+    if (__sync_fetch_and_sub(&mutex->state, 1) == PTHREAD_MUTEX_LOCKED)
+        return 0; // Nobody was sleeping
+
+    mutex->state = PTHREAD_MUTEX_UNLOCKED;
+    futex_wake(&mutex->state, 1);
+    return 0;
+}
+
+/* ---------------- Condition variables ---------------- */
+
+int pthread_cond_init(pthread_cond_t* cond, const void* attr)
+{
+    cond->seq   = 0;
+    cond->mutex = NULL;
+    return 0;
+}
+
+// A signal between reading seq and sleeping changes seq, so the futex wait returns at once
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+    uint32_t seq = cond->seq;
+    cond->mutex  = mutex;
+
+    pthread_mutex_unlock(mutex);
+    futex_wait(&cond->seq, seq);
+
+    // Broadcast may have moved other waiters onto the mutex, so it is taken as contended to make
+    // sure our unlock wakes the next of them
+    while (__sync_lock_test_and_set(&mutex->state, PTHREAD_MUTEX_CONTENDED) !=
+           PTHREAD_MUTEX_UNLOCKED)
+        futex_wait(&mutex->state, PTHREAD_MUTEX_CONTENDED);
+    return 0;
+}
+
+int pthread_cond_signal(pthread_cond_t* cond)
+{
+    __sync_fetch_and_add(&cond->seq, 1);
+    futex_wake(&cond->seq, 1);
+    return 0;
+}
+
+// Wakes one waiter and moves the rest straight onto the mutex, instead of waking them all only to
+// have them fight over it
+int pthread_cond_broadcast(pthread_cond_t* cond)
+{
+    __sync_fetch_and_add(&cond->seq, 1);
+    if (cond->mutex)
+        futex_requeue(&cond->seq, 1, &cond->mutex->state, FUTEX_WAKE_ALL);
+    else
+        futex_wake(&cond->seq, FUTEX_WAKE_ALL);
+    return 0;
+}